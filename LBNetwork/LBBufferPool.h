@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBBufferPool.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Size-classed pool of response buffers.
+ *
+ * Buffers come in power of two classes between minimumBufferSize and maximumBufferSize
+ * and are presized from the response's expected content length, so a body is received
+ * without repeated reallocations. Recycled buffers keep their allocation and are handed
+ * out again; anything over maxBuffersPerClass or maxRetainedBytes is released. The pool
+ * trims itself on memory warnings.
+ *
+ * Buffers never leave the client, LBServerResponse takes an immutable copy of the body
+ * before deserializing it, so a recycled buffer is never seen by callers. That copy is
+ * one memcpy of every body, pooled or not; what the pool saves is the reallocations
+ * of a buffer growing as the body arrives, not the final allocation.
+ */
+@interface LBBufferPool : NSObject
+
+@property (nonatomic,assign)NSUInteger minimumBufferSize;
+@property (nonatomic,assign)NSUInteger maximumBufferSize;
+@property (nonatomic,assign)NSUInteger maxBuffersPerClass;
+@property (nonatomic,assign)NSUInteger maxRetainedBytes;
+
+@property (nonatomic,assign,readonly)NSUInteger hits;
+@property (nonatomic,assign,readonly)NSUInteger misses;
+@property (nonatomic,assign,readonly)NSUInteger bytesRetained;
+
+-(NSMutableData *)bufferForExpectedLength:(long long)expectedLength;
+-(void)recycleBuffer:(NSMutableData *)buffer;
+-(void)trim;
+-(void)trimToBytes:(NSUInteger)bytes;
+-(NSDictionary *)statistics;
+@end
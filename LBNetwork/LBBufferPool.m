@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBBufferPool.m
+//  LBNetwork
+//
+
+#import "LBBufferPool.h"
+#import <UIKit/UIKit.h>
+#import <objc/runtime.h>
+
+#define kDefaultMinimumBufferSize (4 * 1024)
+#define kDefaultMaximumBufferSize (4 * 1024 * 1024)
+#define kDefaultMaxBuffersPerClass 4
+#define kDefaultMaxRetainedBytes (16 * 1024 * 1024)
+
+static char kBufferCapacityKey;
+
+@interface LBBufferPool ()
+@property (nonatomic,strong)NSMutableDictionary *classes;
+@property (nonatomic,assign,readwrite)NSUInteger hits;
+@property (nonatomic,assign,readwrite)NSUInteger misses;
+@property (nonatomic,assign,readwrite)NSUInteger bytesRetained;
+@end
+
+@implementation LBBufferPool
+
+-(instancetype)init{
+    self = [super init];
+    if(self){
+        _minimumBufferSize = kDefaultMinimumBufferSize;
+        _maximumBufferSize = kDefaultMaximumBufferSize;
+        _maxBuffersPerClass = kDefaultMaxBuffersPerClass;
+        _maxRetainedBytes = kDefaultMaxRetainedBytes;
+        self.classes = [[NSMutableDictionary alloc]init];
+        [[NSNotificationCenter defaultCenter]addObserver:self
+                                                selector:@selector(trim)
+                                                    name:UIApplicationDidReceiveMemoryWarningNotification
+                                                  object:nil];
+    }
+    return self;
+}
+
+-(void)dealloc{
+    [[NSNotificationCenter defaultCenter]removeObserver:self];
+}
+
+/**
+ * Smallest class that fits length, or 0 when length is beyond the pooled range
+ */
+-(NSUInteger)classSizeForLength:(NSUInteger)length{
+    NSUInteger size = self.minimumBufferSize;
+    while(size < length){
+        size <<= 1;
+    }
+    return size <= self.maximumBufferSize ? size : 0;
+}
+
+/**
+ * Largest class a buffer of this capacity can serve
+ */
+-(NSUInteger)classSizeForCapacity:(NSUInteger)capacity{
+    if(capacity < self.minimumBufferSize){
+        return 0;
+    }
+    NSUInteger size = self.minimumBufferSize;
+    while((size << 1) <= capacity && (size << 1) <= self.maximumBufferSize){
+        size <<= 1;
+    }
+    return size;
+}
+
+-(NSMutableData *)bufferForExpectedLength:(long long)expectedLength{
+    NSUInteger length = expectedLength > 0 ? (NSUInteger)expectedLength : 0;
+    NSUInteger classSize = [self classSizeForLength:length];
+    if(!classSize){
+        @synchronized(self){
+            self.misses++;
+        }
+        //the expected length comes from the server, let larger bodies grow past the cap
+        return [NSMutableData dataWithCapacity:MIN(length, self.maximumBufferSize)];
+    }
+    @synchronized(self){
+        NSMutableArray *buffers = self.classes[@(classSize)];
+        NSMutableData *buffer = buffers.lastObject;
+        if(buffer){
+            [buffers removeLastObject];
+            self.bytesRetained -= classSize;
+            self.hits++;
+            return buffer;
+        }
+        self.misses++;
+    }
+    NSMutableData *buffer = [NSMutableData dataWithCapacity:classSize];
+    objc_setAssociatedObject(buffer, &kBufferCapacityKey, @(classSize), OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    return buffer;
+}
+
+-(void)recycleBuffer:(NSMutableData *)buffer{
+    if(!buffer){
+        return;
+    }
+    //a buffer that grew past its class can serve a larger one from now on
+    NSUInteger capacity = MAX(buffer.length, [objc_getAssociatedObject(buffer, &kBufferCapacityKey) unsignedIntegerValue]);
+    NSUInteger classSize = [self classSizeForCapacity:capacity];
+    if(!classSize){
+        return;
+    }
+    [buffer setLength:0];
+    objc_setAssociatedObject(buffer, &kBufferCapacityKey, @(classSize), OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    @synchronized(self){
+        NSMutableArray *buffers = self.classes[@(classSize)];
+        if(!buffers){
+            buffers = [[NSMutableArray alloc]init];
+            self.classes[@(classSize)] = buffers;
+        }
+        if(buffers.count >= self.maxBuffersPerClass || self.bytesRetained + classSize > self.maxRetainedBytes){
+            return;
+        }
+        for(NSMutableData *pooled in buffers){
+            if(pooled == buffer){
+                return;
+            }
+        }
+        [buffers addObject:buffer];
+        self.bytesRetained += classSize;
+    }
+}
+
+-(void)trim{
+    [self trimToBytes:0];
+}
+
+-(void)trimToBytes:(NSUInteger)bytes{
+    @synchronized(self){
+        //largest buffers go first
+        NSArray *sizes = [[self.classes allKeys]sortedArrayUsingSelector:@selector(compare:)];
+        for(NSNumber *size in [sizes reverseObjectEnumerator]){
+            NSMutableArray *buffers = self.classes[size];
+            while(buffers.count && self.bytesRetained > bytes){
+                [buffers removeLastObject];
+                self.bytesRetained -= [size unsignedIntegerValue];
+            }
+        }
+    }
+}
+
+-(NSDictionary *)statistics{
+    @synchronized(self){
+        return @{@"hits":@(self.hits),
+                 @"misses":@(self.misses),
+                 @"bytesRetained":@(self.bytesRetained)};
+    }
+}
+
+@end
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBChannel.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+@class LBHTTPSClient;
+
+typedef enum{
+    LBChannelStateClosed,
+    /**
+     * Also while waiting to reconnect
+     */
+    LBChannelStateConnecting,
+    LBChannelStateOpen,
+    LBChannelStateClosing,
+}LBChannelState;
+
+typedef void (^LBChannelMessageHandler)(id message);
+typedef void (^LBChannelStateHandler)(LBChannelState state, NSError *error);
+
+/**
+ * Persistent WebSocket (RFC 6455) channel, see LBHTTPSClient's channelWithURL:.
+ *
+ * wss channels are validated by the system or, when the client has roots from
+ * addWithRootCA:strictHostNameCheck:, against those roots and its hostname check.
+ * Text and binary messages alike go through the client's deserializer for
+ * messageContentType and reach messageHandler in order, on the channel's private
+ * serial queue. Without a deserializer text arrives as NSString and binary as NSData.
+ *
+ * A connection not open within connectTimeout counts as dropped. Until close is
+ * called a dropped channel reconnects, after initialReconnectDelay doubled per
+ * failed attempt up to maxReconnectDelay, with jitter. A ping goes out every
+ * pingInterval and a connection silent for two intervals counts as dropped.
+ * Messages sent while connecting are queued until the channel opens.
+ */
+@interface LBChannel : NSObject
+
+@property (nonatomic,strong,readonly)NSURL *URL;
+@property (atomic,assign,readonly)LBChannelState state;
+@property (nonatomic,copy)NSDictionary *headers;
+@property (nonatomic,copy)NSString *messageContentType;
+@property (nonatomic,assign)Class messageClass;
+@property (nonatomic,strong)LBChannelMessageHandler messageHandler;
+@property (nonatomic,strong)LBChannelStateHandler stateHandler;
+@property (nonatomic,assign)BOOL reconnects;
+@property (nonatomic,assign)NSTimeInterval initialReconnectDelay;
+@property (nonatomic,assign)NSTimeInterval maxReconnectDelay;
+@property (nonatomic,assign)NSTimeInterval connectTimeout;
+@property (nonatomic,assign)NSTimeInterval pingInterval;
+@property (nonatomic,assign)NSUInteger maxMessageLength;
+
+-(instancetype)initWithURL:(NSURL *)URL client:(LBHTTPSClient *)client;
+
+-(void)open;
+-(void)close;
+-(void)sendText:(NSString *)text;
+-(void)sendData:(NSData *)data;
+
+/**
+ * Delay before reconnect attempt, counted from 0, without the jitter
+ */
+-(NSTimeInterval)reconnectDelayForAttempt:(NSUInteger)attempt;
++(NSString *)acceptValueForKey:(NSString *)key;
+@end
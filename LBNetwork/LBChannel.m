@@ -0,0 +1,653 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBChannel.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import "Logging.h"
+#import <CFNetwork/CFNetwork.h>
+#import <CommonCrypto/CommonDigest.h>
+#define kDefaultInitialReconnectDelay 1.0
+#define kDefaultMaxReconnectDelay 60.0
+#define kDefaultPingInterval 30.0
+#define kDefaultConnectTimeout 30.0
+#define kDefaultMaxMessageLength (16 * 1024 * 1024)
+#define kReconnectJitter 0.2
+#define kCloseTimeout 2.0
+#define kReadLength 16384
+#define kMaxHandshakeLength 16384
+#define kCloseStatusNormal 1000
+#define kCloseStatusNone 1005
+
+#define LBLogDebug(fmt, ...) if ([self.client shouldLog]) LogDebug(fmt,##__VA_ARGS__)
+#define LBLogInfo(fmt, ...)  if ([self.client shouldLog]) LogInfo(fmt,##__VA_ARGS__)
+
+static NSString *const LBChannelAcceptGUID = @"258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+typedef enum{
+    LBChannelOpcodeContinuation = 0x0,
+    LBChannelOpcodeText = 0x1,
+    LBChannelOpcodeBinary = 0x2,
+    LBChannelOpcodeClose = 0x8,
+    LBChannelOpcodePing = 0x9,
+    LBChannelOpcodePong = 0xA,
+}LBChannelOpcode;
+
+@interface LBChannel () <NSStreamDelegate>
+@property (nonatomic,strong,readwrite)NSURL *URL;
+@property (atomic,assign,readwrite)LBChannelState state;
+@property (nonatomic,strong)LBHTTPSClient *client;
+@property (nonatomic,strong)dispatch_queue_t queue;
+@property (nonatomic,strong)NSInputStream *inputStream;
+@property (nonatomic,strong)NSOutputStream *outputStream;
+@property (nonatomic,strong)NSMutableData *readBuffer;
+@property (nonatomic,strong)NSMutableData *writeBuffer;
+@property (nonatomic,strong)NSMutableArray *pendingFrames;
+@property (nonatomic,strong)NSMutableData *message;
+@property (nonatomic,assign)LBChannelOpcode messageOpcode;
+@property (nonatomic,copy)NSString *handshakeKey;
+@property (nonatomic,assign)BOOL handshakeDone;
+@property (nonatomic,assign)BOOL trustChecked;
+@property (nonatomic,assign)BOOL closeRequested;
+@property (nonatomic,assign)NSUInteger reconnectAttempt;
+@property (nonatomic,assign)NSUInteger generation;
+@property (nonatomic,assign)CFAbsoluteTime lastReceive;
+@property (nonatomic,strong)dispatch_source_t pingTimer;
+@end
+
+@implementation LBChannel
+
+-(instancetype)initWithURL:(NSURL *)URL client:(LBHTTPSClient *)client{
+    self = [super init];
+    if(self){
+        self.URL = URL;
+        self.client = client;
+        self.queue = dispatch_queue_create("LBChannel", DISPATCH_QUEUE_SERIAL);
+        self.pendingFrames = [[NSMutableArray alloc]init];
+        _messageContentType = ContentTypeJSON;
+        _reconnects = YES;
+        _initialReconnectDelay = kDefaultInitialReconnectDelay;
+        _maxReconnectDelay = kDefaultMaxReconnectDelay;
+        _pingInterval = kDefaultPingInterval;
+        _connectTimeout = kDefaultConnectTimeout;
+        _maxMessageLength = kDefaultMaxMessageLength;
+    }
+    return self;
+}
+
+-(void)dealloc{
+    [self teardown];
+}
+
+#pragma mark - public
+
+-(void)open{
+    dispatch_async(self.queue, ^{
+        if(self.state != LBChannelStateClosed){
+            return;
+        }
+        self.closeRequested = NO;
+        self.reconnectAttempt = 0;
+        [self connect];
+    });
+}
+
+-(void)close{
+    dispatch_async(self.queue, ^{
+        self.closeRequested = YES;
+        [self.pendingFrames removeAllObjects];
+        if(self.state != LBChannelStateOpen){
+            //also cancels a pending reconnect
+            self.generation++;
+            [self teardown];
+            [self setState:LBChannelStateClosed error:nil];
+            return;
+        }
+        [self setState:LBChannelStateClosing error:nil];
+        uint16_t status = CFSwapInt16HostToBig(kCloseStatusNormal);
+        [self writeData:[LBChannel frameWithOpcode:LBChannelOpcodeClose payload:[NSData dataWithBytes:&status length:sizeof(status)]]];
+        //the server should answer with its own close frame, do not wait forever
+        NSUInteger generation = self.generation;
+        __weak LBChannel *weakSelf = self;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (kCloseTimeout * NSEC_PER_SEC)), self.queue, ^{
+            LBChannel *channel = weakSelf;
+            if(channel.generation == generation && channel.state == LBChannelStateClosing){
+                [channel teardown];
+                [channel setState:LBChannelStateClosed error:nil];
+            }
+        });
+    });
+}
+
+-(void)sendText:(NSString *)text{
+    [self sendFrame:[LBChannel frameWithOpcode:LBChannelOpcodeText payload:[text dataUsingEncoding:NSUTF8StringEncoding]]];
+}
+
+-(void)sendData:(NSData *)data{
+    [self sendFrame:[LBChannel frameWithOpcode:LBChannelOpcodeBinary payload:data]];
+}
+
+-(void)sendFrame:(NSData *)frame{
+    dispatch_async(self.queue, ^{
+        switch(self.state){
+            case LBChannelStateOpen:
+                [self writeData:frame];
+                break;
+            case LBChannelStateConnecting:
+                [self.pendingFrames addObject:frame];
+                break;
+            default:
+                LBLogDebug(@"channel %@ not open, message dropped", self.URL);
+                break;
+        }
+    });
+}
+
+-(NSTimeInterval)reconnectDelayForAttempt:(NSUInteger)attempt{
+    return MIN(self.maxReconnectDelay, self.initialReconnectDelay * pow(2, attempt));
+}
+
++(NSString *)acceptValueForKey:(NSString *)key{
+    NSData *value = [[key stringByAppendingString:LBChannelAcceptGUID] dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(value.bytes, (CC_LONG) value.length, digest);
+    return [[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0];
+}
+
+#pragma mark - connection
+
+-(void)setState:(LBChannelState)state error:(NSError *)error{
+    if(state == self.state && !error){
+        return;
+    }
+    self.state = state;
+    if(self.stateHandler){
+        self.stateHandler(state, error);
+    }
+}
+
+-(void)connect{
+    self.generation++;
+    [self setState:LBChannelStateConnecting error:nil];
+
+    NSURL *URL = self.URL;
+    NSString *scheme = URL.scheme.lowercaseString;
+    BOOL secure = [scheme isEqualToString:@"wss"] || [scheme isEqualToString:@"https"];
+    UInt32 port = URL.port ? URL.port.unsignedIntValue : (secure ? 443 : 80);
+    CFReadStreamRef readStream = NULL;
+    CFWriteStreamRef writeStream = NULL;
+    CFStreamCreatePairWithSocketToHost(NULL, (__bridge CFStringRef) URL.host, port, &readStream, &writeStream);
+    self.inputStream = CFBridgingRelease(readStream);
+    self.outputStream = CFBridgingRelease(writeStream);
+    //only custom roots take the evaluation over from the system, see checkTrustIfNeeded
+    BOOL customRoots = secure && [self.client hasCustomRootCAs];
+    if(secure){
+        [self.inputStream setProperty:NSStreamSocketSecurityLevelNegotiatedSSL forKey:NSStreamSocketSecurityLevelKey];
+    }
+    if(customRoots){
+        NSDictionary *settings = @{(__bridge NSString *) kCFStreamSSLValidatesCertificateChain : @NO,
+                (__bridge NSString *) kCFStreamSSLPeerName : URL.host};
+        [self.inputStream setProperty:settings forKey:(__bridge NSString *) kCFStreamPropertySSLSettings];
+    }
+    self.trustChecked = !customRoots;
+    self.handshakeDone = NO;
+    self.readBuffer = [[NSMutableData alloc]init];
+    self.writeBuffer = [[NSMutableData alloc]init];
+    self.message = nil;
+    self.lastReceive = CFAbsoluteTimeGetCurrent();
+
+    self.inputStream.delegate = self;
+    self.outputStream.delegate = self;
+    CFReadStreamSetDispatchQueue((__bridge CFReadStreamRef) self.inputStream, self.queue);
+    CFWriteStreamSetDispatchQueue((__bridge CFWriteStreamRef) self.outputStream, self.queue);
+    [self.inputStream open];
+    [self.outputStream open];
+    [self.writeBuffer appendData:[self handshakeRequest]];
+    LBLogDebug(@"channel connecting to %@", URL);
+
+    //the ping timer only runs once open, a server that never answers is caught here
+    NSUInteger generation = self.generation;
+    __weak LBChannel *weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (self.connectTimeout * NSEC_PER_SEC)), self.queue, ^{
+        LBChannel *channel = weakSelf;
+        if(channel.generation == generation && !channel.handshakeDone){
+            [channel dropWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil]];
+        }
+    });
+}
+
+-(NSData *)handshakeRequest{
+    uint8_t nonce[16];
+    arc4random_buf(nonce, sizeof(nonce));
+    self.handshakeKey = [[NSData dataWithBytes:nonce length:sizeof(nonce)] base64EncodedStringWithOptions:0];
+
+    NSURL *URL = self.URL;
+    NSString *path = URL.path.length ? URL.path : @"/";
+    if(URL.query.length){
+        path = [NSString stringWithFormat:@"%@?%@", path, URL.query];
+    }
+    NSString *host = URL.port ? [NSString stringWithFormat:@"%@:%@", URL.host, URL.port] : URL.host;
+    NSMutableString *request = [NSMutableString stringWithFormat:@"GET %@ HTTP/1.1\r\nHost: %@\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: %@\r\nSec-WebSocket-Version: 13\r\n", path, host, self.handshakeKey];
+    [self.headers enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop) {
+        [request appendFormat:@"%@: %@\r\n", key, value];
+    }];
+    [request appendString:@"\r\n"];
+    return [request dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+-(void)teardown{
+    [self stopPingTimer];
+    if(self.inputStream){
+        self.inputStream.delegate = nil;
+        [self.inputStream close];
+        CFReadStreamSetDispatchQueue((__bridge CFReadStreamRef) self.inputStream, NULL);
+    }
+    if(self.outputStream){
+        self.outputStream.delegate = nil;
+        [self.outputStream close];
+        CFWriteStreamSetDispatchQueue((__bridge CFWriteStreamRef) self.outputStream, NULL);
+    }
+    self.inputStream = nil;
+    self.outputStream = nil;
+    self.readBuffer = nil;
+    self.writeBuffer = nil;
+    self.message = nil;
+    self.handshakeDone = NO;
+}
+
+/**
+ * Reconnects unless the channel was closed on purpose
+ */
+-(void)dropWithError:(NSError *)error{
+    [self teardown];
+    if(self.closeRequested || !self.reconnects){
+        [self setState:LBChannelStateClosed error:error];
+        return;
+    }
+    double jitter = 1 + kReconnectJitter * (2 * ((double) arc4random() / UINT32_MAX) - 1);
+    NSTimeInterval delay = [self reconnectDelayForAttempt:self.reconnectAttempt] * jitter;
+    self.reconnectAttempt++;
+    LBLogInfo(@"channel %@ dropped:%@, reconnecting in %.1fs", self.URL, error.localizedDescription, delay);
+    NSUInteger generation = ++self.generation;
+    [self setState:LBChannelStateConnecting error:error];
+    __weak LBChannel *weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (delay * NSEC_PER_SEC)), self.queue, ^{
+        LBChannel *channel = weakSelf;
+        if(channel.generation == generation && !channel.closeRequested){
+            [channel connect];
+        }
+    });
+}
+
+-(NSError *)errorWithCode:(LBNetworkErrorCode)code description:(NSString *)description{
+    return [NSError errorWithDomain:LBNetworkErrorDomain code:code userInfo:@{NSLocalizedDescriptionKey : description}];
+}
+
+#pragma mark - NSStreamDelegate
+
+-(void)stream:(NSStream *)stream handleEvent:(NSStreamEvent)eventCode{
+    if(stream != self.inputStream && stream != self.outputStream){
+        //left over from a torn down connection
+        return;
+    }
+    switch(eventCode){
+        case NSStreamEventHasBytesAvailable:
+            [self readAvailableBytes];
+            break;
+        case NSStreamEventHasSpaceAvailable:
+            [self flushWriteBuffer];
+            break;
+        case NSStreamEventErrorOccurred:
+            [self dropWithError:stream.streamError];
+            break;
+        case NSStreamEventEndEncountered:
+            [self dropWithError:[self errorWithCode:LBNetworkErrorChannelClosed description:@"The server closed the channel"]];
+            break;
+        default:
+            break;
+    }
+}
+
+-(BOOL)checkTrustIfNeeded{
+    if(self.trustChecked){
+        return YES;
+    }
+    SecTrustRef trust = (__bridge SecTrustRef) [self.outputStream propertyForKey:(__bridge NSString *) kCFStreamPropertySSLPeerTrust];
+    if(!trust){
+        return NO;
+    }
+    if(![self.client shouldTrustServerTrust:trust forHost:self.URL.host]){
+        //retrying would not make the certificate any better
+        self.closeRequested = YES;
+        [self dropWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorServerCertificateUntrusted userInfo:nil]];
+        return NO;
+    }
+    self.trustChecked = YES;
+    return YES;
+}
+
+-(void)writeData:(NSData *)data{
+    [self.writeBuffer appendData:data];
+    if(self.outputStream.hasSpaceAvailable){
+        [self flushWriteBuffer];
+    }
+}
+
+-(void)flushWriteBuffer{
+    if(![self checkTrustIfNeeded]){
+        return;
+    }
+    while(self.writeBuffer.length && self.outputStream.hasSpaceAvailable){
+        NSInteger written = [self.outputStream write:self.writeBuffer.bytes maxLength:self.writeBuffer.length];
+        if(written < 0){
+            [self dropWithError:self.outputStream.streamError];
+            return;
+        }
+        if(written == 0){
+            break;
+        }
+        [self.writeBuffer replaceBytesInRange:NSMakeRange(0, (NSUInteger) written) withBytes:NULL length:0];
+    }
+}
+
+-(void)readAvailableBytes{
+    if(![self checkTrustIfNeeded]){
+        return;
+    }
+    uint8_t buffer[kReadLength];
+    while(self.inputStream.hasBytesAvailable){
+        NSInteger length = [self.inputStream read:buffer maxLength:sizeof(buffer)];
+        if(length < 0){
+            [self dropWithError:self.inputStream.streamError];
+            return;
+        }
+        if(length == 0){
+            break;
+        }
+        [self.readBuffer appendBytes:buffer length:(NSUInteger) length];
+    }
+    self.lastReceive = CFAbsoluteTimeGetCurrent();
+    if(!self.handshakeDone && ![self readHandshake]){
+        return;
+    }
+    [self readFrames];
+}
+
+-(BOOL)readHandshake{
+    NSData *terminator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+    NSRange end = [self.readBuffer rangeOfData:terminator options:0 range:NSMakeRange(0, self.readBuffer.length)];
+    if(end.location == NSNotFound){
+        if(self.readBuffer.length > kMaxHandshakeLength){
+            [self dropWithError:[self errorWithCode:LBNetworkErrorChannelHandshakeFailed description:@"The channel handshake response is too long"]];
+        }
+        return NO;
+    }
+    NSString *head = [[NSString alloc]initWithData:[self.readBuffer subdataWithRange:NSMakeRange(0, end.location)] encoding:NSISOLatin1StringEncoding];
+    [self.readBuffer replaceBytesInRange:NSMakeRange(0, NSMaxRange(end)) withBytes:NULL length:0];
+
+    NSArray<NSString *> *lines = [head componentsSeparatedByString:@"\r\n"];
+    NSArray<NSString *> *statusLine = [lines.firstObject componentsSeparatedByString:@" "];
+    NSInteger statusCode = statusLine.count > 1 ? statusLine[1].integerValue : 0;
+    NSString *accept = nil;
+    for(NSString *line in lines){
+        NSRange colon = [line rangeOfString:@":"];
+        if(colon.location != NSNotFound && [[line substringToIndex:colon.location] caseInsensitiveCompare:@"Sec-WebSocket-Accept"] == NSOrderedSame){
+            accept = [[line substringFromIndex:NSMaxRange(colon)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+    }
+    if(statusCode != kHTTPStatusCodeSwitchingProtocols || ![accept isEqualToString:[LBChannel acceptValueForKey:self.handshakeKey]]){
+        NSString *description = [NSString stringWithFormat:@"The channel handshake failed with status %ld", (long) statusCode];
+        [self dropWithError:[self errorWithCode:LBNetworkErrorChannelHandshakeFailed description:description]];
+        return NO;
+    }
+
+    self.handshakeDone = YES;
+    self.reconnectAttempt = 0;
+    LBLogDebug(@"channel open to %@", self.URL);
+    [self setState:LBChannelStateOpen error:nil];
+    NSArray *pendingFrames = [self.pendingFrames copy];
+    [self.pendingFrames removeAllObjects];
+    for(NSData *frame in pendingFrames){
+        [self writeData:frame];
+    }
+    [self startPingTimer];
+    return YES;
+}
+
+#pragma mark - frames
+
+-(void)readFrames{
+    NSUInteger generation = self.generation;
+    //handlers may close or drop the channel, stop reading once they have
+    while(self.readBuffer && self.generation == generation){
+        uint8_t opcode = 0;
+        BOOL fin = NO;
+        NSUInteger frameLength = 0;
+        NSError *error = nil;
+        NSData *payload = [LBChannel payloadOfFrame:self.readBuffer opcode:&opcode fin:&fin frameLength:&frameLength maxLength:self.maxMessageLength error:&error];
+        if(error){
+            [self dropWithError:error];
+            return;
+        }
+        if(!payload){
+            return;
+        }
+        [self.readBuffer replaceBytesInRange:NSMakeRange(0, frameLength) withBytes:NULL length:0];
+        [self handleFrame:(LBChannelOpcode) opcode fin:fin payload:payload];
+    }
+}
+
+-(void)handleFrame:(LBChannelOpcode)opcode fin:(BOOL)fin payload:(NSData *)payload{
+    switch(opcode){
+        case LBChannelOpcodeText:
+        case LBChannelOpcodeBinary:
+            if(self.message){
+                [self dropWithError:[self errorWithCode:LBNetworkErrorChannelProtocolError description:@"A channel message started inside another"]];
+                return;
+            }
+            if(fin){
+                [self deliverMessage:payload opcode:opcode];
+                return;
+            }
+            self.message = [payload mutableCopy];
+            self.messageOpcode = opcode;
+            break;
+        case LBChannelOpcodeContinuation:
+            if(!self.message || self.message.length + payload.length > self.maxMessageLength){
+                [self dropWithError:[self errorWithCode:LBNetworkErrorChannelProtocolError description:@"Unexpected or oversized channel continuation"]];
+                return;
+            }
+            [self.message appendData:payload];
+            if(fin){
+                NSData *message = self.message;
+                self.message = nil;
+                [self deliverMessage:message opcode:self.messageOpcode];
+            }
+            break;
+        case LBChannelOpcodePing:
+            [self writeData:[LBChannel frameWithOpcode:LBChannelOpcodePong payload:payload]];
+            break;
+        case LBChannelOpcodePong:
+            break;
+        case LBChannelOpcodeClose:
+            [self handleCloseFrame:payload];
+            break;
+        default:
+            [self dropWithError:[self errorWithCode:LBNetworkErrorChannelProtocolError description:@"Unknown channel frame"]];
+            break;
+    }
+}
+
+-(void)handleCloseFrame:(NSData *)payload{
+    if(self.state == LBChannelStateClosing){
+        //the answer to our own close
+        [self teardown];
+        [self setState:LBChannelStateClosed error:nil];
+        return;
+    }
+    const uint8_t *bytes = payload.bytes;
+    NSInteger status = payload.length >= 2 ? (bytes[0] << 8) | bytes[1] : kCloseStatusNone;
+    //echo the status, best effort, the connection is torn down right after
+    [self writeData:[LBChannel frameWithOpcode:LBChannelOpcodeClose payload:[payload subdataWithRange:NSMakeRange(0, MIN(2u, payload.length))]]];
+    NSString *description = [NSString stringWithFormat:@"The server closed the channel with status %ld", (long) status];
+    [self dropWithError:[self errorWithCode:LBNetworkErrorChannelClosed description:description]];
+}
+
+-(void)deliverMessage:(NSData *)payload opcode:(LBChannelOpcode)opcode{
+    id <LBDeserializer> deserializer = self.messageContentType ? [self.client.connectionProperties deserializerForContentType:self.messageContentType] : nil;
+    id message;
+    if(deserializer){
+        message = [deserializer deserialize:payload toClass:self.messageClass];
+    }
+    else{
+        message = opcode == LBChannelOpcodeText ? [[NSString alloc]initWithData:payload encoding:NSUTF8StringEncoding] : payload;
+    }
+    if(message && self.messageHandler){
+        self.messageHandler(message);
+    }
+}
+
+/**
+ * Client frames are always masked
+ */
++(NSData *)frameWithOpcode:(uint8_t)opcode payload:(NSData *)payload{
+    NSUInteger length = payload.length;
+    uint8_t header[14];
+    NSUInteger headerLength = 2;
+    header[0] = 0x80 | opcode;
+    if(length < 126){
+        header[1] = 0x80 | (uint8_t) length;
+    }
+    else if(length <= 0xFFFF){
+        header[1] = 0x80 | 126;
+        header[2] = (uint8_t) (length >> 8);
+        header[3] = (uint8_t) length;
+        headerLength = 4;
+    }
+    else{
+        header[1] = 0x80 | 127;
+        for(NSUInteger i = 0; i < 8; i++){
+            header[2 + i] = (uint8_t) ((uint64_t) length >> (56 - 8 * i));
+        }
+        headerLength = 10;
+    }
+    uint8_t *mask = header + headerLength;
+    arc4random_buf(mask, 4);
+    headerLength += 4;
+
+    NSMutableData *frame = [NSMutableData dataWithCapacity:headerLength + length];
+    [frame appendBytes:header length:headerLength];
+    [frame appendData:payload];
+    uint8_t *bytes = (uint8_t *) frame.mutableBytes + headerLength;
+    for(NSUInteger i = 0; i < length; i++){
+        bytes[i] ^= mask[i % 4];
+    }
+    return frame;
+}
+
+/**
+ * Unmasked payload of the frame at the start of buffer, nil until it is complete
+ */
++(NSData *)payloadOfFrame:(NSData *)buffer opcode:(uint8_t *)opcode fin:(BOOL *)fin frameLength:(NSUInteger *)frameLength maxLength:(NSUInteger)maxLength error:(NSError **)error{
+    const uint8_t *bytes = buffer.bytes;
+    NSUInteger length = buffer.length;
+    if(length < 2){
+        return nil;
+    }
+    *fin = (bytes[0] & 0x80) != 0;
+    *opcode = bytes[0] & 0x0F;
+    BOOL masked = (bytes[1] & 0x80) != 0;
+    uint64_t payloadLength = bytes[1] & 0x7F;
+    NSUInteger offset = 2;
+    if(payloadLength == 126){
+        if(length < 4){
+            return nil;
+        }
+        payloadLength = ((uint64_t) bytes[2] << 8) | bytes[3];
+        offset = 4;
+    }
+    else if(payloadLength == 127){
+        if(length < 10){
+            return nil;
+        }
+        payloadLength = 0;
+        for(NSUInteger i = 0; i < 8; i++){
+            payloadLength = (payloadLength << 8) | bytes[2 + i];
+        }
+        offset = 10;
+    }
+    if(payloadLength > maxLength){
+        if(error){
+            *error = [NSError errorWithDomain:LBNetworkErrorDomain code:LBNetworkErrorChannelProtocolError userInfo:@{NSLocalizedDescriptionKey : @"The channel message is too long"}];
+        }
+        return nil;
+    }
+    const uint8_t *mask = NULL;
+    if(masked){
+        if(length < offset + 4){
+            return nil;
+        }
+        mask = bytes + offset;
+        offset += 4;
+    }
+    if(length - offset < payloadLength){
+        return nil;
+    }
+    NSMutableData *payload = [NSMutableData dataWithBytes:bytes + offset length:(NSUInteger) payloadLength];
+    if(mask){
+        uint8_t *payloadBytes = payload.mutableBytes;
+        for(NSUInteger i = 0; i < payloadLength; i++){
+            payloadBytes[i] ^= mask[i % 4];
+        }
+    }
+    *frameLength = offset + (NSUInteger) payloadLength;
+    return payload;
+}
+
+#pragma mark - keepalive
+
+-(void)startPingTimer{
+    [self stopPingTimer];
+    if(self.pingInterval <= 0){
+        return;
+    }
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.queue);
+    uint64_t interval = (uint64_t) (self.pingInterval * NSEC_PER_SEC);
+    dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t) interval), interval, interval / 10);
+    __weak LBChannel *weakSelf = self;
+    dispatch_source_set_event_handler(timer, ^{
+        LBChannel *channel = weakSelf;
+        if(CFAbsoluteTimeGetCurrent() - channel.lastReceive > 2 * channel.pingInterval){
+            [channel dropWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil]];
+            return;
+        }
+        [channel writeData:[LBChannel frameWithOpcode:LBChannelOpcodePing payload:[NSData data]]];
+    });
+    dispatch_resume(timer);
+    self.pingTimer = timer;
+}
+
+-(void)stopPingTimer{
+    if(self.pingTimer){
+        dispatch_source_cancel(self.pingTimer);
+        self.pingTimer = nil;
+    }
+}
+
+@end
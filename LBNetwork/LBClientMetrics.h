@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBClientMetrics.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Counters for a single LBHTTPSClient, safe to read from any thread.
+ * Attempts include retries, so attempts >= succeeded + failed.
+ */
+@interface LBClientMetrics : NSObject
+
+@property (nonatomic,assign,readonly)int64_t attempts;
+@property (nonatomic,assign,readonly)int64_t retries;
+@property (nonatomic,assign,readonly)int64_t succeeded;
+@property (nonatomic,assign,readonly)int64_t failed;
+@property (nonatomic,assign,readonly)int64_t bytesReceived;
+@property (nonatomic,assign,readonly)NSTimeInterval averageDuration;
+
+-(void)recordAttempt;
+-(void)recordRetry;
+-(void)recordSuccessWithBytes:(NSUInteger)bytes duration:(NSTimeInterval)duration;
+-(void)recordFailureWithDuration:(NSTimeInterval)duration;
+-(void)reset;
+
+-(NSDictionary *)dictionaryRepresentation;
+@end
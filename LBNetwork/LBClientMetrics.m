@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBClientMetrics.m
+//  LBNetwork
+//
+
+#import "LBClientMetrics.h"
+#import <stdatomic.h>
+
+@implementation LBClientMetrics {
+    atomic_llong attempts;
+    atomic_llong retries;
+    atomic_llong succeeded;
+    atomic_llong failed;
+    atomic_llong bytesReceived;
+    atomic_llong totalDurationMicroseconds;
+}
+
+-(int64_t)attempts{
+    return atomic_load(&attempts);
+}
+
+-(int64_t)retries{
+    return atomic_load(&retries);
+}
+
+-(int64_t)succeeded{
+    return atomic_load(&succeeded);
+}
+
+-(int64_t)failed{
+    return atomic_load(&failed);
+}
+
+-(int64_t)bytesReceived{
+    return atomic_load(&bytesReceived);
+}
+
+-(NSTimeInterval)averageDuration{
+    int64_t completed = self.succeeded + self.failed;
+    if(!completed){
+        return 0;
+    }
+    return atomic_load(&totalDurationMicroseconds) / 1e6 / completed;
+}
+
+-(void)recordAttempt{
+    atomic_fetch_add(&attempts, 1);
+}
+
+-(void)recordRetry{
+    atomic_fetch_add(&retries, 1);
+}
+
+-(void)recordSuccessWithBytes:(NSUInteger)bytes duration:(NSTimeInterval)duration{
+    atomic_fetch_add(&succeeded, 1);
+    atomic_fetch_add(&bytesReceived, (long long)bytes);
+    atomic_fetch_add(&totalDurationMicroseconds, (long long)(duration * 1e6));
+}
+
+-(void)recordFailureWithDuration:(NSTimeInterval)duration{
+    atomic_fetch_add(&failed, 1);
+    atomic_fetch_add(&totalDurationMicroseconds, (long long)(duration * 1e6));
+}
+
+-(void)reset{
+    atomic_store(&attempts, 0);
+    atomic_store(&retries, 0);
+    atomic_store(&succeeded, 0);
+    atomic_store(&failed, 0);
+    atomic_store(&bytesReceived, 0);
+    atomic_store(&totalDurationMicroseconds, 0);
+}
+
+-(NSDictionary *)dictionaryRepresentation{
+    return @{@"attempts":@(self.attempts),
+             @"retries":@(self.retries),
+             @"succeeded":@(self.succeeded),
+             @"failed":@(self.failed),
+             @"bytesReceived":@(self.bytesReceived),
+             @"averageDuration":@(self.averageDuration)};
+}
+
+-(NSString *)description{
+    return [NSString stringWithFormat:@"LBClientMetrics %@", [self dictionaryRepresentation]];
+}
+
+@end
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBConcurrencyLimiter.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Per-host limit on concurrent connections, adapted from observed latency and errors.
+ *
+ * Each host starts at initialLimit. Every successful completion grows the limit by
+ * 1/limit (about one connection per round trip), while a failure or a latency above
+ * latencyTolerance times the best latency seen recently shrinks it by backoffRatio,
+ * at most once per smoothed round trip. Work scheduled above the limit is queued in
+ * FIFO order and started as slots are released. A host with nothing in flight for
+ * idleTimeout seconds is forgotten and starts over at initialLimit.
+ */
+@interface LBConcurrencyLimiter : NSObject
+
+@property (nonatomic,assign)NSUInteger initialLimit;
+@property (nonatomic,assign)NSUInteger minLimit;
+@property (nonatomic,assign)NSUInteger maxLimit;
+@property (nonatomic,assign)double latencyTolerance;
+@property (nonatomic,assign)double backoffRatio;
+@property (nonatomic,assign)NSTimeInterval idleTimeout;
+
+-(void)scheduleForHost:(NSString *)host block:(dispatch_block_t)block;
+-(void)releaseForHost:(NSString *)host latency:(NSTimeInterval)latency failed:(BOOL)failed;
+/**
+ * Gives back a slot whose work never ran, without counting it towards the limit
+ */
+-(void)cancelForHost:(NSString *)host;
+
+-(NSUInteger)limitForHost:(NSString *)host;
+-(NSUInteger)inFlightForHost:(NSString *)host;
+-(NSUInteger)queuedForHost:(NSString *)host;
+@end
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBConcurrencyLimiter.m
+//  LBNetwork
+//
+
+#import "LBConcurrencyLimiter.h"
+
+#define kDefaultInitialLimit 6
+#define kDefaultMinLimit 1
+#define kDefaultMaxLimit 32
+#define kDefaultLatencyTolerance 2.0
+#define kDefaultBackoffRatio 0.7
+#define kLatencySmoothing 0.2
+#define kMinLatencyWindow 256
+#define kDefaultIdleTimeout 300.0
+
+@interface LBHostLimit : NSObject
+@property (nonatomic,assign)double limit;
+@property (nonatomic,assign)NSUInteger inFlight;
+@property (nonatomic,strong)NSMutableArray *queue;
+@property (nonatomic,assign)NSTimeInterval minLatency;
+@property (nonatomic,assign)NSTimeInterval smoothedLatency;
+@property (nonatomic,assign)NSUInteger samples;
+@property (nonatomic,assign)CFAbsoluteTime lastDecrease;
+@property (nonatomic,assign)CFAbsoluteTime lastUsed;
+@end
+
+@implementation LBHostLimit
+@end
+
+@interface LBConcurrencyLimiter ()
+@property (nonatomic,strong)NSMutableDictionary *hosts;
+@end
+
+@implementation LBConcurrencyLimiter
+
+-(instancetype)init{
+    self = [super init];
+    if(self){
+        _initialLimit = kDefaultInitialLimit;
+        _minLimit = kDefaultMinLimit;
+        _maxLimit = kDefaultMaxLimit;
+        _latencyTolerance = kDefaultLatencyTolerance;
+        _backoffRatio = kDefaultBackoffRatio;
+        _idleTimeout = kDefaultIdleTimeout;
+        self.hosts = [[NSMutableDictionary alloc]init];
+    }
+    return self;
+}
+
+-(LBHostLimit *)limitStateForHost:(NSString *)host{
+    NSString *key = host ?: @"";
+    LBHostLimit *state = self.hosts[key];
+    if(!state){
+        [self evictIdleHosts];
+        state = [[LBHostLimit alloc]init];
+        state.limit = self.initialLimit;
+        state.queue = [[NSMutableArray alloc]init];
+        state.lastUsed = CFAbsoluteTimeGetCurrent();
+        self.hosts[key] = state;
+    }
+    return state;
+}
+
+/**
+ * Drops hosts with nothing in flight or queued for idleTimeout, they start over at
+ * initialLimit when seen again. Called with the lock held.
+ */
+-(void)evictIdleHosts{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    NSMutableArray *idle = [[NSMutableArray alloc]init];
+    [self.hosts enumerateKeysAndObjectsUsingBlock:^(NSString *key, LBHostLimit *state, BOOL *stop) {
+        if(state.inFlight == 0 && state.queue.count == 0 && now - state.lastUsed >= self.idleTimeout){
+            [idle addObject:key];
+        }
+    }];
+    [self.hosts removeObjectsForKeys:idle];
+}
+
+-(void)scheduleForHost:(NSString *)host block:(dispatch_block_t)block{
+    BOOL runNow = NO;
+    @synchronized(self){
+        LBHostLimit *state = [self limitStateForHost:host];
+        if(state.inFlight < MAX(1, (NSUInteger)state.limit)){
+            state.inFlight++;
+            runNow = YES;
+        }
+        else{
+            [state.queue addObject:[block copy]];
+        }
+    }
+    if(runNow){
+        block();
+    }
+}
+
+-(void)releaseForHost:(NSString *)host latency:(NSTimeInterval)latency failed:(BOOL)failed{
+    [self releaseForHost:host adaptingLimit:YES latency:latency failed:failed];
+}
+
+-(void)cancelForHost:(NSString *)host{
+    [self releaseForHost:host adaptingLimit:NO latency:0 failed:NO];
+}
+
+-(void)releaseForHost:(NSString *)host adaptingLimit:(BOOL)adapt latency:(NSTimeInterval)latency failed:(BOOL)failed{
+    NSMutableArray *ready = [[NSMutableArray alloc]init];
+    @synchronized(self){
+        LBHostLimit *state = [self limitStateForHost:host];
+        if(state.inFlight > 0){
+            state.inFlight--;
+        }
+        if(adapt){
+            [self updateLimit:state latency:latency failed:failed];
+        }
+        state.lastUsed = CFAbsoluteTimeGetCurrent();
+        while(state.queue.count && state.inFlight < MAX(1, (NSUInteger)state.limit)){
+            [ready addObject:state.queue.firstObject];
+            [state.queue removeObjectAtIndex:0];
+            state.inFlight++;
+        }
+    }
+    for(dispatch_block_t block in ready){
+        block();
+    }
+}
+
+-(void)updateLimit:(LBHostLimit *)state latency:(NSTimeInterval)latency failed:(BOOL)failed{
+    BOOL congested = failed;
+    if(latency > 0){
+        state.samples++;
+        state.smoothedLatency = state.smoothedLatency > 0
+                ? state.smoothedLatency * (1 - kLatencySmoothing) + latency * kLatencySmoothing
+                : latency;
+        //forget the floor now and then so a route change does not pin us down forever
+        if(state.minLatency <= 0 || latency < state.minLatency || state.samples % kMinLatencyWindow == 0){
+            state.minLatency = state.samples % kMinLatencyWindow == 0 ? state.smoothedLatency : latency;
+        }
+        congested = congested || state.smoothedLatency > state.minLatency * self.latencyTolerance;
+    }
+
+    if(congested){
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        if(now - state.lastDecrease >= state.smoothedLatency){
+            state.limit = MAX((double)self.minLimit, state.limit * self.backoffRatio);
+            state.lastDecrease = now;
+        }
+    }
+    else{
+        state.limit = MIN((double)self.maxLimit, state.limit + 1.0 / state.limit);
+    }
+}
+
+-(NSUInteger)limitForHost:(NSString *)host{
+    @synchronized(self){
+        return (NSUInteger)[self limitStateForHost:host].limit;
+    }
+}
+
+-(NSUInteger)inFlightForHost:(NSString *)host{
+    @synchronized(self){
+        return [self limitStateForHost:host].inFlight;
+    }
+}
+
+-(NSUInteger)queuedForHost:(NSString *)host{
+    @synchronized(self){
+        return [self limitStateForHost:host].queue.count;
+    }
+}
+
+@end
@@ -23,8 +23,15 @@
 //
 
 #import <Foundation/Foundation.h>
+@class LBServerRequest;
 
 @protocol LBDeserializer <NSObject>
 
 -(id)deserialize:(NSData *)data toClass:(Class)clz;
+@optional
+/**
+ * Used instead of deserialize:toClass: when implemented, for deserializers that
+ * depend on the request, like caches keyed by its URL
+ */
+-(id)deserialize:(NSData *)data forRequest:(LBServerRequest *)request response:(NSHTTPURLResponse *)response;
 @end
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBDeserializerRegistry.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import "LBDeserializer.h"
+
+/**
+ * Immutable map from media types to deserializers.
+ *
+ * Registering produces a new registry, so readers never need a lock: they pick up the
+ * current snapshot and keep using it. Lookups ignore parameters and case and fall back
+ * from the exact "type/subtype" to the structured syntax suffix
+ * ("application/vnd.api+json" -> "application/json"), then to "type/*", then to the
+ * default deserializer. Resolved raw Content-Type strings are cached per snapshot.
+ */
+@interface LBDeserializerRegistry : NSObject
+
+@property (nonatomic,strong,readonly)id<LBDeserializer> defaultDeserializer;
+
+-(instancetype)initWithDefaultDeserializer:(id<LBDeserializer>)defaultDeserializer;
+-(instancetype)registryByAddingDeserializer:(id<LBDeserializer>)deserializer forContentType:(NSString *)contentType;
+-(instancetype)registryWithDefaultDeserializer:(id<LBDeserializer>)defaultDeserializer;
+
+-(id<LBDeserializer>)registeredDeserializerForContentType:(NSString *)contentType;
+-(id<LBDeserializer>)deserializerForContentType:(NSString *)contentType;
+@end
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBDeserializerRegistry.m
+//  LBNetwork
+//
+
+#import "LBDeserializerRegistry.h"
+#import "LBMediaType.h"
+
+#define kLookupCacheLimit 32
+
+@interface LBDeserializerRegistry ()
+@property (nonatomic,copy)NSDictionary *deserializers;
+@property (nonatomic,strong)NSCache *lookupCache;
+@end
+
+@implementation LBDeserializerRegistry
+
+-(instancetype)initWithDefaultDeserializer:(id<LBDeserializer>)defaultDeserializer{
+    return [self initWithDeserializers:@{} defaultDeserializer:defaultDeserializer];
+}
+
+-(instancetype)initWithDeserializers:(NSDictionary *)deserializers defaultDeserializer:(id<LBDeserializer>)defaultDeserializer{
+    self = [super init];
+    if(self){
+        _defaultDeserializer = defaultDeserializer;
+        self.deserializers = deserializers;
+        self.lookupCache = [[NSCache alloc]init];
+        self.lookupCache.countLimit = kLookupCacheLimit;
+    }
+    return self;
+}
+
+/**
+ * Media types are keyed by their essence, anything else by the exact string
+ */
++(NSString *)keyForContentType:(NSString *)contentType{
+    LBMediaType *mediaType = [LBMediaType mediaTypeWithString:contentType];
+    return mediaType ? mediaType.essence : [contentType copy];
+}
+
+-(instancetype)registryByAddingDeserializer:(id<LBDeserializer>)deserializer forContentType:(NSString *)contentType{
+    NSMutableDictionary *deserializers = [self.deserializers mutableCopy];
+    NSString *key = [LBDeserializerRegistry keyForContentType:contentType];
+    if(key){
+        deserializers[key] = deserializer;
+    }
+    return [[LBDeserializerRegistry alloc]initWithDeserializers:deserializers defaultDeserializer:self.defaultDeserializer];
+}
+
+-(instancetype)registryWithDefaultDeserializer:(id<LBDeserializer>)defaultDeserializer{
+    return [[LBDeserializerRegistry alloc]initWithDeserializers:self.deserializers defaultDeserializer:defaultDeserializer];
+}
+
+-(id<LBDeserializer>)registeredDeserializerForContentType:(NSString *)contentType{
+    NSString *key = [LBDeserializerRegistry keyForContentType:contentType];
+    return key ? self.deserializers[key] : nil;
+}
+
+-(id<LBDeserializer>)deserializerForContentType:(NSString *)contentType{
+    if(!contentType.length){
+        return self.defaultDeserializer;
+    }
+    id<LBDeserializer> deserializer = [self.lookupCache objectForKey:contentType];
+    if(deserializer){
+        return deserializer;
+    }
+    LBMediaType *mediaType = [LBMediaType mediaTypeWithString:contentType];
+    deserializer = (mediaType ? [self resolveMediaType:mediaType] : self.deserializers[contentType]) ?: self.defaultDeserializer;
+    if(deserializer){
+        [self.lookupCache setObject:deserializer forKey:contentType];
+    }
+    return deserializer;
+}
+
+-(id<LBDeserializer>)resolveMediaType:(LBMediaType *)mediaType{
+    if(!mediaType){
+        return nil;
+    }
+    id<LBDeserializer> deserializer = self.deserializers[mediaType.essence];
+    if(!deserializer && mediaType.suffix){
+        deserializer = self.deserializers[[NSString stringWithFormat:@"%@/%@", mediaType.type, mediaType.suffix]];
+    }
+    if(!deserializer){
+        deserializer = self.deserializers[[NSString stringWithFormat:@"%@/*", mediaType.type]];
+    }
+    if(!deserializer){
+        deserializer = self.deserializers[@"*/*"];
+    }
+    return deserializer;
+}
+
+@end
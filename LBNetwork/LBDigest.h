@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBDigest.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+typedef enum{
+    LBDigestAlgorithmNone,
+    LBDigestAlgorithmSHA256,
+    /**
+     * IEEE CRC-32, catches transfer corruption at a fraction of the cost of SHA-256
+     * but is no protection against tampering
+     */
+    LBDigestAlgorithmCRC32,
+}LBDigestAlgorithm;
+
+/**
+ * Incrementally computed digest, fed chunk by chunk as a body arrives
+ */
+@interface LBDigest : NSObject
+
+@property (nonatomic,assign,readonly)LBDigestAlgorithm algorithm;
+@property (nonatomic,assign,readonly)unsigned long long length;
+
++(instancetype)digestWithAlgorithm:(LBDigestAlgorithm)algorithm;
++(NSData *)digestOfData:(NSData *)data algorithm:(LBDigestAlgorithm)algorithm;
++(NSData *)dataWithHexString:(NSString *)hexString;
++(NSString *)hexStringWithData:(NSData *)data;
+
+-(void)updateWithData:(NSData *)data;
+/**
+ * Finishes the digest, CRC-32 is returned big endian. Further updates are ignored.
+ */
+-(NSData *)finalDigest;
+@end
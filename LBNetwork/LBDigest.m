@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBDigest.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import <CommonCrypto/CommonDigest.h>
+
+static uint32_t LBCRC32Table[256];
+
+static void LBCRC32InitializeTable(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        LBCRC32Table[i] = crc;
+    }
+}
+
+@interface LBDigest ()
+@property (nonatomic,assign,readwrite)LBDigestAlgorithm algorithm;
+@property (nonatomic,assign,readwrite)unsigned long long length;
+@property (nonatomic,strong)NSData *result;
+@end
+
+@implementation LBDigest {
+    CC_SHA256_CTX sha256;
+    uint32_t crc;
+}
+
++(instancetype)digestWithAlgorithm:(LBDigestAlgorithm)algorithm{
+    if (algorithm == LBDigestAlgorithmNone) {
+        return nil;
+    }
+    LBDigest *digest = [[self alloc]init];
+    digest.algorithm = algorithm;
+    [digest start];
+    return digest;
+}
+
++(NSData *)digestOfData:(NSData *)data algorithm:(LBDigestAlgorithm)algorithm{
+    LBDigest *digest = [self digestWithAlgorithm:algorithm];
+    [digest updateWithData:data];
+    return [digest finalDigest];
+}
+
+-(void)start{
+    switch (self.algorithm) {
+        case LBDigestAlgorithmSHA256:
+            CC_SHA256_Init(&sha256);
+            break;
+        case LBDigestAlgorithmCRC32: {
+            static dispatch_once_t onceToken;
+            dispatch_once(&onceToken, ^{
+                LBCRC32InitializeTable();
+            });
+            crc = 0xFFFFFFFFu;
+        }
+            break;
+        default:
+            break;
+    }
+}
+
+-(void)updateWithData:(NSData *)data{
+    if (self.result || !data.length) {
+        return;
+    }
+    self.length += data.length;
+    //NSData may be backed by several regions, walk them instead of flattening
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        [self updateWithBytes:bytes length:byteRange.length];
+    }];
+}
+
+-(void)updateWithBytes:(const void *)bytes length:(NSUInteger)length{
+    switch (self.algorithm) {
+        case LBDigestAlgorithmSHA256: {
+            const uint8_t *chunk = bytes;
+            //CC_LONG is 32 bits
+            while (length > 0) {
+                CC_LONG chunkLength = (CC_LONG) MIN(length, (NSUInteger) UINT32_MAX);
+                CC_SHA256_Update(&sha256, chunk, chunkLength);
+                chunk += chunkLength;
+                length -= chunkLength;
+            }
+        }
+            break;
+        case LBDigestAlgorithmCRC32: {
+            const uint8_t *byte = bytes;
+            uint32_t value = crc;
+            for (NSUInteger i = 0; i < length; i++) {
+                value = LBCRC32Table[(value ^ byte[i]) & 0xFF] ^ (value >> 8);
+            }
+            crc = value;
+        }
+            break;
+        default:
+            break;
+    }
+}
+
+-(NSData *)finalDigest{
+    if (self.result) {
+        return self.result;
+    }
+    switch (self.algorithm) {
+        case LBDigestAlgorithmSHA256: {
+            unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+            CC_SHA256_Final(digest, &sha256);
+            self.result = [NSData dataWithBytes:digest length:sizeof(digest)];
+        }
+            break;
+        case LBDigestAlgorithmCRC32: {
+            uint32_t value = CFSwapInt32HostToBig(crc ^ 0xFFFFFFFFu);
+            self.result = [NSData dataWithBytes:&value length:sizeof(value)];
+        }
+            break;
+        default:
+            self.result = [NSData data];
+            break;
+    }
+    return self.result;
+}
+
++(NSData *)dataWithHexString:(NSString *)hexString{
+    NSData *ascii = [hexString dataUsingEncoding:NSASCIIStringEncoding];
+    if (!ascii || ascii.length % 2) {
+        return nil;
+    }
+    const uint8_t *characters = ascii.bytes;
+    NSMutableData *data = [NSMutableData dataWithLength:ascii.length / 2];
+    uint8_t *bytes = data.mutableBytes;
+    for (NSUInteger i = 0; i < ascii.length; i++) {
+        uint8_t c = characters[i];
+        uint8_t nibble;
+        if (c >= '0' && c <= '9') {
+            nibble = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f') {
+            nibble = c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F') {
+            nibble = c - 'A' + 10;
+        }
+        else {
+            return nil;
+        }
+        bytes[i / 2] = (uint8_t) (i % 2 ? bytes[i / 2] | nibble : nibble << 4);
+    }
+    return data;
+}
+
++(NSString *)hexStringWithData:(NSData *)data{
+    static const char digits[] = "0123456789abcdef";
+    const uint8_t *bytes = data.bytes;
+    NSMutableString *hexString = [NSMutableString stringWithCapacity:data.length * 2];
+    for (NSUInteger i = 0; i < data.length; i++) {
+        [hexString appendFormat:@"%c%c", digits[bytes[i] >> 4], digits[bytes[i] & 0x0F]];
+    }
+    return hexString;
+}
+@end
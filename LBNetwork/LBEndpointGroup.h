@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBEndpointGroup.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Replicas of one API, requests naming the group are routed to the replica with the
+ * lowest score, its smoothed time to first byte plus its smoothed error rate times
+ * errorPenalty. Replicas not measured yet score 0 and are tried first, in order.
+ *
+ * Both the error rate and the smoothed latency of a replica decay with errorHalfLife
+ * while it gets no traffic, so a replica that failed or answered slowly drifts back
+ * toward unmeasured and is probed again.
+ */
+@interface LBEndpointGroup : NSObject
+
+@property (nonatomic,copy,readonly)NSString *name;
+@property (nonatomic,copy,readonly)NSArray<NSURL *> *baseURLs;
+@property (nonatomic,assign)double latencySmoothing;
+@property (nonatomic,assign)NSTimeInterval errorPenalty;
+@property (nonatomic,assign)NSTimeInterval errorHalfLife;
+
++(instancetype)groupWithName:(NSString *)name baseURLs:(NSArray<NSURL *> *)baseURLs;
+
+/**
+ * Best replica not in excluded, nil once every replica is excluded
+ */
+-(NSURL *)baseURLExcluding:(NSArray<NSURL *> *)excluded;
+-(void)recordLatency:(NSTimeInterval)latency failed:(BOOL)failed forBaseURL:(NSURL *)baseURL;
+
+-(NSTimeInterval)smoothedLatencyForBaseURL:(NSURL *)baseURL;
+-(double)errorRateForBaseURL:(NSURL *)baseURL;
+
+/**
+ * Errors that point at the replica rather than the device, worth failing over on.
+ * Errors that may come after the request was sent only count for idempotent methods.
+ */
++(BOOL)isFailoverError:(NSError *)error method:(NSString *)method;
+@end
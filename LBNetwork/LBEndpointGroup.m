@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBEndpointGroup.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+
+#define kDefaultLatencySmoothing 0.2
+#define kDefaultErrorPenalty 2.0
+#define kDefaultErrorHalfLife 30.0
+
+@interface LBEndpointReplica : NSObject
+@property (nonatomic,strong)NSURL *baseURL;
+@property (nonatomic,assign)NSTimeInterval smoothedLatency;
+@property (nonatomic,assign)double errorRate;
+@property (nonatomic,assign)CFAbsoluteTime lastUpdate;
+@end
+
+@implementation LBEndpointReplica
+@end
+
+@interface LBEndpointGroup ()
+@property (nonatomic,copy,readwrite)NSString *name;
+@property (nonatomic,copy,readwrite)NSArray<NSURL *> *baseURLs;
+@property (nonatomic,strong)NSArray<LBEndpointReplica *> *replicas;
+@end
+
+@implementation LBEndpointGroup
+
++(instancetype)groupWithName:(NSString *)name baseURLs:(NSArray<NSURL *> *)baseURLs{
+    LBEndpointGroup *group = [[self alloc]init];
+    group.name = name;
+    group.baseURLs = baseURLs;
+    NSMutableArray *replicas = [[NSMutableArray alloc]initWithCapacity:baseURLs.count];
+    for(NSURL *baseURL in baseURLs){
+        LBEndpointReplica *replica = [[LBEndpointReplica alloc]init];
+        replica.baseURL = baseURL;
+        [replicas addObject:replica];
+    }
+    group.replicas = replicas;
+    return group;
+}
+
+-(instancetype)init{
+    self = [super init];
+    if(self){
+        _latencySmoothing = kDefaultLatencySmoothing;
+        _errorPenalty = kDefaultErrorPenalty;
+        _errorHalfLife = kDefaultErrorHalfLife;
+    }
+    return self;
+}
+
+-(LBEndpointReplica *)replicaForBaseURL:(NSURL *)baseURL{
+    for(LBEndpointReplica *replica in self.replicas){
+        if([replica.baseURL isEqual:baseURL]){
+            return replica;
+        }
+    }
+    return nil;
+}
+
+-(double)errorRateOfReplica:(LBEndpointReplica *)replica now:(CFAbsoluteTime)now{
+    if(replica.errorRate <= 0 || self.errorHalfLife <= 0){
+        return replica.errorRate;
+    }
+    return replica.errorRate * pow(0.5, (now - replica.lastUpdate) / self.errorHalfLife);
+}
+
+-(NSTimeInterval)latencyOfReplica:(LBEndpointReplica *)replica now:(CFAbsoluteTime)now{
+    if(replica.smoothedLatency <= 0 || self.errorHalfLife <= 0){
+        return replica.smoothedLatency;
+    }
+    return replica.smoothedLatency * pow(0.5, (now - replica.lastUpdate) / self.errorHalfLife);
+}
+
+-(NSURL *)baseURLExcluding:(NSArray<NSURL *> *)excluded{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    LBEndpointReplica *best = nil;
+    double bestScore = 0;
+    @synchronized(self){
+        for(LBEndpointReplica *replica in self.replicas){
+            if([excluded containsObject:replica.baseURL]){
+                continue;
+            }
+            double score = [self latencyOfReplica:replica now:now] + [self errorRateOfReplica:replica now:now] * self.errorPenalty;
+            if(!best || score < bestScore){
+                best = replica;
+                bestScore = score;
+            }
+        }
+    }
+    return best.baseURL;
+}
+
+-(void)recordLatency:(NSTimeInterval)latency failed:(BOOL)failed forBaseURL:(NSURL *)baseURL{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    @synchronized(self){
+        LBEndpointReplica *replica = [self replicaForBaseURL:baseURL];
+        if(!replica){
+            return;
+        }
+        double errorRate = [self errorRateOfReplica:replica now:now];
+        NSTimeInterval smoothedLatency = [self latencyOfReplica:replica now:now];
+        replica.errorRate = errorRate * (1 - self.latencySmoothing) + (failed ? self.latencySmoothing : 0);
+        if(latency > 0 && !failed){
+            smoothedLatency = smoothedLatency > 0
+                    ? smoothedLatency * (1 - self.latencySmoothing) + latency * self.latencySmoothing
+                    : latency;
+        }
+        replica.smoothedLatency = smoothedLatency;
+        replica.lastUpdate = now;
+    }
+}
+
+-(NSTimeInterval)smoothedLatencyForBaseURL:(NSURL *)baseURL{
+    @synchronized(self){
+        LBEndpointReplica *replica = [self replicaForBaseURL:baseURL];
+        return replica ? [self latencyOfReplica:replica now:CFAbsoluteTimeGetCurrent()] : 0;
+    }
+}
+
+-(double)errorRateForBaseURL:(NSURL *)baseURL{
+    @synchronized(self){
+        LBEndpointReplica *replica = [self replicaForBaseURL:baseURL];
+        return replica ? [self errorRateOfReplica:replica now:CFAbsoluteTimeGetCurrent()] : 0;
+    }
+}
+
++(BOOL)isFailoverError:(NSError *)error method:(NSString *)method{
+    if(![error.domain isEqualToString:NSURLErrorDomain]){
+        return NO;
+    }
+    switch(error.code){
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorSecureConnectionFailed:
+            return YES;
+        //the request may have reached the replica already
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorTimedOut:
+        case NSURLErrorBadServerResponse:
+            return [self isIdempotentMethod:method];
+        default:
+            return NO;
+    }
+}
+
++(BOOL)isIdempotentMethod:(NSString *)method{
+    static NSSet *methods;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        methods = [NSSet setWithObjects:@"GET", @"HEAD", @"OPTIONS", @"PUT", @"DELETE", nil];
+    });
+    return [methods containsObject:method.uppercaseString ?: @"GET"];
+}
+
+@end
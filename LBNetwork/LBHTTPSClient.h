@@ -23,11 +23,27 @@
 //
 
 
+#import <Security/Security.h>
 #import "LBURLConnection.h"
 #import "LBServerRequest.h"
 @class LBServerResponse;
 @class LBURLConnectionProperties;
 @class UIImage;
+@class LBSegmentedDownload;
+@class LBConcurrencyLimiter;
+@class LBRequestJournal;
+@class LBClientMetrics;
+@class LBBufferPool;
+@class LBResponseCache;
+@class LBPrefetcher;
+@class LBImageEncoder;
+@class LBImageCache;
+@class LBEndpointGroup;
+@class LBRateLimiter;
+@class LBTracer;
+@class LBUploadDeduplicator;
+@class LBChannel;
+@protocol LBTransport;
 /**
  * HTTP Request methods
  */
@@ -47,6 +63,23 @@ extern NSString* const ContentTypeApplicationJavaScript;
 extern NSString* const DataContentTypeImage;
 extern NSString* const DataContentTypeFile;
 
+/**
+ * Errors raised by LBNetwork itself rather than by the URL loading system
+ */
+extern NSString* const LBNetworkErrorDomain;
+
+typedef enum{
+    LBNetworkErrorUnexpectedStatusCode = 1000,
+    LBNetworkErrorNotRecorded,
+    LBNetworkErrorRecordTooLarge,
+    LBNetworkErrorImageEncodingFailed,
+    LBNetworkErrorDigestMismatch,
+    LBNetworkErrorChannelHandshakeFailed,
+    LBNetworkErrorChannelProtocolError,
+    LBNetworkErrorChannelClosed,
+    LBNetworkErrorImageOverBudget,
+}LBNetworkErrorCode;
+
 @interface LBHTTPSClient:NSObject<NSURLConnectionDelegate>
 
 
@@ -58,12 +91,124 @@ extern NSString* const DataContentTypeFile;
 @property (nonatomic,assign)NSString *requestContentType;
 @property (nonatomic,strong)LBURLConnectionProperties *connectionProperties;
 @property (nonatomic, assign)BOOL certificateFromAuthority;
+/**
+ * Adaptive per-host limit on concurrent connections, nil to start every request immediately.
+ * Synchronous requests neither wait for a slot nor count toward the limit.
+ */
+@property (nonatomic,strong)LBConcurrencyLimiter *concurrencyLimiter;
+/**
+ * Token buckets requests wait on before the concurrency limiter, tightened by 429 and
+ * 503 responses. Synchronous requests are not held. nil to never wait.
+ */
+@property (nonatomic,strong)LBRateLimiter *rateLimiter;
+/**
+ * Durable outbox for requests marked journaled, nil by default
+ */
+@property (nonatomic,strong)LBRequestJournal *requestJournal;
+@property (nonatomic,strong,readonly)LBClientMetrics *metrics;
+/**
+ * Collects a span per pipeline stage of every request, nil by default
+ */
+@property (nonatomic,strong)LBTracer *tracer;
+/**
+ * Pool response bodies are received into, nil to allocate a fresh buffer per response.
+ * LBServerResponse.rawResponseData is always a copy, safe to keep past the handlers.
+ */
+@property (nonatomic,strong)LBBufferPool *bufferPool;
+/**
+ * What connections are loaded through, LBNetworkTransport by default.
+ * See LBLoopbackTransport and LBRecordReplayTransport for tests and benchmarks.
+ */
+@property (nonatomic,strong)id<LBTransport> transport;
+/**
+ * Backs LBRequestCacheModeStaleWhileRevalidate, in memory only by default
+ */
+@property (nonatomic,strong)LBResponseCache *responseCache;
+@property (nonatomic,strong,readonly)LBPrefetcher *prefetcher;
+/**
+ * Decoded images, GET requests found here are answered without the network.
+ * Filled by an LBImageDeserializer created with this cache, for example
+ * [client.connectionProperties registerDeserializer:[LBImageDeserializer deserializerWithCache:client.imageCache] forContentType:@"image/*"]
+ */
+@property (nonatomic,strong)LBImageCache *imageCache;
+/**
+ * Checks uploads against the server before sending their body, nil to always send it
+ */
+@property (nonatomic,strong)LBUploadDeduplicator *uploadDeduplicator;
+
+/**
+ * sharedClient is only a convenience, every client created with init or
+ * initWithConnectionProperties: has its own delegate queue, connection properties,
+ * trust roots, concurrency limiter and metrics.
+ */
+-(instancetype)initWithConnectionProperties:(LBURLConnectionProperties *)connectionProperties;
 
 +(instancetype)sharedClient;
 -(void)sendRequest:(LBServerRequest *)request;
+/**
+ * Blocks the calling thread until the response is handled. It bypasses both the
+ * rateLimiter and the concurrencyLimiter: it is never held, takes no slot and feeds
+ * neither of them, so a burst of synchronous calls is not throttled.
+ */
 - (void)startSynchronousRequest:(LBServerRequest *)request responseHandler:(LBServerResponseHandler)responseHandler;
 -(void)asyncUploadRequestData:(LBServerRequest *)serverRequest fileName:(NSString *)fileName;
+/**
+ * Downsamples and encodes image off the calling thread with encoder, a default
+ * LBImageEncoder when nil, then uploads it like asyncUploadRequestData:fileName:
+ * An image the encoder cannot bring within its targetByteCount fails the request
+ * with LBNetworkErrorImageOverBudget rather than being uploaded oversized.
+ */
+-(void)asyncUploadImage:(UIImage *)image request:(LBServerRequest *)serverRequest fileName:(NSString *)fileName encoder:(LBImageEncoder *)encoder;
 -(BOOL)addWithRootCA:(NSString *)caDerFilePath strictHostNameCheck:(BOOL)check;
 -(void)asyncUploadRequestRawData:(LBServerRequest *)serverRequest;
+/**
+ * Segmented download of a large resource into filePath, see LBSegmentedDownload.
+ * The first variant returns the download unstarted so it can be tuned before calling start.
+ */
+-(LBSegmentedDownload *)segmentedDownloadForRequest:(LBServerRequest *)request toFile:(NSString *)filePath;
+-(LBSegmentedDownload *)downloadRequest:(LBServerRequest *)request toFile:(NSString *)filePath;
+/**
+ * Starts a connection whose delegate is not the client, on queue, through the same rate
+ * limiter, concurrency limiter, metrics and activity indicator as sendRequest:.
+ * The delegate calls finishConnection:bytes:failed: once it is done with the connection,
+ * or stops it with cancelConnection:, so its limiter slot is given back. A cancelled
+ * connection neither grows nor backs off the host's concurrency limit.
+ */
+-(void)scheduleConnection:(LBURLConnection *)con delegateQueue:(NSOperationQueue *)queue;
+-(void)finishConnection:(LBURLConnection *)con bytes:(NSUInteger)bytes failed:(BOOL)failed;
+-(void)cancelConnection:(LBURLConnection *)con;
+/**
+ * Fetches a GET request ahead of time at the lowest priority, a later sendRequest:
+ * for the same URL is answered from the prefetched response. See LBPrefetcher.
+ */
+-(void)prefetchRequest:(LBServerRequest *)request;
+-(void)cancelPrefetches;
+/**
+ * Replicas requests are routed to by their endpointGroup, see LBEndpointGroup.
+ * A request failing with an LBEndpointGroup failover error is resent to the next
+ * best replica it has not tried before the retry policy is consulted.
+ */
+-(void)addEndpointGroup:(LBEndpointGroup *)group;
+-(LBEndpointGroup *)endpointGroupNamed:(NSString *)name;
+/**
+ * Unopened push channel to a ws or wss URL, see LBChannel. With custom roots wss
+ * channels are trusted through shouldTrustServerTrust:forHost:
+ */
+-(LBChannel *)channelWithURL:(NSURL *)URL;
+/**
+ * Whether servers are held to the roots from addWithRootCA:strictHostNameCheck:
+ * rather than the system ones
+ */
+-(BOOL)hasCustomRootCAs;
+/**
+ * Evaluates serverTrust with the roots and hostname check from addWithRootCA:strictHostNameCheck:.
+ * Without custom roots it is the system evaluation, the hostname is always checked.
+ */
+-(BOOL)shouldTrustServerTrust:(SecTrustRef)serverTrust forHost:(NSString *)host;
+/**
+ * Requests currently holding the process wide network activity indicator
+ */
++(NSInteger)networkActivityCount;
 +(BOOL)shouldLog;
+-(BOOL)shouldLog;
 @end
@@ -24,6 +24,7 @@
 
 #import "LBNetwork.h"
 #import "Logging.h"
+#import <stdatomic.h>
 NSString *const kMethodGET = @"GET";
 NSString *const kMethodPOST = @"POST";
 NSString *const kMethodPUT = @"PUT";
@@ -38,7 +39,9 @@ NSString *const ContentTypeApplicationJavaScript = @"application/javascript";
 NSString *const DataContentTypeImage = @"image/jpeg";
 NSString *const DataContentTypeFile = @"application/octet-stream";
 
-#define LBShowLog [LBHTTPSClient shouldLog]
+NSString *const LBNetworkErrorDomain = @"LBNetworkErrorDomain";
+
+#define LBShowLog [self shouldLog]
 #define LBLogDebug(fmt, ...) if (LBShowLog) LogDebug(fmt,##__VA_ARGS__)
 #define LBLogInfo(fmt, ...)  if (LBShowLog) LogInfo(fmt,##__VA_ARGS__)
 #define LBLogError(fmt, ...) if (LBShowLog) LogError(fmt,##__VA_ARGS__)
@@ -46,14 +49,17 @@ NSString *const DataContentTypeFile = @"application/octet-stream";
 @interface LBHTTPSClient ()
 @property (nonatomic, strong) UIAlertView *alert;
 @property (nonatomic, strong) NSOperationQueue *connectionQueue;
+@property (nonatomic, strong) NSMutableDictionary *endpointGroups;
 @end
 
 @implementation LBHTTPSClient {
     CFArrayRef caChainArrayRef;
     BOOL checkHostname;
+    atomic_long foregroundConnections;
 }
 
 static id sharedClient;
+static NSInteger networkActivityCount;
 
 + (instancetype)sharedClient {
     static dispatch_once_t onceToken;
@@ -65,6 +71,13 @@ static id sharedClient;
 }
 
 - (id)init {
+    LBURLConnectionProperties *connectionProperties = [[LBURLConnectionProperties alloc] init];
+    connectionProperties.maxRetryCount = 3;
+    connectionProperties.logLevel = LogLevelDebug;
+    return [self initWithConnectionProperties:connectionProperties];
+}
+
+- (instancetype)initWithConnectionProperties:(LBURLConnectionProperties *)connectionProperties {
     if (self = [super init]) {
         /**
          * Defaults for HTTP requests
@@ -81,63 +94,181 @@ static id sharedClient;
          * Default request content type
          */
         _requestContentType = ContentTypeAutomatic;
-        self.connectionProperties = [[LBURLConnectionProperties alloc] init];
-        self.connectionProperties.maxRetryCount = 3;
-        self.connectionProperties.logLevel = LogLevelDebug;
+        self.connectionProperties = connectionProperties;
         self.connectionQueue = [[NSOperationQueue alloc] init];
-        self.connectionQueue.name = @"LBNetworkQueue";
+        self.connectionQueue.name = [NSString stringWithFormat:@"LBNetworkQueue.%p", self];
+        _metrics = [[LBClientMetrics alloc] init];
+        self.bufferPool = [[LBBufferPool alloc] init];
+        self.transport = [[LBNetworkTransport alloc] init];
+        self.responseCache = [[LBResponseCache alloc] init];
+        _prefetcher = [[LBPrefetcher alloc] initWithClient:self];
+        self.imageCache = [[LBImageCache alloc] init];
+        self.endpointGroups = [[NSMutableDictionary alloc] init];
+        atomic_init(&foregroundConnections, 0);
+        self.concurrencyLimiter = [[LBConcurrencyLimiter alloc] init];
+        self.rateLimiter = [[LBRateLimiter alloc] init];
         self.certificateFromAuthority = YES;
     }
     return self;
 }
 
-+ (NSString *)contentTypeForRequestString:(NSString *)requestString {
-    //fetch the charset name from the default string encoding
-    NSString *contentType = ContentTypeAutomatic; //requestContentType;
+#pragma mark - request with authentication challenge
 
-    if (requestString.length > 0 && [contentType isEqualToString:ContentTypeAutomatic]) {
-        //check for "eventual" JSON array or dictionary
-        NSString *firstAndLastChar = [NSString stringWithFormat:@"%@%@",
-                                                                [requestString substringToIndex:1],
-                                                                [requestString substringFromIndex:requestString.length - 1]];
+- (void)asyncRequestDataForServerRequest:(LBServerRequest *)serverRequest {
 
-        if ([firstAndLastChar isEqualToString:@"{}"] || [firstAndLastChar isEqualToString:@"[]"]) {
-            //guessing for a JSON request
-            contentType = ContentTypeJSON;
-        }
-        else {
-            //fallback to www form encoded params
-            contentType = ContentTypeWWWEncoded;
-        }
+    CFAbsoluteTime setupStart = [self.tracer timestamp];
+    [self setupRequest:serverRequest];
+    [self.tracer recordSpan:"setupRequest" trace:serverRequest.traceID start:setupStart];
+
+    if ([self deliverCachedImageForRequest:serverRequest]) {
+        return;
+    }
+    if ([self deliverPrefetchedResponseForRequest:serverRequest]) {
+        return;
+    }
+    if ([self deliverCachedResponseForRequest:serverRequest]) {
+        return;
     }
 
-    //type is set, just add charset
-    NSString *charset = (NSString *) CFStringConvertEncodingToIANACharSetName(CFStringConvertNSStringEncodingToEncoding(NSUTF8StringEncoding));
-    return [NSString stringWithFormat:@"%@; charset=%@", contentType, charset];
+    //fire the request
+    [self startRequest:serverRequest];
 }
 
-#pragma mark - request with authentication challenge
+- (BOOL)deliverCachedImageForRequest:(LBServerRequest *)serverRequest {
+    //decoded images have no body left to digest
+    if (!self.imageCache.count || serverRequest.ignoresImageCache || serverRequest.digestAlgorithm != LBDigestAlgorithmNone
+            || ![LBImageCache isCacheableRequest:serverRequest.httpRequest]) {
+        return NO;
+    }
+    NSURL *URL = serverRequest.httpRequest.URL;
+    UIImage *image = [self.imageCache imageForURL:URL pixelSize:serverRequest.imageMaxPixelSize];
+    if (!image) {
+        return NO;
+    }
+    [self.connectionQueue addOperationWithBlock:^{
+        LBLogDebug(@"delivering cached image for:%@", URL);
+        NSHTTPURLResponse *rawResponse = [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:kHTTPStatusCodeOK HTTPVersion:@"HTTP/1.1" headerFields:nil];
+        LBServerResponse *response = [LBServerResponse handleServerResponse:rawResponse request:serverRequest data:nil deserializer:nil error:nil];
+        response.output = image;
+        [self handleResponse:response];
+        [serverRequest cleanUp];
+    }];
+    return YES;
+}
 
-- (void)asyncRequestDataForServerRequest:(LBServerRequest *)serverRequest {
+- (BOOL)deliverPrefetchedResponseForRequest:(LBServerRequest *)serverRequest {
+    if (![serverRequest.method isEqualToString:kMethodGET]) {
+        return NO;
+    }
+    LBCachedResponse *prefetchedResponse = [self.prefetcher takeResponseForRequest:serverRequest.httpRequest];
+    NSData *digest = nil;
+    if (!prefetchedResponse || ![self verifyStoredBody:prefetchedResponse.body forRequest:serverRequest digest:&digest]) {
+        return NO;
+    }
+    NSHTTPURLResponse *rawResponse = [prefetchedResponse responseForURL:serverRequest.httpRequest.URL];
+    if (serverRequest.cacheMode == LBRequestCacheModeStaleWhileRevalidate) {
+        [self.responseCache storeResponse:rawResponse data:prefetchedResponse.body forRequest:serverRequest.httpRequest];
+    }
+    [self.connectionQueue addOperationWithBlock:^{
+        LBLogDebug(@"delivering prefetched response for:%@", rawResponse.URL);
+        id <LBDeserializer> deserializer = [self.connectionProperties deserializerForContentType:[LBURLConnection responseContentType:rawResponse]];
+        LBServerResponse *response = [LBServerResponse handleServerResponse:rawResponse request:serverRequest data:prefetchedResponse.body deserializer:deserializer error:nil];
+        response.digest = digest;
+        [self handleResponse:response];
+        [serverRequest cleanUp];
+    }];
+    return YES;
+}
 
-    [self setupRequest:serverRequest];
+/**
+ * Stale while revalidate: hands the cached response to the handlers and only then
+ * starts the conditional request, so the fresh response can never overtake it
+ */
+- (BOOL)deliverCachedResponseForRequest:(LBServerRequest *)serverRequest {
+    serverRequest.cachedResponse = nil;
+    if (serverRequest.cacheMode != LBRequestCacheModeStaleWhileRevalidate || !self.responseCache || serverRequest.recordFramer) {
+        return NO;
+    }
+    LBCachedResponse *cachedResponse = [self.responseCache cachedResponseForRequest:serverRequest.httpRequest];
+    NSData *digest = nil;
+    if (!cachedResponse || ![self verifyStoredBody:cachedResponse.body forRequest:serverRequest digest:&digest]) {
+        return NO;
+    }
+    serverRequest.cachedResponse = cachedResponse;
+    if (cachedResponse.entityTag) {
+        [serverRequest.httpRequest setValue:cachedResponse.entityTag forHTTPHeaderField:@"If-None-Match"];
+    }
+    if (cachedResponse.lastModified) {
+        [serverRequest.httpRequest setValue:cachedResponse.lastModified forHTTPHeaderField:@"If-Modified-Since"];
+    }
 
-    //fire the request
-    [self startRequest:serverRequest];
+    NSHTTPURLResponse *rawResponse = [cachedResponse responseForURL:serverRequest.httpRequest.URL];
+    [self.connectionQueue addOperationWithBlock:^{
+        LBLogDebug(@"delivering stale response for:%@", rawResponse.URL);
+        id <LBDeserializer> deserializer = [self.connectionProperties deserializerForContentType:[LBURLConnection responseContentType:rawResponse]];
+        LBServerResponse *response = [LBServerResponse handleServerResponse:rawResponse request:serverRequest data:cachedResponse.body deserializer:deserializer error:nil];
+        response.stale = YES;
+        response.digest = digest;
+        [self handleResponse:response];
+        [self startRequest:serverRequest];
+    }];
+    return YES;
+}
+
+/**
+ * Digests a body served without a connection, NO when it differs from the request's
+ * expectedDigest and has to be fetched instead
+ */
+- (BOOL)verifyStoredBody:(NSData *)body forRequest:(LBServerRequest *)request digest:(NSData **)digest {
+    *digest = [LBDigest digestOfData:body ?: [NSData data] algorithm:request.digestAlgorithm];
+    if (!request.expectedDigest || !*digest || [*digest isEqualToData:request.expectedDigest]) {
+        return YES;
+    }
+    LBLogDebug(@"stored response for %@ does not match its expected digest", request.httpRequest.URL);
+    return NO;
+}
+
+/**
+ * Stores a revalidated response and tells whether the handlers should see it, which
+ * they should not when it matches the stale response they already have
+ */
+- (BOOL)revalidateCachedResponseForConnection:(LBURLConnection *)con {
+    LBServerRequest *request = con.request;
+    if (request.cacheMode != LBRequestCacheModeStaleWhileRevalidate || !self.responseCache || request.recordFramer) {
+        return YES;
+    }
+    LBCachedResponse *cachedResponse = request.cachedResponse;
+    NSInteger statusCode = con.rawResponse.statusCode;
+    if (statusCode == kHTTPStatusCodeNotModified && cachedResponse) {
+        return NO;
+    }
+    if (statusCode >= 200 && statusCode < 300) {
+        BOOL unchanged = cachedResponse && cachedResponse.statusCode == statusCode && [cachedResponse.body isEqualToData:con.data];
+        //stored either way, the validators may have changed
+        [self.responseCache storeResponse:con.rawResponse data:con.data forRequest:[con originalRequest]];
+        return !unchanged;
+    }
+    //a failed revalidation leaves the handlers with the stale response
+    return cachedResponse == nil;
 }
 
 - (LBServerRequest *)setupRequest:(LBServerRequest *)serverRequest {
+    if (serverRequest.preparedHTTPRequest && serverRequest.httpRequest) {
+        //built and encoded by an LBRequestTemplate
+        return serverRequest;
+    }
+    [self resolveEndpointForRequest:serverRequest];
+
     NSMutableURLRequest *httpRequest = [[NSMutableURLRequest alloc] initWithURL:serverRequest.requestURL
                                                                     cachePolicy:_defaultCachePolicy
                                                                 timeoutInterval:serverRequest.requestTimeoutSeconds];
     [httpRequest setHTTPMethod:serverRequest.method];
 
+    NSData *requestBodyData = serverRequest.requestBodyData;
     if ([_requestContentType isEqualToString:ContentTypeAutomatic]) {
-        //automatic content type
-        if (serverRequest.requestBodyData) {
-            NSString *bodyString = [[NSString alloc] initWithData:serverRequest.requestBodyData
-                                                         encoding:NSUTF8StringEncoding];
-            [httpRequest setValue:[LBHTTPSClient contentTypeForRequestString:bodyString]
+        //automatic content type, guessed from the body bytes
+        if (requestBodyData) {
+            [httpRequest setValue:LBContentTypeForRequestBody(requestBodyData)
                forHTTPHeaderField:@"Content-type"];
         }
     }
@@ -146,37 +277,28 @@ static id sharedClient;
         [httpRequest setValue:_requestContentType forHTTPHeaderField:@"Content-type"];
     }
 
-
     //add the custom headers
-    for (NSString *key in [serverRequest.headers allKeys]) {
-        [httpRequest setValue:serverRequest.headers[key] forHTTPHeaderField:key];
+    [serverRequest.headers enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop) {
+        [httpRequest setValue:value forHTTPHeaderField:key];
+    }];
+    [serverRequest.basicAuthHeaders enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop) {
+        [httpRequest setValue:value forHTTPHeaderField:key];
+    }];
+
+    if (requestBodyData && ![serverRequest.method isEqualToString:kMethodGET]) {
+        [httpRequest setHTTPBody:requestBodyData];
+        [httpRequest setValue:[NSString stringWithFormat:@"%lu", (unsigned long) requestBodyData.length] forHTTPHeaderField:@"Content-Length"];
     }
-    for (NSString *key in [serverRequest.basicAuthHeaders allKeys]) {
-        [httpRequest setValue:serverRequest.basicAuthHeaders[key] forHTTPHeaderField:key];
-    }
-    
-    if (serverRequest.requestBodyData && ![serverRequest.method isEqualToString:kMethodGET]) {
-        [httpRequest setHTTPBody:serverRequest.requestBodyData];
-        [httpRequest setValue:[NSString stringWithFormat:@"%lu", (unsigned long) serverRequest.requestBodyData.length] forHTTPHeaderField:@"Content-Length"];
-    }
-
-    if ([serverRequest.method isEqualToString:kMethodGET]) {
-        NSMutableArray *pathWithParams = [[NSMutableArray alloc] init];
-        NSMutableString *path = [serverRequest.path mutableCopy];
 
-        for (NSString *key in [serverRequest.params allKeys]) {
-            NSString *param = [NSString stringWithFormat:@"%@=%@", key, [serverRequest.params objectForKey:key]];
-            [pathWithParams addObject:param];
-            LBLogDebug(@"added param:%@", param);
+    if ([serverRequest.method isEqualToString:kMethodGET] && serverRequest.params.count) {
+        NSMutableString *path = [[serverRequest requestURLString] mutableCopy];
+        if ([path rangeOfString:@"?"].location == NSNotFound) {
+            [path appendString:@"?"];
         }
-
-        if (pathWithParams.count) {
-            if (![path hasSuffix:@"?"]) {
-                [path appendString:@"?"];
-                LBLogDebug(@"added '?'");
-            }
-            [path appendFormat:@"%@", [pathWithParams componentsJoinedByString:@"&"]];
+        else if (![path hasSuffix:@"?"] && ![path hasSuffix:@"&"]) {
+            [path appendString:@"&"];
         }
+        [path appendString:LBQueryStringFromParameters(serverRequest.params)];
         [httpRequest setURL:[NSURL URLWithString:path]];
         LBLogDebug(@"path with params:%@", [[httpRequest URL] absoluteString]);
     }
@@ -188,28 +310,180 @@ static id sharedClient;
 
 - (void)startSynchronousRequest:(LBServerRequest *)request responseHandler:(LBServerResponseHandler)responseHandler {
 
-    [[UIApplication sharedApplication] setNetworkActivityIndicatorVisible:YES];
     NSHTTPURLResponse *response = nil;
     NSError *error = nil;
     request = [self setupRequest:request];
-    NSData *result = [LBURLConnection sendSynchronousRequest:request.httpRequest returningResponse:&response error:&error];
+    BOOL showsIndicator = [self shouldShowActivityIndicatorForRequest:request.httpRequest];
+    if (showsIndicator) {
+        [LBHTTPSClient networkActivityDidChange:1];
+    }
+    [self.metrics recordAttempt];
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    NSData *result = [self.transport sendSynchronousRequest:request.httpRequest returningResponse:&response error:&error];
+    if (showsIndicator) {
+        [LBHTTPSClient networkActivityDidChange:-1];
+    }
+    if (error) {
+        [self.metrics recordFailureWithDuration:CFAbsoluteTimeGetCurrent() - startTime];
+    }
+    else {
+        [self.metrics recordSuccessWithBytes:result.length duration:CFAbsoluteTimeGetCurrent() - startTime];
+    }
     request.responseHandler = responseHandler;
-    id <LBDeserializer> deserializer = [self.connectionProperties deserializerForContentType:[LBURLConnection responseContentType:response]];
-    [self handleResponse:[LBServerResponse handleServerResponse:response request:request data:result deserializer:deserializer error:error]];
+    //the body arrives whole, digested in one pass
+    LBDigest *digest = [LBDigest digestWithAlgorithm:request.digestAlgorithm];
+    [digest updateWithData:result];
+    if (!error && request.expectedDigest && digest && response.statusCode >= 200 && response.statusCode < 300 && ![[digest finalDigest] isEqualToData:request.expectedDigest]) {
+        error = [self digestMismatchErrorWithDigest:[digest finalDigest] expectedDigest:request.expectedDigest];
+    }
+    id <LBDeserializer> deserializer = error ? nil : [self.connectionProperties deserializerForContentType:[LBURLConnection responseContentType:response]];
+    LBServerResponse *serverResponse = [LBServerResponse handleServerResponse:response request:request data:result deserializer:deserializer error:error];
+    serverResponse.digest = [digest finalDigest];
+    [self handleResponse:serverResponse];
 }
 
 - (void)startRequest:(LBServerRequest *)request {
     LBURLConnection *con = [[LBURLConnection alloc] initWithRequest:request delegate:self];
     con.retries = 1;
-    if ([[self.connectionProperties errorHandler] shouldDisplayActivityIndicatorForRequest:[con originalRequest]]) {
-        [[UIApplication sharedApplication] setNetworkActivityIndicatorVisible:YES];
+    [self scheduleConnection:con];
+}
+
+- (void)scheduleConnection:(LBURLConnection *)con {
+    con.scheduleTime = [self.tracer timestamp];
+    if (!self.rateLimiter) {
+        [self limitConnection:con];
+        return;
     }
-    [con setDelegateQueue:self.connectionQueue];
-    [con start];
+    //waiting for a token does not hold a concurrency slot
+    [self.rateLimiter scheduleForURL:[[con originalRequest] URL] block:^{
+        [self limitConnection:con];
+    }];
+}
+
+- (void)limitConnection:(LBURLConnection *)con {
+    if (!self.concurrencyLimiter) {
+        [self startConnection:con];
+        return;
+    }
+    [self.concurrencyLimiter scheduleForHost:[[con originalRequest] URL].host block:^{
+        [self startConnection:con];
+    }];
+}
+
+- (void)scheduleConnection:(LBURLConnection *)con delegateQueue:(NSOperationQueue *)queue {
+    con.delegateQueue = queue;
+    [self scheduleConnection:con];
+}
+
+- (void)startConnection:(LBURLConnection *)con {
+    @synchronized (con) {
+        if (con.isCancelled) {
+            //cancelled while waiting for the limiters, the slot goes to the next one in line
+            [self.concurrencyLimiter cancelForHost:[[con originalRequest] URL].host];
+            return;
+        }
+        con.startTime = CFAbsoluteTimeGetCurrent();
+    }
+    con.showsActivityIndicator = !con.prefetch && [self shouldShowActivityIndicatorForRequest:[con originalRequest]];
+    if (con.showsActivityIndicator) {
+        [LBHTTPSClient networkActivityDidChange:1];
+    }
+    [self.metrics recordAttempt];
+    if (!con.prefetch) {
+        [self.prefetcher foregroundLoadDidChange:(NSUInteger) (atomic_fetch_add(&foregroundConnections, 1) + 1)];
+    }
+    //rate and concurrency limiter wait
+    [self.tracer recordSpan:"queueWait" trace:con.request.traceID start:con.scheduleTime end:con.startTime detail:nil];
+    if (self.tracer) {
+        [self.tracer recordInstant:"connectionStart" trace:con.request.traceID detail:[[con originalRequest] URL].absoluteString];
+    }
+    [self.transport startConnection:con delegateQueue:con.delegateQueue ?: self.connectionQueue];
     LBLogDebug(@"started connection");
 }
 
+- (void)finishConnection:(LBURLConnection *)con bytes:(NSUInteger)bytes failed:(BOOL)failed {
+    [self hideActivityIndicatorForConnection:con];
+    if (failed) {
+        [self.metrics recordFailureWithDuration:CFAbsoluteTimeGetCurrent() - con.startTime];
+    }
+    else {
+        [self.metrics recordSuccessWithBytes:bytes duration:CFAbsoluteTimeGetCurrent() - con.startTime];
+    }
+    [self releaseConnection:con failed:failed];
+}
+
+- (void)cancelConnection:(LBURLConnection *)con {
+    BOOL started;
+    @synchronized (con) {
+        [con cancel];
+        started = con.startTime > 0;
+    }
+    //one that never started is released by startConnection: once the limiters let it through
+    if (!started) {
+        return;
+    }
+    [self hideActivityIndicatorForConnection:con];
+    //we stopped it, that says nothing about the host, only the slot is given back
+    [self.concurrencyLimiter cancelForHost:[[con originalRequest] URL].host];
+    if (!con.prefetch) {
+        [self.prefetcher foregroundLoadDidChange:(NSUInteger) MAX(0, atomic_fetch_sub(&foregroundConnections, 1) - 1)];
+    }
+}
+
+- (BOOL)shouldShowActivityIndicatorForRequest:(NSURLRequest *)request {
+    return self.doesControlIndicator && [[self.connectionProperties errorHandler] shouldDisplayActivityIndicatorForRequest:request];
+}
+
+- (void)hideActivityIndicatorForConnection:(LBURLConnection *)con {
+    if (con.showsActivityIndicator) {
+        con.showsActivityIndicator = NO;
+        [LBHTTPSClient networkActivityDidChange:-1];
+    }
+}
+
+/**
+ * The indicator is process wide, so it is reference counted across all client instances
+ */
++ (void)networkActivityDidChange:(NSInteger)delta {
+    @synchronized ([LBHTTPSClient class]) {
+        networkActivityCount = MAX(0, networkActivityCount + delta);
+    }
+    dispatch_async(dispatch_get_main_queue(), ^{
+        NSInteger count;
+        @synchronized ([LBHTTPSClient class]) {
+            count = networkActivityCount;
+        }
+        [[UIApplication sharedApplication] setNetworkActivityIndicatorVisible:count > 0];
+    });
+}
+
++ (NSInteger)networkActivityCount {
+    @synchronized ([LBHTTPSClient class]) {
+        return networkActivityCount;
+    }
+}
+
+- (void)releaseConnection:(LBURLConnection *)con failed:(BOOL)failed {
+    //time to first byte, connections that never got a response carry no latency sample
+    NSTimeInterval latency = con.responseTime > 0 ? con.responseTime - con.startTime : 0;
+    [self.concurrencyLimiter releaseForHost:[[con originalRequest] URL].host latency:latency failed:failed];
+    [self.rateLimiter recordResponse:con.rawResponse forURL:[[con originalRequest] URL]];
+    if (con.request.endpointBaseURL) {
+        [[self endpointGroupNamed:con.request.endpointGroup] recordLatency:latency failed:failed forBaseURL:con.request.endpointBaseURL];
+    }
+    if (!con.prefetch) {
+        [self.prefetcher foregroundLoadDidChange:(NSUInteger) MAX(0, atomic_fetch_sub(&foregroundConnections, 1) - 1)];
+    }
+}
+
 - (void)asyncUploadRequestRawData:(LBServerRequest *)serverRequest {
+    [self deduplicateUpload:serverRequest upload:^{
+        [self startUploadRequestRawData:serverRequest];
+    }];
+}
+
+- (void)startUploadRequestRawData:(LBServerRequest *)serverRequest {
+    [self resolveEndpointForRequest:serverRequest];
     NSMutableURLRequest *httpRequest = [[NSMutableURLRequest alloc] initWithURL:serverRequest.requestURL];
     [httpRequest setCachePolicy:_defaultCachePolicy];
     [httpRequest setHTTPShouldHandleCookies:NO];
@@ -231,6 +505,13 @@ static id sharedClient;
 }
 
 - (void)asyncUploadRequestData:(LBServerRequest *)serverRequest fileName:(NSString *)fileName {
+    [self deduplicateUpload:serverRequest upload:^{
+        [self startUploadRequestData:serverRequest fileName:fileName];
+    }];
+}
+
+- (void)startUploadRequestData:(LBServerRequest *)serverRequest fileName:(NSString *)fileName {
+    [self resolveEndpointForRequest:serverRequest];
     NSMutableURLRequest *httpRequest = [[NSMutableURLRequest alloc] initWithURL:serverRequest.requestURL];
     [httpRequest setCachePolicy:_defaultCachePolicy];
     [httpRequest setHTTPShouldHandleCookies:NO];
@@ -247,8 +528,8 @@ static id sharedClient;
     NSString *contentType = [NSString stringWithFormat:@"multipart/form-data; boundary=%@", boundary];
     [httpRequest setValue:contentType forHTTPHeaderField:@"Content-Type"];
 
-    // post body
-    NSMutableData *body = [NSMutableData data];
+    // post body, presized for the payload plus the part headers
+    NSMutableData *body = [NSMutableData dataWithCapacity:serverRequest.requestBodyData.length + 256 * (serverRequest.params.count + 2)];
 
     // add params (all params are strings)
     for (NSString *key in [serverRequest.params allKeys]) {
@@ -281,38 +562,238 @@ static id sharedClient;
     [self startRequest:serverRequest];
 }
 
+#pragma mark - upload deduplication
+
+- (void)deduplicateUpload:(LBServerRequest *)serverRequest upload:(dispatch_block_t)upload {
+    LBUploadDeduplicator *deduplicator = self.uploadDeduplicator;
+    //params only travel with the upload itself
+    if (!deduplicator || !serverRequest.requestBodyData.length || serverRequest.params.count) {
+        upload();
+        return;
+    }
+    [deduplicator digestData:serverRequest.requestBodyData completion:^(NSData *digest) {
+        LBServerRequest *lookup = [deduplicator lookupRequestForDigest:digest upload:serverRequest];
+        lookup.responseHandler = ^(LBServerResponse *response) {
+            if ([deduplicator lookupFoundDigest:response]) {
+                [self deliverDeduplicatedUpload:serverRequest lookupResponse:response];
+                return;
+            }
+            //unknown to the server or the lookup failed, either way the body goes
+            if (deduplicator.digestHeaderField) {
+                NSMutableDictionary *headers = [serverRequest.headers mutableCopy] ?: [NSMutableDictionary dictionary];
+                headers[deduplicator.digestHeaderField] = [LBDigest hexStringWithData:digest];
+                serverRequest.headers = headers;
+            }
+            upload();
+        };
+        [self sendRequest:lookup];
+    }];
+}
+
+/**
+ * The lookup's response stands in for the upload's, see LBUploadDeduplicator
+ */
+- (void)deliverDeduplicatedUpload:(LBServerRequest *)serverRequest lookupResponse:(LBServerResponse *)lookupResponse {
+    [self resolveEndpointForRequest:serverRequest];
+    NSURL *URL = serverRequest.requestURL;
+    [self.connectionQueue addOperationWithBlock:^{
+        LBLogDebug(@"upload to %@ deduplicated", URL);
+        NSHTTPURLResponse *rawResponse = [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:lookupResponse.statusCode HTTPVersion:@"HTTP/1.1" headerFields:lookupResponse.headers];
+        NSData *data = lookupResponse.rawResponseData;
+        id <LBDeserializer> deserializer = data.length ? [self.connectionProperties deserializerForContentType:lookupResponse.headers[@"Content-Type"] ?: ContentTypeJSON] : nil;
+        LBServerResponse *response = [LBServerResponse handleServerResponse:rawResponse request:serverRequest data:data deserializer:deserializer error:nil];
+        response.deduplicated = YES;
+        [self handleResponse:response];
+        [serverRequest cleanUp];
+    }];
+}
+
+- (void)asyncUploadImage:(UIImage *)image request:(LBServerRequest *)serverRequest fileName:(NSString *)fileName encoder:(LBImageEncoder *)encoder {
+    LBImageEncoder *imageEncoder = encoder ?: [LBImageEncoder encoder];
+    [imageEncoder encodeImage:image completion:^(NSData *data, NSError *error) {
+        if (!data) {
+            LBLogError(@"could not encode image for:%@ %@", serverRequest.path, error);
+            if (serverRequest.failResponseHandler) {
+                serverRequest.failResponseHandler(error);
+            }
+            else if (serverRequest.responseHandler) {
+                serverRequest.responseHandler([LBServerResponse handleServerResponse:nil request:serverRequest data:nil deserializer:nil error:error]);
+            }
+            [serverRequest cleanUp];
+            return;
+        }
+        LBLogDebug(@"encoded image upload of %@ bytes", @(data.length));
+        serverRequest.requestBodyData = data;
+        serverRequest.dataContentType = DataContentTypeImage;
+        [self asyncUploadRequestData:serverRequest fileName:fileName];
+    }];
+}
+
+- (LBSegmentedDownload *)segmentedDownloadForRequest:(LBServerRequest *)request toFile:(NSString *)filePath {
+    [self setupRequest:request];
+    return [[LBSegmentedDownload alloc] initWithRequest:request filePath:filePath client:self];
+}
+
+- (void)prefetchRequest:(LBServerRequest *)request {
+    [self setupRequest:request];
+    [self.prefetcher prefetchRequest:request];
+}
+
+- (void)cancelPrefetches {
+    [self.prefetcher cancelAll];
+}
+
+- (LBSegmentedDownload *)downloadRequest:(LBServerRequest *)request toFile:(NSString *)filePath {
+    LBLogInfo(@"downloading %@ to file:%@\n", request.path, filePath);
+    LBSegmentedDownload *download = [self segmentedDownloadForRequest:request toFile:filePath];
+    [download start];
+    return download;
+}
+
 - (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response {
     LBLogDebug(@"Response recieved from url:%@", [[[connection originalRequest] URL] description]);
     NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *) response;
     LBURLConnection *con = (LBURLConnection *) connection;
     [con setRawResponse:httpResponse];
-    con.data = [[NSMutableData alloc] initWithLength:0];
+    con.responseTime = CFAbsoluteTimeGetCurrent();
+    [self.tracer recordSpan:"firstByte" trace:con.request.traceID start:con.startTime end:con.responseTime detail:nil];
+    [self recycleDataForConnection:con];
+    //a redirect or a retried response digests from scratch
+    con.digest = [LBDigest digestWithAlgorithm:con.request.digestAlgorithm];
+    if ([self isStreamingConnection:con]) {
+        //a new response starts the stream over, records only pass through the framer
+        [con.request.recordFramer reset];
+        con.data = [[NSMutableData alloc] initWithLength:0];
+        return;
+    }
+    con.data = self.bufferPool ? [self.bufferPool bufferForExpectedLength:response.expectedContentLength] : [[NSMutableData alloc] initWithLength:0];
 }
 
 - (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
     LBURLConnection *con = (LBURLConnection *) connection;
+    [con.digest updateWithData:data];
+    if ([self isStreamingConnection:con]) {
+        NSError *error = nil;
+        BOOL framed = [con.request.recordFramer appendData:data error:&error];
+        [self deliverRecordsForConnection:con];
+        if (!framed) {
+            LBLogError(@"stream of %@ failed:%@", [[con originalRequest] URL], error);
+            [con cancel];
+            [self connection:con didFailWithError:error];
+        }
+        return;
+    }
     [[con data] appendData:data];
 }
 
+/**
+ * Only successful responses stream, error bodies are buffered for the fail handlers
+ */
+- (BOOL)isStreamingConnection:(LBURLConnection *)con {
+    NSInteger statusCode = con.rawResponse.statusCode;
+    return con.request.recordFramer && statusCode >= 200 && statusCode < 300;
+}
+
+- (void)deliverRecordsForConnection:(LBURLConnection *)con {
+    LBServerRequest *request = con.request;
+    NSString *recordContentType = request.recordFramer.recordContentType;
+    id <LBDeserializer> deserializer = recordContentType ? [self.connectionProperties deserializerForContentType:recordContentType] : nil;
+    id record;
+    while ((record = [request.recordFramer nextRecord])) {
+        if (deserializer && [record isKindOfClass:[NSData class]]) {
+            record = [deserializer deserialize:record toClass:request.responseClass];
+        }
+        if (record && request.recordHandler) {
+            con.deliveredRecords++;
+            request.recordHandler(record);
+        }
+    }
+}
+
 - (void)connectionDidFinishLoading:(NSURLConnection *)connection {
     LBURLConnection *con = (LBURLConnection *) connection;
+    CFAbsoluteTime finishStart = [self.tracer timestamp];
+    [self.tracer recordSpan:"download" trace:con.request.traceID start:con.responseTime end:finishStart detail:nil];
     NSData *data = [con data];
-    NSString *stringData = [data toString];
-    if (stringData.length > 1000) {
-        LBLogDebug(@"Data received:%@", @(stringData.length));
+    if (LBShowLog) {
+        if (data.length > 1000) {
+            LBLogDebug(@"Data received:%@", @(data.length));
+        }
+        else {
+            LBLogDebug(@"Data recieved:%@", [data toString]);
+        }
     }
-    else {
-        LBLogDebug(@"Data recieved:%@", stringData);
+    NSError *digestError = [self digestErrorForConnection:con];
+    if (digestError) {
+        LBLogError(@"%@ of %@", digestError.localizedDescription, [[con originalRequest] URL]);
+        //goes through the retry policy like any transfer failure
+        [self connection:con didFailWithError:digestError];
+        return;
     }
-    id <LBDeserializer> deserializer = [self.connectionProperties deserializerForContentType:[con responseContentType]];
+    BOOL streaming = [self isStreamingConnection:con];
+    if (!streaming && [self.requestJournal deferRequest:con.request response:con.rawResponse]) {
+        //the server did not take the write, the journal sends it again later
+        [self hideActivityIndicatorForConnection:con];
+        [self releaseConnection:con failed:YES];
+        [self recycleDataForConnection:con];
+        [con cancel];
+        return;
+    }
+    if (streaming) {
+        [con.request.recordFramer finish];
+        [self deliverRecordsForConnection:con];
+    }
+    BOOL deliver = [self revalidateCachedResponseForConnection:con];
+    id <LBDeserializer> deserializer = deliver && !streaming ? [self.connectionProperties deserializerForContentType:[con responseContentType]] : nil;
+    CFAbsoluteTime deserializeStart = [self.tracer timestamp];
     LBServerResponse *response = [LBServerResponse handleServerResponse:con.rawResponse request:con.request data:con.data deserializer:deserializer error:nil];
+    [self.tracer recordSpan:"deserialize" trace:con.request.traceID start:deserializeStart];
+    response.digest = [con.digest finalDigest];
+    response.duration = CFAbsoluteTimeGetCurrent() - con.startTime;
+    [self.metrics recordSuccessWithBytes:data.length duration:response.duration];
+    [self.requestJournal acknowledgeRequest:con.request];
+    [self releaseConnection:con failed:response.statusCode >= kHTTPStatusCodeInternalServerError || response.statusCode == kHTTPStatusCodeTooManyRequests];
 
 //    [[NSOperationQueue mainQueue] addOperationWithBlock:^{
-        [self handleResponse:response];
+        LBTraceID traceID = con.request.traceID;
+        CFAbsoluteTime handlersStart = [self.tracer timestamp];
+        if (deliver) {
+            [self handleResponse:response];
+        }
+        else {
+            LBLogDebug(@"content unchanged for:%@", [[con originalRequest] URL]);
+        }
+        [self.tracer recordSpan:"handlers" trace:traceID start:handlersStart];
+        [self.tracer recordSpan:"connectionDidFinishLoading" trace:traceID start:finishStart];
         [self cleanUp:con];
 //    }];
 }
 
+/**
+ * Only successful bodies are held to the expected digest, streamed records have
+ * already been delivered by the time a mismatch shows
+ */
+- (NSError *)digestErrorForConnection:(LBURLConnection *)con {
+    NSData *expectedDigest = con.request.expectedDigest;
+    NSInteger statusCode = con.rawResponse.statusCode;
+    if (!con.digest || !expectedDigest || statusCode < 200 || statusCode >= 300) {
+        return nil;
+    }
+    NSData *digest = [con.digest finalDigest];
+    if ([digest isEqualToData:expectedDigest]) {
+        return nil;
+    }
+    return [self digestMismatchErrorWithDigest:digest expectedDigest:expectedDigest];
+}
+
+- (NSError *)digestMismatchErrorWithDigest:(NSData *)digest expectedDigest:(NSData *)expectedDigest {
+    return [NSError errorWithDomain:LBNetworkErrorDomain
+                               code:LBNetworkErrorDigestMismatch
+                           userInfo:@{NSLocalizedDescriptionKey : @"Response digest mismatch",
+                                   @"expectedDigest" : [LBDigest hexStringWithData:expectedDigest],
+                                   @"digest" : [LBDigest hexStringWithData:digest]}];
+}
+
 - (NSURLRequest *)connection:(NSURLConnection *)connection willSendRequest:(NSURLRequest *)request redirectResponse:(NSHTTPURLResponse *)redirectResponse {
     LBURLConnection *con = (LBURLConnection *)connection;
     if (con.request.shouldAutoRedirect || !redirectResponse ) {
@@ -360,8 +841,21 @@ static id sharedClient;
 
     [con cancel];
     [con.request cleanUp];
-    [con.data setLength:0];
-    [[UIApplication sharedApplication] setNetworkActivityIndicatorVisible:NO];
+    [self recycleDataForConnection:con];
+    [self hideActivityIndicatorForConnection:con];
+}
+
+- (void)recycleDataForConnection:(LBURLConnection *)con {
+    if (!con.data) {
+        return;
+    }
+    if (self.bufferPool) {
+        [self.bufferPool recycleBuffer:con.data];
+        con.data = nil;
+    }
+    else {
+        [con.data setLength:0];
+    }
 }
 
 - (NSCachedURLResponse *)connection:(NSURLConnection *)connection willCacheResponse:(NSCachedURLResponse *)cachedResponse {
@@ -528,24 +1022,43 @@ static id sharedClient;
 
 - (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error {
 
-    [[UIApplication sharedApplication] setNetworkActivityIndicatorVisible:NO];
     __block LBURLConnection *con = (LBURLConnection *) connection;
+    [self hideActivityIndicatorForConnection:con];
     LBLogDebug(@"%@", [NSString stringWithFormat:@"Did recieve error: %@", [error description]]);
     LBLogDebug(@"%@", [NSString stringWithFormat:@"%@", [[error userInfo] description]]);
     LBLogDebug(@"response:%@", con.rawResponse);
     LBLogDebug(@"statusCode:%@", @(con.rawResponse.statusCode));
 
+    //a resent stream would hand the records it already delivered out again
+    BOOL resendable = con.deliveredRecords == 0;
+    if (resendable && [self failOverConnection:con error:error]) {
+        return;
+    }
+
+    if (resendable && [self.requestJournal deferRequest:con.request error:error]) {
+        //offline, the journal replays it once the network is back
+        [self releaseConnection:con failed:YES];
+        [con cancel];
+        return;
+    }
+
     BOOL shouldRetryRequest = NO;
-    if ([[self.connectionProperties errorHandler] respondsToSelector:@selector(shouldRetryRequest:forCurrentTry:)]) {
+    if (resendable && [[self.connectionProperties errorHandler] respondsToSelector:@selector(shouldRetryRequest:forCurrentTry:)]) {
         shouldRetryRequest = [[self.connectionProperties errorHandler] shouldRetryRequest:error forCurrentTry:con.retries];
     }
 
+    [self releaseConnection:con failed:YES];
+
     if (shouldRetryRequest) {
+        if (self.tracer) {
+            [self.tracer recordInstant:"retry" trace:con.request.traceID detail:error.localizedDescription];
+        }
         LBURLConnection *conrestart = [con copy];
         conrestart.retries = con.retries + 1;
-        [conrestart setDelegateQueue:self.connectionQueue];
-        [conrestart start];
+        [self.metrics recordRetry];
         [con cancel];
+        [self recycleDataForConnection:con];
+        [self scheduleConnection:conrestart];
     }
     else {
         LBServerResponse *response = [LBServerResponse handleServerResponse:con.rawResponse
@@ -554,8 +1067,18 @@ static id sharedClient;
                                                                deserializer:nil
                                                                       error:error];
         response.currentRequestTryCount = con.retries;
+        response.duration = CFAbsoluteTimeGetCurrent() - con.startTime;
         response.error = error;
-        if (con.request.failResponseHandler) {
+        response.digest = [con.digest finalDigest];
+        [self.metrics recordFailureWithDuration:response.duration];
+        [self.requestJournal acknowledgeRequest:con.request];
+        //with a stale response delivered a failed revalidation is not reported
+        BOOL deliver = con.request.cachedResponse == nil;
+        if (self.tracer) {
+            [self.tracer recordInstant:"failed" trace:con.request.traceID detail:error.localizedDescription];
+        }
+        CFAbsoluteTime handlersStart = [self.tracer timestamp];
+        if (deliver && con.request.failResponseHandler) {
             LBURLConnection *lburlConnection = con;
             LBServerRequest *request = lburlConnection.request;
             LBServerFailResponseHandler pFunction = request.failResponseHandler;
@@ -563,21 +1086,99 @@ static id sharedClient;
             NSError *error1 = serverResponse.error;
             pFunction(error1);
         }
-        else {
+        else if (deliver) {
             if (con.request.responseHandler) {
                 con.request.responseHandler(response);
             }
         }
+        [self.tracer recordSpan:"handlers" trace:con.request.traceID start:handlersStart];
         [con.request cleanUp];
-        [con.data setLength:0];
+        [self recycleDataForConnection:con];
         [con cancel];
         con = nil;
 
-        [self handleErrorIfNeeded:response];
+        if (deliver) {
+            [self handleErrorIfNeeded:response];
+        }
+    }
+}
+
+#pragma mark - channels
+
+- (LBChannel *)channelWithURL:(NSURL *)URL {
+    return [[LBChannel alloc] initWithURL:URL client:self];
+}
+
+#pragma mark - endpoint groups
+
+- (void)addEndpointGroup:(LBEndpointGroup *)group {
+    @synchronized (self.endpointGroups) {
+        self.endpointGroups[group.name] = group;
+    }
+}
+
+- (LBEndpointGroup *)endpointGroupNamed:(NSString *)name {
+    if (!name) {
+        return nil;
+    }
+    @synchronized (self.endpointGroups) {
+        return self.endpointGroups[name];
+    }
+}
+
+- (void)resolveEndpointForRequest:(LBServerRequest *)serverRequest {
+    //a resend is routed afresh, not pinned to the replica of the previous send
+    serverRequest.endpointBaseURL = nil;
+    serverRequest.triedBaseURLs = nil;
+    if (serverRequest.baseURL || !serverRequest.endpointGroup) {
+        return;
+    }
+    LBEndpointGroup *group = [self endpointGroupNamed:serverRequest.endpointGroup];
+    serverRequest.endpointBaseURL = [group baseURLExcluding:nil];
+    LBLogDebug(@"routing %@ to %@", serverRequest.path, serverRequest.endpointBaseURL);
+}
+
+/**
+ * Resends the request to the best replica not tried yet, without consuming a retry
+ */
+- (BOOL)failOverConnection:(LBURLConnection *)con error:(NSError *)error {
+    LBServerRequest *request = con.request;
+    if (!request.endpointBaseURL || ![LBEndpointGroup isFailoverError:error method:request.method]) {
+        return NO;
+    }
+    NSArray *tried = [(request.triedBaseURLs ?: @[]) arrayByAddingObject:request.endpointBaseURL];
+    NSURL *baseURL = [[self endpointGroupNamed:request.endpointGroup] baseURLExcluding:tried];
+    //the URL may carry a query built after the base, only the base is swapped
+    NSString *previousPrefix = [request requestURLString];
+    NSString *URLString = request.httpRequest.URL.absoluteString;
+    if (!baseURL || ![URLString hasPrefix:previousPrefix]) {
+        return NO;
+    }
+    [self releaseConnection:con failed:YES];
+    [con cancel];
+    [self recycleDataForConnection:con];
+
+    LBServerRequest *failover = [request copy];
+    failover.endpointBaseURL = baseURL;
+    failover.triedBaseURLs = tried;
+    NSMutableURLRequest *httpRequest = [request.httpRequest mutableCopy];
+    httpRequest.URL = [NSURL URLWithString:[[failover requestURLString] stringByAppendingString:[URLString substringFromIndex:previousPrefix.length]]];
+    failover.httpRequest = httpRequest;
+    LBLogInfo(@"failing over from %@ to %@ after:%@", request.endpointBaseURL, baseURL, error.localizedDescription);
+    if (self.tracer) {
+        [self.tracer recordInstant:"failover" trace:request.traceID detail:baseURL.absoluteString];
     }
+
+    LBURLConnection *conrestart = [[LBURLConnection alloc] initWithRequest:failover delegate:self];
+    conrestart.retries = con.retries;
+    [self scheduleConnection:conrestart];
+    return YES;
 }
 
 - (void)handleErrorIfNeeded:(LBServerResponse *)response {
+    if (response.request.silent) {
+        return;
+    }
     BOOL shouldDisplayErrorForResponse = NO;
     if ([[self.connectionProperties errorHandler] respondsToSelector:@selector(shouldDisplayErrorForResponse:)]) {
         shouldDisplayErrorForResponse = [[self.connectionProperties errorHandler] shouldDisplayErrorForResponse:response];
@@ -614,7 +1215,24 @@ static id sharedClient;
     LBLogInfo(@"sending %@ request to path:%@\n", request.method, request.path);
     LBLogDebug(@"params:%@\n, body:%@\n, headers:%@\n,handingResponse:%d", request.params, request.requestBodyString, request.headers, (request.successResponseHandler != nil));
 
+    CFAbsoluteTime sendStart = [self.tracer timestamp];
+    if (self.tracer && !request.traceID) {
+        request.traceID = [self.tracer newTraceID];
+    }
+
+    if ([self.requestJournal shouldJournalRequest:request]) {
+        [self.requestJournal appendRequest:request];
+    }
+
     [self asyncRequestDataForServerRequest:request];
+    [self.tracer recordSpan:"sendRequest" trace:request.traceID start:sendStart end:[self.tracer timestamp] detail:request.path];
+}
+
+- (void)setRequestJournal:(LBRequestJournal *)requestJournal {
+    _requestJournal = requestJournal;
+    requestJournal.client = self;
+    //entries left over from a previous launch
+    [requestJournal replay];
 }
 
 - (BOOL)addWithRootCA:(NSString *)caDerFilePath strictHostNameCheck:(BOOL)check {
@@ -629,24 +1247,62 @@ static id sharedClient;
         return NO;
     }
     NSArray *chain = [NSArray arrayWithObject:(__bridge id) (caRef)];
+    CFRelease(caRef);
 
     return [self initWithRootCAs:chain strictHostNameCheck:check];
 }
 
 - (BOOL)initWithRootCAs:(NSArray *)anArrayOfSecCertificateRef strictHostNameCheck:(BOOL)check {
 
+    if (caChainArrayRef)
+        CFRelease(caChainArrayRef);
     caChainArrayRef = CFBridgingRetain(anArrayOfSecCertificateRef);
 
     return YES;
 }
 
+- (BOOL)hasCustomRootCAs {
+    return !self.certificateFromAuthority && caChainArrayRef != NULL;
+}
+
+- (BOOL)shouldTrustServerTrust:(SecTrustRef)serverTrust forHost:(NSString *)host {
+    //the hostname may only be waived for the roots given to addWithRootCA:strictHostNameCheck:,
+    //anything else is held to the system roots and the host it was asked for
+    BOOL customRoots = [self hasCustomRootCAs];
+    SecPolicyRef policy = !customRoots || checkHostname ? SecPolicyCreateSSL(true, (__bridge CFStringRef) host) : SecPolicyCreateBasicX509();
+    OSStatus err = SecTrustSetPolicies(serverTrust, policy);
+    CFRelease(policy);
+    if (err == errSecSuccess && customRoots) {
+        err = SecTrustSetAnchorCertificates(serverTrust, caChainArrayRef);
+        if (err == errSecSuccess)
+            err = SecTrustSetAnchorCertificatesOnly(serverTrust, YES);
+    }
+    SecTrustResultType result = kSecTrustResultInvalid;
+    if (err == errSecSuccess)
+        err = SecTrustEvaluate(serverTrust, &result);
+    if (err != errSecSuccess) {
+        LBLogDebug(@"FAIL. trust evaluation for %@ failed with %d", host, (int) err);
+        return NO;
+    }
+    BOOL trusted = result == kSecTrustResultProceed || result == kSecTrustResultUnspecified;
+    if (!trusted) {
+        LBLogDebug(@"FAIL. %@ is not trusted, result %d", host, (int) result);
+    }
+    return trusted;
+}
+
 - (void)dealloc {
     if (caChainArrayRef)
         CFRelease(caChainArrayRef);
 }
 
 + (BOOL)shouldLog {
-    return [[[LBHTTPSClient sharedClient] connectionProperties] logLevel] == LogLevelDebug;
+    //do not spin up the shared client just to answer this, its default level is debug
+    return sharedClient ? [sharedClient shouldLog] : YES;
+}
+
+- (BOOL)shouldLog {
+    return self.connectionProperties.logLevel == LogLevelDebug;
 }
 
 - (void)responseType:(id)sender {
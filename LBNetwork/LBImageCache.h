@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBImageCache.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+/**
+ * Least recently used cache of decoded images, keyed by URL and the pixel size they
+ * were decoded at. The cost of an image is its bitmap size; once totalCost passes
+ * totalCostLimit the least recently used images are evicted. Memory warnings empty
+ * the cache.
+ *
+ * Only requests without credentials and responses the server allows to be stored
+ * are cached, see isCacheableRequest: and isCacheableResponse:.
+ */
+@interface LBImageCache : NSObject
+
+@property (nonatomic,assign)NSUInteger totalCostLimit;
+@property (nonatomic,assign,readonly)NSUInteger totalCost;
+@property (nonatomic,assign,readonly)NSUInteger count;
+
++(NSString *)keyForURL:(NSURL *)URL pixelSize:(NSUInteger)pixelSize;
++(NSUInteger)costForImage:(UIImage *)image;
+/**
+ * GETs without an Authorization header or a no-cache/no-store Cache-Control
+ */
++(BOOL)isCacheableRequest:(NSURLRequest *)request;
+/**
+ * 2xx responses without a no-store/private Cache-Control
+ */
++(BOOL)isCacheableResponse:(NSHTTPURLResponse *)response;
+
+-(UIImage *)imageForURL:(NSURL *)URL pixelSize:(NSUInteger)pixelSize;
+-(void)setImage:(UIImage *)image forURL:(NSURL *)URL pixelSize:(NSUInteger)pixelSize;
+-(UIImage *)imageForKey:(NSString *)key;
+-(void)setImage:(UIImage *)image forKey:(NSString *)key;
+-(void)removeImageForKey:(NSString *)key;
+-(void)removeAllImages;
+@end
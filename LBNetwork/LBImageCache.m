@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBImageCache.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#define kDefaultImageCacheCostLimit (32 * 1024 * 1024)
+
+@interface LBImageCacheNode : NSObject
+@property (nonatomic,copy)NSString *key;
+@property (nonatomic,strong)UIImage *image;
+@property (nonatomic,assign)NSUInteger cost;
+@property (nonatomic,weak)LBImageCacheNode *previous;
+@property (nonatomic,strong)LBImageCacheNode *next;
+@end
+
+@implementation LBImageCacheNode
+@end
+
+@interface LBImageCache ()
+@property (nonatomic,strong)NSMutableDictionary *nodes;
+@property (nonatomic,strong)LBImageCacheNode *head;
+@property (nonatomic,weak)LBImageCacheNode *tail;
+@property (nonatomic,assign,readwrite)NSUInteger totalCost;
+@end
+
+@implementation LBImageCache
+
+-(instancetype)init{
+    self = [super init];
+    if (self) {
+        self.nodes = [NSMutableDictionary dictionary];
+        _totalCostLimit = kDefaultImageCacheCostLimit;
+        [[NSNotificationCenter defaultCenter]addObserver:self
+                                                selector:@selector(removeAllImages)
+                                                    name:UIApplicationDidReceiveMemoryWarningNotification
+                                                  object:nil];
+    }
+    return self;
+}
+
+-(void)dealloc{
+    [[NSNotificationCenter defaultCenter]removeObserver:self];
+}
+
++(BOOL)isCacheableRequest:(NSURLRequest *)request{
+    //the URL alone does not tell whose image it is
+    if(![request.HTTPMethod.uppercaseString isEqualToString:@"GET"] || [request valueForHTTPHeaderField:@"Authorization"]){
+        return NO;
+    }
+    return ![LBResponseCache cacheControl:[request valueForHTTPHeaderField:@"Cache-Control"] containsDirectives:@[@"no-cache", @"no-store"]];
+}
+
++(BOOL)isCacheableResponse:(NSHTTPURLResponse *)response{
+    if(response.statusCode < 200 || response.statusCode >= 300){
+        return NO;
+    }
+    NSString *cacheControl = nil;
+    for(NSString *field in response.allHeaderFields){
+        if([field caseInsensitiveCompare:@"Cache-Control"] == NSOrderedSame){
+            cacheControl = response.allHeaderFields[field];
+        }
+    }
+    return ![LBResponseCache cacheControl:cacheControl containsDirectives:@[@"no-store", @"private"]];
+}
+
++(NSString *)keyForURL:(NSURL *)URL pixelSize:(NSUInteger)pixelSize{
+    return [NSString stringWithFormat:@"%lu|%@", (unsigned long) pixelSize, URL.absoluteString];
+}
+
++(NSUInteger)costForImage:(UIImage *)image{
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef) {
+        return 1;
+    }
+    return MAX((NSUInteger) 1, CGImageGetBytesPerRow(imageRef) * CGImageGetHeight(imageRef));
+}
+
+-(NSUInteger)count{
+    @synchronized (self) {
+        return self.nodes.count;
+    }
+}
+
+-(void)setTotalCostLimit:(NSUInteger)totalCostLimit{
+    @synchronized (self) {
+        _totalCostLimit = totalCostLimit;
+        [self evictToCost:totalCostLimit];
+    }
+}
+
+#pragma mark - list, callers hold the lock
+
+-(void)unlinkNode:(LBImageCacheNode *)node{
+    LBImageCacheNode *previous = node.previous;
+    LBImageCacheNode *next = node.next;
+    if (previous) {
+        previous.next = next;
+    }
+    else {
+        self.head = next;
+    }
+    if (next) {
+        next.previous = previous;
+    }
+    else {
+        self.tail = previous;
+    }
+    node.previous = nil;
+    node.next = nil;
+}
+
+-(void)pushNode:(LBImageCacheNode *)node{
+    node.next = self.head;
+    self.head.previous = node;
+    self.head = node;
+    if (!self.tail) {
+        self.tail = node;
+    }
+}
+
+-(void)evictToCost:(NSUInteger)cost{
+    while (self.totalCost > cost && self.tail) {
+        LBImageCacheNode *node = self.tail;
+        [self unlinkNode:node];
+        [self.nodes removeObjectForKey:node.key];
+        self.totalCost -= node.cost;
+    }
+}
+
+#pragma mark - access
+
+-(UIImage *)imageForKey:(NSString *)key{
+    if (!key) {
+        return nil;
+    }
+    @synchronized (self) {
+        LBImageCacheNode *node = self.nodes[key];
+        if (!node) {
+            return nil;
+        }
+        if (node != self.head) {
+            [self unlinkNode:node];
+            [self pushNode:node];
+        }
+        return node.image;
+    }
+}
+
+-(void)setImage:(UIImage *)image forKey:(NSString *)key{
+    if (!key) {
+        return;
+    }
+    if (!image) {
+        [self removeImageForKey:key];
+        return;
+    }
+    NSUInteger cost = [LBImageCache costForImage:image];
+    @synchronized (self) {
+        LBImageCacheNode *node = self.nodes[key];
+        if (node) {
+            [self unlinkNode:node];
+            self.totalCost -= node.cost;
+        }
+        else {
+            node = [[LBImageCacheNode alloc]init];
+            node.key = key;
+            self.nodes[key] = node;
+        }
+        node.image = image;
+        node.cost = cost;
+        [self pushNode:node];
+        self.totalCost += cost;
+        [self evictToCost:self.totalCostLimit];
+    }
+}
+
+-(void)removeImageForKey:(NSString *)key{
+    if (!key) {
+        return;
+    }
+    @synchronized (self) {
+        LBImageCacheNode *node = self.nodes[key];
+        if (node) {
+            [self unlinkNode:node];
+            [self.nodes removeObjectForKey:key];
+            self.totalCost -= node.cost;
+        }
+    }
+}
+
+-(void)removeAllImages{
+    @synchronized (self) {
+        //unlink one by one, a long strong next chain would be released recursively
+        [self evictToCost:0];
+        [self.nodes removeAllObjects];
+        self.head = nil;
+        self.totalCost = 0;
+    }
+}
+
+-(UIImage *)imageForURL:(NSURL *)URL pixelSize:(NSUInteger)pixelSize{
+    return [self imageForKey:[LBImageCache keyForURL:URL pixelSize:pixelSize]];
+}
+
+-(void)setImage:(UIImage *)image forURL:(NSURL *)URL pixelSize:(NSUInteger)pixelSize{
+    [self setImage:image forKey:[LBImageCache keyForURL:URL pixelSize:pixelSize]];
+}
+@end
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBImageDeserializer.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+#import "LBDeserializer.h"
+@class LBImageCache;
+
+/**
+ * Decodes image responses into UIImages, register it for "image/*".
+ *
+ * Decoding happens on the client's delegate queue: the image is downsampled by ImageIO
+ * to the request's imageMaxPixelSize, or maxPixelSize when the request sets none, and
+ * drawn into a bitmap of its own, so it is fully decoded before it reaches the main
+ * thread and does not reference the pooled response buffer. Decoded images are put in
+ * cache, where a later GET of the same URL and imageMaxPixelSize is answered from
+ * without going to the network, unless the request sets ignoresImageCache or LBImageCache
+ * rules the request or response out.
+ */
+@interface LBImageDeserializer : NSObject <LBDeserializer>
+
+@property (nonatomic,strong)LBImageCache *cache;
+@property (nonatomic,assign)NSUInteger maxPixelSize;
+
++(instancetype)deserializerWithCache:(LBImageCache *)cache;
++(UIImage *)decodeImageData:(NSData *)data maxPixelSize:(NSUInteger)maxPixelSize;
+@end
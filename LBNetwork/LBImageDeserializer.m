@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBImageDeserializer.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import <ImageIO/ImageIO.h>
+
+@implementation LBImageDeserializer
+
++(instancetype)deserializerWithCache:(LBImageCache *)cache{
+    LBImageDeserializer *deserializer = [[self alloc]init];
+    deserializer.cache = cache;
+    return deserializer;
+}
+
++(UIImage *)decodeImageData:(NSData *)data maxPixelSize:(NSUInteger)maxPixelSize{
+    if (!data.length) {
+        return nil;
+    }
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef) data, NULL);
+    if (!source) {
+        return nil;
+    }
+    NSDictionary *properties = CFBridgingRelease(CGImageSourceCopyPropertiesAtIndex(source, 0, NULL));
+    NSUInteger width = [properties[(__bridge NSString *) kCGImagePropertyPixelWidth] unsignedIntegerValue];
+    NSUInteger height = [properties[(__bridge NSString *) kCGImagePropertyPixelHeight] unsignedIntegerValue];
+    NSUInteger longestSide = MAX(width, height);
+    NSUInteger pixelSize = maxPixelSize > 0 && longestSide > 0 ? MIN(maxPixelSize, longestSide) : longestSide;
+
+    //the thumbnail path downsamples while decoding and applies the EXIF orientation
+    NSDictionary *options = @{(__bridge id) kCGImageSourceCreateThumbnailFromImageAlways : @YES,
+                              (__bridge id) kCGImageSourceCreateThumbnailWithTransform : @YES,
+                              (__bridge id) kCGImageSourceThumbnailMaxPixelSize : @(pixelSize)};
+    CGImageRef decoded = pixelSize > 0 ? CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef) options)
+                                       : CGImageSourceCreateImageAtIndex(source, 0, NULL);
+    CFRelease(source);
+    if (!decoded) {
+        return nil;
+    }
+
+    //draw into a bitmap of our own, the image must not decode lazily on the main thread
+    //nor keep the response buffer alive
+    size_t bitmapWidth = CGImageGetWidth(decoded);
+    size_t bitmapHeight = CGImageGetHeight(decoded);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, bitmapWidth, bitmapHeight, 8, 0, colorSpace,
+                                                 kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        CGImageRelease(decoded);
+        return nil;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, bitmapWidth, bitmapHeight), decoded);
+    CGImageRelease(decoded);
+    CGImageRef bitmap = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    if (!bitmap) {
+        return nil;
+    }
+    UIImage *image = [UIImage imageWithCGImage:bitmap];
+    CGImageRelease(bitmap);
+    return image;
+}
+
+-(id)deserialize:(NSData *)data toClass:(Class)clz{
+    return [LBImageDeserializer decodeImageData:data maxPixelSize:self.maxPixelSize];
+}
+
+-(id)deserialize:(NSData *)data forRequest:(LBServerRequest *)request response:(NSHTTPURLResponse *)response{
+    NSUInteger maxPixelSize = request.imageMaxPixelSize ?: self.maxPixelSize;
+    UIImage *image = [LBImageDeserializer decodeImageData:data maxPixelSize:maxPixelSize];
+    NSURL *URL = request.httpRequest.URL ?: response.URL;
+    if (image && URL && !request.ignoresImageCache && [LBImageCache isCacheableRequest:request.httpRequest] && [LBImageCache isCacheableResponse:response]) {
+        [self.cache setImage:image forURL:URL pixelSize:request.imageMaxPixelSize];
+    }
+    return image;
+}
+@end
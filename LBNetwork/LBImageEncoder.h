@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBImageEncoder.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+typedef void (^LBImageEncoderCompletion)(NSData *data, NSError *error);
+
+/**
+ * Downsamples and JPEG encodes images for upload.
+ *
+ * The image is first scaled so its longest side is at most maxPixelSize. With a
+ * targetByteCount the quality is then binary searched between minQuality and
+ * maxQuality for the best encoding within the budget, and when even minQuality does
+ * not fit the image is scaled down further. Without a budget it is encoded once at
+ * maxQuality. Images on disk are downsampled by ImageIO without decoding them at full
+ * size first.
+ *
+ * An image that is still over targetByteCount after that is returned anyway by the
+ * plain variants, the error and completion variants fail it with
+ * LBNetworkErrorImageOverBudget instead. A targetByteCount of 0 accepts any size.
+ *
+ * The completion variants encode on a shared serial utility queue, so large encodes
+ * never overlap, and call completion there; data is nil and error set if the image
+ * could not be encoded within the budget.
+ */
+@interface LBImageEncoder : NSObject
+
+@property (nonatomic,assign)CGFloat maxPixelSize;
+@property (nonatomic,assign)NSUInteger targetByteCount;
+@property (nonatomic,assign)CGFloat minQuality;
+@property (nonatomic,assign)CGFloat maxQuality;
+@property (nonatomic,assign)NSUInteger maxIterations;
+
++(instancetype)encoder;
+
+-(NSData *)encodeImage:(UIImage *)image;
+-(NSData *)encodeImageAtURL:(NSURL *)URL;
+-(NSData *)encodeImage:(UIImage *)image error:(NSError **)error;
+-(NSData *)encodeImageAtURL:(NSURL *)URL error:(NSError **)error;
+-(void)encodeImage:(UIImage *)image completion:(LBImageEncoderCompletion)completion;
+-(void)encodeImageAtURL:(NSURL *)URL completion:(LBImageEncoderCompletion)completion;
+@end
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBImageEncoder.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import <ImageIO/ImageIO.h>
+#define kDefaultMaxPixelSize 2048
+#define kDefaultTargetByteCount (1024 * 1024)
+#define kDefaultMinQuality 0.3
+#define kDefaultMaxQuality 0.85
+#define kDefaultMaxIterations 6
+#define kMaxDownscalePasses 3
+#define kQualityResolution 0.02
+
+@implementation LBImageEncoder
+
++(instancetype)encoder{
+    return [[self alloc]init];
+}
+
+-(instancetype)init{
+    self = [super init];
+    if (self) {
+        self.maxPixelSize = kDefaultMaxPixelSize;
+        self.targetByteCount = kDefaultTargetByteCount;
+        self.minQuality = kDefaultMinQuality;
+        self.maxQuality = kDefaultMaxQuality;
+        self.maxIterations = kDefaultMaxIterations;
+    }
+    return self;
+}
+
++(dispatch_queue_t)encodingQueue{
+    static dispatch_queue_t queue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        queue = dispatch_queue_create("LBImageEncoder", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(queue, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    });
+    return queue;
+}
+
+#pragma mark - encoding
+
+-(NSData *)encodeImage:(UIImage *)image{
+    return [self encodeImage:image error:NULL];
+}
+
+-(NSData *)encodeImageAtURL:(NSURL *)URL{
+    return [self encodeImageAtURL:URL error:NULL];
+}
+
+-(NSData *)encodeImage:(UIImage *)image error:(NSError **)error{
+    if (!image) {
+        [self setEncodingError:error];
+        return nil;
+    }
+    @autoreleasepool {
+        CGSize pixelSize = CGSizeMake(image.size.width * image.scale, image.size.height * image.scale);
+        CGFloat longestSide = MAX(pixelSize.width, pixelSize.height);
+        if (self.maxPixelSize > 0 && longestSide > self.maxPixelSize) {
+            image = [self image:image scaledBy:self.maxPixelSize / longestSide];
+        }
+        return [self encodeImageWithinBudget:image error:error];
+    }
+}
+
+-(NSData *)encodeImageAtURL:(NSURL *)URL error:(NSError **)error{
+    if (self.maxPixelSize <= 0) {
+        return [self encodeImage:[UIImage imageWithContentsOfFile:URL.path] error:error];
+    }
+    CGImageSourceRef source = CGImageSourceCreateWithURL((__bridge CFURLRef) URL, NULL);
+    if (!source) {
+        [self setEncodingError:error];
+        return nil;
+    }
+    //decodes straight to the target size and applies the EXIF orientation
+    NSDictionary *options = @{(__bridge id) kCGImageSourceCreateThumbnailFromImageAlways : @YES,
+                              (__bridge id) kCGImageSourceCreateThumbnailWithTransform : @YES,
+                              (__bridge id) kCGImageSourceShouldCacheImmediately : @YES,
+                              (__bridge id) kCGImageSourceThumbnailMaxPixelSize : @(self.maxPixelSize)};
+    CGImageRef imageRef = CGImageSourceCreateThumbnailAtIndex(source, 0, (__bridge CFDictionaryRef) options);
+    CFRelease(source);
+    if (!imageRef) {
+        [self setEncodingError:error];
+        return nil;
+    }
+    UIImage *image = [UIImage imageWithCGImage:imageRef];
+    CGImageRelease(imageRef);
+    @autoreleasepool {
+        return [self encodeImageWithinBudget:image error:error];
+    }
+}
+
+-(void)encodeImage:(UIImage *)image completion:(LBImageEncoderCompletion)completion{
+    dispatch_async([LBImageEncoder encodingQueue], ^{
+        NSError *error = nil;
+        NSData *data = [self encodeImage:image error:&error];
+        if (completion) {
+            completion(data, error);
+        }
+    });
+}
+
+-(void)encodeImageAtURL:(NSURL *)URL completion:(LBImageEncoderCompletion)completion{
+    dispatch_async([LBImageEncoder encodingQueue], ^{
+        NSError *error = nil;
+        NSData *data = [self encodeImageAtURL:URL error:&error];
+        if (completion) {
+            completion(data, error);
+        }
+    });
+}
+
+-(void)setEncodingError:(NSError **)error{
+    if (error) {
+        *error = [NSError errorWithDomain:LBNetworkErrorDomain
+                                     code:LBNetworkErrorImageEncodingFailed
+                                 userInfo:@{NSLocalizedDescriptionKey : @"The image could not be encoded"}];
+    }
+}
+
+/**
+ * UIGraphics contexts are safe off the main thread, drawing also bakes in the orientation
+ */
+-(UIImage *)image:(UIImage *)image scaledBy:(CGFloat)ratio{
+    CGSize size = CGSizeMake(MAX(1, floor(image.size.width * image.scale * ratio)),
+                             MAX(1, floor(image.size.height * image.scale * ratio)));
+    UIGraphicsBeginImageContextWithOptions(size, YES, 1.0);
+    [image drawInRect:CGRectMake(0, 0, size.width, size.height)];
+    UIImage *scaledImage = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    return scaledImage;
+}
+
+/**
+ * With error, an encoding that cannot be brought within the budget is reported as
+ * LBNetworkErrorImageOverBudget instead of being returned
+ */
+-(NSData *)encodeImageWithinBudget:(UIImage *)image error:(NSError **)error{
+    NSData *data = UIImageJPEGRepresentation(image, self.maxQuality);
+    if (!data) {
+        [self setEncodingError:error];
+        return nil;
+    }
+    NSUInteger budget = self.targetByteCount;
+    if (!budget || data.length <= budget) {
+        return data;
+    }
+
+    NSData *lowest = UIImageJPEGRepresentation(image, self.minQuality);
+    for (NSUInteger pass = 0; lowest.length > budget && pass < kMaxDownscalePasses; pass++) {
+        //bytes grow roughly with the pixel count, aim a little under the budget
+        CGFloat ratio = sqrt((double) budget / lowest.length) * 0.9;
+        image = [self image:image scaledBy:ratio];
+        lowest = UIImageJPEGRepresentation(image, self.minQuality);
+    }
+    if (lowest.length > budget) {
+        if (!error) {
+            return lowest;
+        }
+        NSString *description = [NSString stringWithFormat:@"The image needs %lu bytes, over the budget of %lu", (unsigned long) lowest.length, (unsigned long) budget];
+        *error = [NSError errorWithDomain:LBNetworkErrorDomain
+                                     code:LBNetworkErrorImageOverBudget
+                                 userInfo:@{NSLocalizedDescriptionKey : description}];
+        return nil;
+    }
+
+    NSData *best = lowest;
+    CGFloat low = self.minQuality;
+    CGFloat high = self.maxQuality;
+    for (NSUInteger i = 0; i < self.maxIterations && high - low > kQualityResolution; i++) {
+        @autoreleasepool {
+            CGFloat quality = (low + high) / 2;
+            NSData *candidate = UIImageJPEGRepresentation(image, quality);
+            if (candidate.length <= budget) {
+                best = candidate;
+                low = quality;
+            }
+            else {
+                high = quality;
+            }
+        }
+    }
+    return best;
+}
+@end
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBLoopbackTransport.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import "LBTransport.h"
+
+typedef LBTransportRecord *(^LBLoopbackResponder)(NSURLRequest *request);
+
+/**
+ * In-memory transport, nothing touches a socket.
+ *
+ * Requests are answered from the records set per URL, then from the responder, and
+ * with an empty 404 otherwise. Records without delays are delivered in a single
+ * operation on the client's queue, which makes this the transport for measuring the
+ * client pipeline itself: request setup, scheduling, buffering, deserializing and
+ * handler dispatch. A 3xx record with a Location header is followed through the
+ * delegate's connection:willSendRequest:redirectResponse:, and delivered as is when
+ * the delegate declines. Authentication challenges are not simulated.
+ */
+@interface LBLoopbackTransport : NSObject <LBTransport>
+
+@property (nonatomic,copy)LBLoopbackResponder responder;
+/**
+ * Multiplies the delays of the records, 0 ignores them
+ */
+@property (nonatomic,assign)double timeScale;
+@property (nonatomic,assign,readonly)NSUInteger requestCount;
+
++(instancetype)transportWithResponder:(LBLoopbackResponder)responder;
+-(void)setRecord:(LBTransportRecord *)record forURL:(NSURL *)URL;
+-(LBTransportRecord *)recordForRequest:(NSURLRequest *)request;
+@end
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBLoopbackTransport.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import <stdatomic.h>
+
+#define kMaxRedirects 16
+
+@interface LBLoopbackTransport ()
+@property (nonatomic,strong)NSMutableDictionary *records;
+@end
+
+@implementation LBLoopbackTransport {
+    atomic_ulong requests;
+}
+
++(instancetype)transportWithResponder:(LBLoopbackResponder)responder{
+    LBLoopbackTransport *transport = [[self alloc]init];
+    transport.responder = responder;
+    return transport;
+}
+
+-(instancetype)init{
+    self = [super init];
+    if (self) {
+        self.records = [NSMutableDictionary dictionary];
+        self.timeScale = 1.0;
+        atomic_init(&requests, 0);
+    }
+    return self;
+}
+
+-(NSUInteger)requestCount{
+    return (NSUInteger) atomic_load_explicit(&requests, memory_order_relaxed);
+}
+
+-(void)setRecord:(LBTransportRecord *)record forURL:(NSURL *)URL{
+    @synchronized (self) {
+        if (record) {
+            self.records[URL.absoluteString] = record;
+        }
+        else {
+            [self.records removeObjectForKey:URL.absoluteString];
+        }
+    }
+}
+
+-(LBTransportRecord *)recordForRequest:(NSURLRequest *)request{
+    atomic_fetch_add_explicit(&requests, 1, memory_order_relaxed);
+    LBTransportRecord *record;
+    @synchronized (self) {
+        record = self.records[request.URL.absoluteString];
+    }
+    if (!record && self.responder) {
+        record = self.responder(request);
+    }
+    return record ?: [LBTransportRecord recordWithStatusCode:404 headers:nil body:nil];
+}
+
+-(void)startConnection:(LBURLConnection *)connection delegateQueue:(NSOperationQueue *)queue{
+    NSURLRequest *request = [connection originalRequest];
+    LBTransportRecord *record = [self recordForRequest:request];
+    if ([self redirectURLForRecord:record request:request]) {
+        [queue addOperationWithBlock:^{
+            [self followRedirect:record request:request connection:connection queue:queue hops:1];
+        }];
+        return;
+    }
+    [record deliverToConnection:connection queue:queue timeScale:self.timeScale];
+}
+
+-(NSURL *)redirectURLForRecord:(LBTransportRecord *)record request:(NSURLRequest *)request{
+    if (record.error || record.statusCode < 300 || record.statusCode >= 400) {
+        return nil;
+    }
+    NSString *location = nil;
+    for (NSString *field in record.headers) {
+        if ([field caseInsensitiveCompare:@"Location"] == NSOrderedSame) {
+            location = record.headers[field];
+            break;
+        }
+    }
+    return location ? [[NSURL URLWithString:location relativeToURL:request.URL] absoluteURL] : nil;
+}
+
+/**
+ * Runs on the delegate queue, like NSURLConnection asks its delegate
+ */
+-(void)followRedirect:(LBTransportRecord *)record request:(NSURLRequest *)request connection:(LBURLConnection *)connection queue:(NSOperationQueue *)queue hops:(NSUInteger)hops{
+    if (connection.isCancelled) {
+        return;
+    }
+    id delegate = connection.connectionDelegate;
+    NSMutableURLRequest *redirectRequest = [request mutableCopy];
+    redirectRequest.URL = [self redirectURLForRecord:record request:request];
+    NSURLRequest *nextRequest = redirectRequest;
+    if ([delegate respondsToSelector:@selector(connection:willSendRequest:redirectResponse:)]) {
+        nextRequest = [delegate connection:connection willSendRequest:redirectRequest redirectResponse:[record responseForURL:request.URL]];
+    }
+    if (!nextRequest || hops >= kMaxRedirects) {
+        [record deliverToConnection:connection queue:queue timeScale:self.timeScale];
+        return;
+    }
+    LBTransportRecord *nextRecord = [self recordForRequest:nextRequest];
+    if ([self redirectURLForRecord:nextRecord request:nextRequest]) {
+        [self followRedirect:nextRecord request:nextRequest connection:connection queue:queue hops:hops + 1];
+        return;
+    }
+    [nextRecord deliverToConnection:connection queue:queue timeScale:self.timeScale];
+}
+
+-(NSData *)sendSynchronousRequest:(NSURLRequest *)request returningResponse:(NSHTTPURLResponse **)response error:(NSError **)error{
+    LBTransportRecord *record = [self recordForRequest:request];
+    if (record.duration > 0 && self.timeScale > 0) {
+        [NSThread sleepForTimeInterval:record.duration * self.timeScale];
+    }
+    if (record.error) {
+        if (error) {
+            *error = record.error;
+        }
+        return nil;
+    }
+    if (response) {
+        *response = [record responseForURL:request.URL];
+    }
+    return record.body ?: [NSData data];
+}
+@end
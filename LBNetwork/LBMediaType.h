@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBMediaType.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Parsed Content-Type value, e.g. "application/vnd.api+json; charset=utf-8".
+ *
+ * type, subtype and parameter names are lowercased, quoted parameter values unquoted,
+ * and suffix holds the structured syntax suffix ("json" above) if there is one.
+ * essence ("type/subtype") is interned, so equal essences are the same instance, for
+ * the first 256 distinct essences seen; later ones are equal but not shared.
+ * Parsed values are cached by their raw string.
+ */
+@interface LBMediaType : NSObject
+
+@property (nonatomic,copy,readonly)NSString *type;
+@property (nonatomic,copy,readonly)NSString *subtype;
+@property (nonatomic,copy,readonly)NSString *suffix;
+@property (nonatomic,copy,readonly)NSString *essence;
+@property (nonatomic,copy,readonly)NSDictionary *parameters;
+
++(instancetype)mediaTypeWithString:(NSString *)string;
++(NSString *)internedString:(NSString *)string;
+
+-(BOOL)isWildcard;
+@end
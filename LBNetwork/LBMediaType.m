@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBMediaType.m
+//  LBNetwork
+//
+
+#import "LBMediaType.h"
+
+#define kParsedCacheLimit 64
+#define kInternedLimit 256
+
+@implementation LBMediaType
+
++(NSCache *)parsedCache{
+    static NSCache *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[NSCache alloc]init];
+        cache.countLimit = kParsedCacheLimit;
+    });
+    return cache;
+}
+
++(NSString *)internedString:(NSString *)string{
+    static NSMutableDictionary *interned;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        interned = [[NSMutableDictionary alloc]init];
+    });
+    if(!string){
+        return nil;
+    }
+    @synchronized(interned){
+        NSString *existing = interned[string];
+        if(existing){
+            return existing;
+        }
+        //values come from servers too, past the limit they are only copied
+        existing = [string copy];
+        if(interned.count < kInternedLimit){
+            interned[existing] = existing;
+        }
+        return existing;
+    }
+}
+
++(instancetype)mediaTypeWithString:(NSString *)string{
+    if(!string.length){
+        return nil;
+    }
+    LBMediaType *cached = [[self parsedCache]objectForKey:string];
+    if(cached){
+        return cached;
+    }
+    LBMediaType *mediaType = [[self alloc]initWithString:string];
+    if(mediaType){
+        [[self parsedCache]setObject:mediaType forKey:string];
+    }
+    return mediaType;
+}
+
+-(instancetype)initWithString:(NSString *)string{
+    NSArray *components = [string componentsSeparatedByString:@";"];
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+    NSString *essence = [[components.firstObject stringByTrimmingCharactersInSet:whitespace]lowercaseString];
+    NSRange slash = [essence rangeOfString:@"/"];
+    if(slash.location == NSNotFound || slash.location == 0 || slash.location == essence.length - 1){
+        return nil;
+    }
+
+    self = [super init];
+    if(self){
+        _type = [essence substringToIndex:slash.location];
+        _subtype = [essence substringFromIndex:slash.location + 1];
+        _essence = [LBMediaType internedString:essence];
+        NSRange plus = [_subtype rangeOfString:@"+" options:NSBackwardsSearch];
+        if(plus.location != NSNotFound && plus.location < _subtype.length - 1){
+            _suffix = [_subtype substringFromIndex:plus.location + 1];
+        }
+
+        NSMutableDictionary *parameters = [[NSMutableDictionary alloc]init];
+        for(NSUInteger i = 1; i < components.count; i++){
+            NSString *parameter = components[i];
+            NSRange equals = [parameter rangeOfString:@"="];
+            if(equals.location == NSNotFound){
+                continue;
+            }
+            NSString *name = [[[parameter substringToIndex:equals.location]stringByTrimmingCharactersInSet:whitespace]lowercaseString];
+            NSString *value = [[parameter substringFromIndex:equals.location + 1]stringByTrimmingCharactersInSet:whitespace];
+            if(value.length >= 2 && [value hasPrefix:@"\""] && [value hasSuffix:@"\""]){
+                value = [value substringWithRange:NSMakeRange(1, value.length - 2)];
+            }
+            if(name.length){
+                parameters[name] = value;
+            }
+        }
+        _parameters = [parameters copy];
+    }
+    return self;
+}
+
+-(BOOL)isWildcard{
+    return [_type isEqualToString:@"*"] || [_subtype isEqualToString:@"*"];
+}
+
+-(NSString *)description{
+    return [NSString stringWithFormat:@"%@ %@", _essence, _parameters];
+}
+
+@end
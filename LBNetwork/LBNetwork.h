@@ -32,4 +32,27 @@ FOUNDATION_EXPORT const unsigned char LBNetworkVersionString[];
 #import "LBServerResponse.h"
 #import "LBURLConnectionProperties.h"
 #import "HTTPStatusCodes.h"
+#import "LBSegmentedDownload.h"
+#import "LBConcurrencyLimiter.h"
+#import "LBRequestJournal.h"
+#import "LBClientMetrics.h"
+#import "LBMediaType.h"
+#import "LBDeserializerRegistry.h"
+#import "LBBufferPool.h"
+#import "LBRequestTemplate.h"
+#import "LBTransport.h"
+#import "LBLoopbackTransport.h"
+#import "LBRecordReplayTransport.h"
+#import "LBResponseCache.h"
+#import "LBPrefetcher.h"
+#import "LBRecordFramer.h"
+#import "LBImageEncoder.h"
+#import "LBImageCache.h"
+#import "LBImageDeserializer.h"
+#import "LBDigest.h"
+#import "LBEndpointGroup.h"
+#import "LBRateLimiter.h"
+#import "LBTracer.h"
+#import "LBUploadDeduplicator.h"
+#import "LBChannel.h"
 
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBPrefetcher.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+@class LBHTTPSClient;
+@class LBServerRequest;
+@class LBCachedResponse;
+
+/**
+ * Bounded store of prefetched responses, oldest evicted first. Responses older
+ * than maxAge are dropped and each response is handed out once.
+ */
+@interface LBPrefetchStore : NSObject
+
+@property (nonatomic,assign)NSUInteger maxEntries;
+@property (nonatomic,assign)NSUInteger maxBytes;
+@property (nonatomic,assign)NSTimeInterval maxAge;
+@property (nonatomic,assign,readonly)NSUInteger count;
+@property (nonatomic,assign,readonly)NSUInteger bytes;
+
+-(void)setResponse:(LBCachedResponse *)response forKey:(NSString *)key;
+-(LBCachedResponse *)takeResponseForKey:(NSString *)key;
+-(BOOL)containsResponseForKey:(NSString *)key;
+-(void)removeAllResponses;
+@end
+
+/**
+ * Speculative GET requests that never compete with the client's own traffic.
+ *
+ * Prefetches load on their own background delegate queue, marked with the background
+ * network service type, through the client's rate and concurrency limiters like any
+ * other request, at most maxConcurrentPrefetches at a time and only while fewer
+ * than foregroundLoadThreshold foreground connections are in flight. Once foreground
+ * load reaches the threshold the running prefetches are cancelled and queued again.
+ * Finished responses go to the store, where a later sendRequest: of the same method and
+ * URL picks them up instead of going to the network. Memory warnings empty the store
+ * and cancel the running prefetches.
+ */
+@interface LBPrefetcher : NSObject <NSURLConnectionDataDelegate>
+
+@property (nonatomic,weak,readonly)LBHTTPSClient *client;
+@property (nonatomic,strong,readonly)LBPrefetchStore *store;
+@property (nonatomic,assign)NSUInteger maxConcurrentPrefetches;
+@property (nonatomic,assign)NSUInteger maxPendingPrefetches;
+@property (nonatomic,assign)NSUInteger foregroundLoadThreshold;
+
+-(instancetype)initWithClient:(LBHTTPSClient *)client;
+
+/**
+ * request must already be set up by the client
+ */
+-(void)prefetchRequest:(LBServerRequest *)request;
+/**
+ * The prefetched response for request if there is one, a prefetch of it that is
+ * still queued or running is cancelled
+ */
+-(LBCachedResponse *)takeResponseForRequest:(NSURLRequest *)request;
+-(void)foregroundLoadDidChange:(NSUInteger)inFlight;
+-(void)cancelAll;
+-(NSUInteger)outstandingCount;
+@end
@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBPrefetcher.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import "Logging.h"
+#define kDefaultMaxPrefetchEntries 32
+#define kDefaultMaxPrefetchBytes (4 * 1024 * 1024)
+#define kDefaultMaxPrefetchAge 120
+#define kDefaultMaxConcurrentPrefetches 2
+#define kDefaultMaxPendingPrefetches 16
+#define kDefaultForegroundLoadThreshold 2
+
+#define LBLogDebug(fmt, ...) if ([self.client shouldLog]) LogDebug(fmt,##__VA_ARGS__)
+
+@interface LBPrefetchStore ()
+@property (nonatomic,strong)NSMutableDictionary *responses;
+@property (nonatomic,strong)NSMutableArray *keys;
+@property (nonatomic,assign,readwrite)NSUInteger bytes;
+@end
+
+@implementation LBPrefetchStore
+
+-(instancetype)init{
+    self = [super init];
+    if (self) {
+        self.responses = [NSMutableDictionary dictionary];
+        self.keys = [NSMutableArray array];
+        self.maxEntries = kDefaultMaxPrefetchEntries;
+        self.maxBytes = kDefaultMaxPrefetchBytes;
+        self.maxAge = kDefaultMaxPrefetchAge;
+    }
+    return self;
+}
+
+-(NSUInteger)count{
+    @synchronized (self) {
+        return self.keys.count;
+    }
+}
+
+-(LBCachedResponse *)removeResponseForKey:(NSString *)key{
+    LBCachedResponse *response = self.responses[key];
+    if (response) {
+        self.bytes -= response.body.length;
+        [self.responses removeObjectForKey:key];
+        [self.keys removeObject:key];
+    }
+    return response;
+}
+
+-(void)setResponse:(LBCachedResponse *)response forKey:(NSString *)key{
+    if (!key || !response || response.body.length > self.maxBytes) {
+        return;
+    }
+    @synchronized (self) {
+        [self removeResponseForKey:key];
+        self.responses[key] = response;
+        [self.keys addObject:key];
+        self.bytes += response.body.length;
+        while (self.keys.count > self.maxEntries || self.bytes > self.maxBytes) {
+            [self removeResponseForKey:self.keys.firstObject];
+        }
+    }
+}
+
+-(LBCachedResponse *)takeResponseForKey:(NSString *)key{
+    if (!key) {
+        return nil;
+    }
+    LBCachedResponse *response;
+    @synchronized (self) {
+        response = [self removeResponseForKey:key];
+    }
+    if (response && -[response.date timeIntervalSinceNow] > self.maxAge) {
+        return nil;
+    }
+    return response;
+}
+
+-(BOOL)containsResponseForKey:(NSString *)key{
+    @synchronized (self) {
+        return key && self.responses[key] != nil;
+    }
+}
+
+-(void)removeAllResponses{
+    @synchronized (self) {
+        [self.responses removeAllObjects];
+        [self.keys removeAllObjects];
+        self.bytes = 0;
+    }
+}
+@end
+
+@interface LBPrefetcher ()
+@property (nonatomic,weak,readwrite)LBHTTPSClient *client;
+@property (nonatomic,strong,readwrite)LBPrefetchStore *store;
+@property (nonatomic,strong)NSOperationQueue *queue;
+@property (nonatomic,strong)NSMutableArray *pending;
+@property (nonatomic,strong)NSMutableArray *pendingKeys;
+@property (nonatomic,strong)NSMapTable *active;
+@property (nonatomic,assign)NSUInteger foregroundLoad;
+@end
+
+@implementation LBPrefetcher
+
+-(instancetype)initWithClient:(LBHTTPSClient *)client{
+    self = [super init];
+    if (self) {
+        self.client = client;
+        self.store = [[LBPrefetchStore alloc]init];
+        self.queue = [[NSOperationQueue alloc]init];
+        self.queue.maxConcurrentOperationCount = 1;
+        self.queue.qualityOfService = NSQualityOfServiceBackground;
+        self.queue.name = @"LBPrefetchQueue";
+        self.pending = [NSMutableArray array];
+        self.pendingKeys = [NSMutableArray array];
+        self.active = [NSMapTable strongToStrongObjectsMapTable];
+        self.maxConcurrentPrefetches = kDefaultMaxConcurrentPrefetches;
+        self.maxPendingPrefetches = kDefaultMaxPendingPrefetches;
+        self.foregroundLoadThreshold = kDefaultForegroundLoadThreshold;
+        [[NSNotificationCenter defaultCenter]addObserver:self
+                                                selector:@selector(didReceiveMemoryWarning)
+                                                    name:UIApplicationDidReceiveMemoryWarningNotification
+                                                  object:nil];
+    }
+    return self;
+}
+
+-(void)dealloc{
+    [[NSNotificationCenter defaultCenter]removeObserver:self];
+}
+
+-(BOOL)shouldLog{
+    return [self.client shouldLog];
+}
+
+-(NSUInteger)outstandingCount{
+    @synchronized (self) {
+        return self.pending.count + self.active.count;
+    }
+}
+
+#pragma mark - scheduling
+
+-(BOOL)isOutstandingKey:(NSString *)key{
+    if ([self.pendingKeys containsObject:key]) {
+        return YES;
+    }
+    for (LBURLConnection *con in self.active) {
+        if ([[self.active objectForKey:con] isEqualToString:key]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+-(void)prefetchRequest:(LBServerRequest *)request{
+    if (![request.method isEqualToString:kMethodGET] || !request.httpRequest) {
+        return;
+    }
+    NSString *key = [LBResponseCache keyForRequest:request.httpRequest];
+    @synchronized (self) {
+        if ([self.store containsResponseForKey:key] || [self isOutstandingKey:key]) {
+            return;
+        }
+        [self.pending addObject:request];
+        [self.pendingKeys addObject:key];
+        while (self.pending.count > self.maxPendingPrefetches) {
+            //the oldest guess is the least likely to still be needed
+            [self.pending removeObjectAtIndex:0];
+            [self.pendingKeys removeObjectAtIndex:0];
+        }
+    }
+    [self startPendingPrefetches];
+}
+
+-(void)startPendingPrefetches{
+    NSMutableArray *connections = [NSMutableArray array];
+    @synchronized (self) {
+        while (self.pending.count && self.active.count < self.maxConcurrentPrefetches && self.foregroundLoad < self.foregroundLoadThreshold) {
+            LBServerRequest *request = self.pending.firstObject;
+            NSString *key = self.pendingKeys.firstObject;
+            [self.pending removeObjectAtIndex:0];
+            [self.pendingKeys removeObjectAtIndex:0];
+            request.httpRequest.networkServiceType = NSURLNetworkServiceTypeBackground;
+            LBURLConnection *con = [[LBURLConnection alloc]initWithRequest:request delegate:self];
+            con.prefetch = YES;
+            [self.active setObject:key forKey:con];
+            [connections addObject:con];
+        }
+    }
+    for (LBURLConnection *con in connections) {
+        LBLogDebug(@"prefetching:%@", [[con originalRequest] URL]);
+        //a throttled or congested host gets no more speculative traffic than the rest
+        [self.client scheduleConnection:con delegateQueue:self.queue];
+    }
+}
+
+/**
+ * Stops the running prefetches, requeue puts them back in front of the pending ones
+ */
+-(void)cancelActivePrefetchesRequeue:(BOOL)requeue{
+    NSMutableArray *connections = [NSMutableArray array];
+    @synchronized (self) {
+        for (LBURLConnection *con in self.active) {
+            [connections addObject:con];
+            if (requeue) {
+                [self.pending insertObject:con.request atIndex:0];
+                [self.pendingKeys insertObject:[self.active objectForKey:con] atIndex:0];
+            }
+        }
+        [self.active removeAllObjects];
+    }
+    for (LBURLConnection *con in connections) {
+        [self.client cancelConnection:con];
+    }
+}
+
+-(void)foregroundLoadDidChange:(NSUInteger)inFlight{
+    BOOL overloaded;
+    BOOL hasPrefetches;
+    @synchronized (self) {
+        self.foregroundLoad = inFlight;
+        overloaded = inFlight >= self.foregroundLoadThreshold;
+        hasPrefetches = self.active.count > 0 || self.pending.count > 0;
+    }
+    if (!hasPrefetches) {
+        return;
+    }
+    if (overloaded) {
+        [self cancelActivePrefetchesRequeue:YES];
+    }
+    else {
+        [self startPendingPrefetches];
+    }
+}
+
+-(void)cancelAll{
+    @synchronized (self) {
+        [self.pending removeAllObjects];
+        [self.pendingKeys removeAllObjects];
+    }
+    [self cancelActivePrefetchesRequeue:NO];
+}
+
+-(void)didReceiveMemoryWarning{
+    [self.store removeAllResponses];
+    [self cancelActivePrefetchesRequeue:NO];
+}
+
+-(LBCachedResponse *)takeResponseForRequest:(NSURLRequest *)request{
+    NSString *key = [LBResponseCache keyForRequest:request];
+    LBCachedResponse *response = [self.store takeResponseForKey:key];
+    if (response) {
+        return response;
+    }
+
+    //the request is being sent for real, a prefetch of it would be wasted
+    LBURLConnection *running = nil;
+    @synchronized (self) {
+        NSUInteger index = [self.pendingKeys indexOfObject:key];
+        if (index != NSNotFound) {
+            [self.pending removeObjectAtIndex:index];
+            [self.pendingKeys removeObjectAtIndex:index];
+        }
+        for (LBURLConnection *con in self.active) {
+            if ([[self.active objectForKey:con] isEqualToString:key]) {
+                running = con;
+                break;
+            }
+        }
+        if (running) {
+            [self.active removeObjectForKey:running];
+        }
+    }
+    if (running) {
+        [self.client cancelConnection:running];
+        [self startPendingPrefetches];
+    }
+    return nil;
+}
+
+#pragma mark - connection delegate
+
+-(NSString *)keyForConnection:(NSURLConnection *)connection{
+    @synchronized (self) {
+        return [self.active objectForKey:connection];
+    }
+}
+
+-(NSString *)finishConnection:(NSURLConnection *)connection{
+    NSString *key;
+    @synchronized (self) {
+        key = [self.active objectForKey:connection];
+        [self.active removeObjectForKey:connection];
+    }
+    return key;
+}
+
+-(void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response{
+    LBURLConnection *con = (LBURLConnection *) connection;
+    if (![self keyForConnection:con]) {
+        return;
+    }
+    if (response.expectedContentLength > (long long) self.store.maxBytes) {
+        //would never fit the store
+        [self finishConnection:con];
+        [self.client cancelConnection:con];
+        [self startPendingPrefetches];
+        return;
+    }
+    con.rawResponse = (NSHTTPURLResponse *) response;
+    con.responseTime = CFAbsoluteTimeGetCurrent();
+    con.data = [NSMutableData dataWithCapacity:(NSUInteger) MAX(0, response.expectedContentLength)];
+}
+
+-(void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data{
+    LBURLConnection *con = (LBURLConnection *) connection;
+    [con.data appendData:data];
+    if (con.data.length > self.store.maxBytes && [self finishConnection:con]) {
+        [self.client cancelConnection:con];
+        [self startPendingPrefetches];
+    }
+}
+
+-(void)connectionDidFinishLoading:(NSURLConnection *)connection{
+    LBURLConnection *con = (LBURLConnection *) connection;
+    NSString *key = [self finishConnection:con];
+    NSInteger statusCode = con.rawResponse.statusCode;
+    if (key) {
+        //one that was taken or cancelled has already given its slot back
+        [self.client finishConnection:con bytes:con.data.length failed:statusCode >= kHTTPStatusCodeInternalServerError || statusCode == kHTTPStatusCodeTooManyRequests];
+    }
+    if (key && statusCode >= 200 && statusCode < 300) {
+        //the buffer is our own, no pool involved
+        [self.store setResponse:[LBCachedResponse cachedResponseWithResponse:con.rawResponse body:con.data] forKey:key];
+        LBLogDebug(@"prefetched:%@", [[con originalRequest] URL]);
+    }
+    con.data = nil;
+    [con cancel];
+    [self startPendingPrefetches];
+}
+
+-(void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error{
+    LBURLConnection *con = (LBURLConnection *) connection;
+    if ([self finishConnection:con]) {
+        [self.client finishConnection:con bytes:0 failed:YES];
+    }
+    con.data = nil;
+    LBLogDebug(@"prefetch failed:%@", error);
+    [self startPendingPrefetches];
+}
+
+-(NSCachedURLResponse *)connection:(NSURLConnection *)connection willCacheResponse:(NSCachedURLResponse *)cachedResponse{
+    return nil;
+}
+
+-(BOOL)connection:(NSURLConnection *)connection canAuthenticateAgainstProtectionSpace:(NSURLProtectionSpace *)protectionSpace{
+    return [self.client connection:connection canAuthenticateAgainstProtectionSpace:protectionSpace];
+}
+
+-(void)connection:(NSURLConnection *)connection didReceiveAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge{
+    [self.client connection:connection didReceiveAuthenticationChallenge:challenge];
+}
+@end
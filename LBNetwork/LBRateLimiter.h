@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBRateLimiter.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Token buckets per host and per route (host and path), a request is started once
+ * both its buckets hold a token. Keys without a bucket are not limited.
+ *
+ * Buckets tighten from the server's own signals: a 429 throttles the route and a 503
+ * the host, cutting its rate by backoffRatio (or starting it at throttledRate), emptying
+ * it and holding it for Retry-After. Each other response adds recoveryStep to the rate,
+ * up to the configured rate, and a bucket created by throttling is dropped again once
+ * its rate climbs past releaseRate, or once no request has used it for idleTimeout.
+ */
+@interface LBRateLimiter : NSObject
+
+@property (nonatomic,assign)double throttledRate;
+@property (nonatomic,assign)double backoffRatio;
+@property (nonatomic,assign)double minRate;
+@property (nonatomic,assign)double recoveryStep;
+@property (nonatomic,assign)double releaseRate;
+/**
+ * Upper bound on a Retry-After hold
+ */
+@property (nonatomic,assign)NSTimeInterval maxRetryAfter;
+/**
+ * How long a bucket created by throttling is kept without requests, routes are whole
+ * paths so a throttled /users/123 would otherwise stay until it recovers
+ */
+@property (nonatomic,assign)NSTimeInterval idleTimeout;
+
+/**
+ * rate in requests per second, burst requests may go at once after an idle period
+ */
+-(void)setRate:(double)rate burst:(NSUInteger)burst forHost:(NSString *)host;
+/**
+ * route is host and path, as routeForURL: returns
+ */
+-(void)setRate:(double)rate burst:(NSUInteger)burst forRoute:(NSString *)route;
++(NSString *)routeForURL:(NSURL *)URL;
+
+-(void)scheduleForURL:(NSURL *)URL block:(dispatch_block_t)block;
+-(void)recordResponse:(NSHTTPURLResponse *)response forURL:(NSURL *)URL;
+
+-(double)rateForHost:(NSString *)host;
+-(double)rateForRoute:(NSString *)route;
+-(NSUInteger)waitingForHost:(NSString *)host;
+/**
+ * Retry-After in seconds, given as seconds or an HTTP date, 0 when absent
+ */
++(NSTimeInterval)retryAfterForResponse:(NSHTTPURLResponse *)response;
+@end
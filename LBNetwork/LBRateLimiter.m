@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBRateLimiter.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+
+#define kDefaultThrottledRate 2.0
+#define kDefaultBackoffRatio 0.5
+#define kDefaultMinRate 0.1
+#define kDefaultRecoveryStep 0.5
+#define kDefaultReleaseRate 20.0
+#define kDefaultMaxRetryAfter 300.0
+#define kDefaultIdleTimeout 300.0
+
+@interface LBTokenBucket : NSObject
+@property (nonatomic,assign)double rate;
+@property (nonatomic,assign)double ceiling;
+@property (nonatomic,assign)double burst;
+@property (nonatomic,assign)double tokens;
+@property (nonatomic,assign)CFAbsoluteTime lastRefill;
+@property (nonatomic,assign)CFAbsoluteTime blockedUntil;
+@property (nonatomic,assign)CFAbsoluteTime lastUsed;
+@end
+
+@implementation LBTokenBucket
+
+-(void)refill:(CFAbsoluteTime)now{
+    //nothing accrues while held by Retry-After
+    CFAbsoluteTime from = MAX(self.lastRefill, self.blockedUntil);
+    if(now > from){
+        self.tokens = MIN(self.burst, self.tokens + (now - from) * self.rate);
+        self.lastRefill = now;
+    }
+}
+
+/**
+ * When a token will be there, now if there is one
+ */
+-(CFAbsoluteTime)readyTime:(CFAbsoluteTime)now{
+    [self refill:now];
+    if(now < self.blockedUntil){
+        return self.blockedUntil + MAX(0, 1 - self.tokens) / self.rate;
+    }
+    return self.tokens >= 1 ? now : now + (1 - self.tokens) / self.rate;
+}
+@end
+
+@interface LBRateWaiter : NSObject
+@property (nonatomic,copy)NSString *route;
+@property (nonatomic,copy)dispatch_block_t block;
+@end
+
+@implementation LBRateWaiter
+@end
+
+@interface LBRateLimiter ()
+@property (nonatomic,strong)NSMutableDictionary *hostBuckets;
+@property (nonatomic,strong)NSMutableDictionary *routeBuckets;
+@property (nonatomic,strong)NSMutableDictionary *waiters;
+@property (nonatomic,strong)NSMutableDictionary *drainTimes;
+@end
+
+@implementation LBRateLimiter
+
+-(instancetype)init{
+    self = [super init];
+    if(self){
+        _throttledRate = kDefaultThrottledRate;
+        _backoffRatio = kDefaultBackoffRatio;
+        _minRate = kDefaultMinRate;
+        _recoveryStep = kDefaultRecoveryStep;
+        _releaseRate = kDefaultReleaseRate;
+        _maxRetryAfter = kDefaultMaxRetryAfter;
+        _idleTimeout = kDefaultIdleTimeout;
+        self.hostBuckets = [[NSMutableDictionary alloc]init];
+        self.routeBuckets = [[NSMutableDictionary alloc]init];
+        self.waiters = [[NSMutableDictionary alloc]init];
+        self.drainTimes = [[NSMutableDictionary alloc]init];
+    }
+    return self;
+}
+
++(NSString *)routeForURL:(NSURL *)URL{
+    return [NSString stringWithFormat:@"%@%@", URL.host ?: @"", URL.path.length ? URL.path : @"/"];
+}
+
+-(LBTokenBucket *)bucketWithRate:(double)rate burst:(double)burst{
+    LBTokenBucket *bucket = [[LBTokenBucket alloc]init];
+    bucket.rate = rate;
+    bucket.burst = MAX(1.0, burst);
+    bucket.tokens = bucket.burst;
+    bucket.lastRefill = CFAbsoluteTimeGetCurrent();
+    bucket.lastUsed = bucket.lastRefill;
+    return bucket;
+}
+
+-(void)setRate:(double)rate burst:(NSUInteger)burst forHost:(NSString *)host{
+    @synchronized(self){
+        LBTokenBucket *bucket = [self bucketWithRate:rate burst:burst];
+        bucket.ceiling = rate;
+        self.hostBuckets[host ?: @""] = bucket;
+    }
+}
+
+-(void)setRate:(double)rate burst:(NSUInteger)burst forRoute:(NSString *)route{
+    @synchronized(self){
+        LBTokenBucket *bucket = [self bucketWithRate:rate burst:burst];
+        bucket.ceiling = rate;
+        self.routeBuckets[route] = bucket;
+    }
+}
+
+#pragma mark - scheduling
+
+-(void)scheduleForURL:(NSURL *)URL block:(dispatch_block_t)block{
+    NSString *host = URL.host ?: @"";
+    LBRateWaiter *waiter = [[LBRateWaiter alloc]init];
+    waiter.route = [LBRateLimiter routeForURL:URL];
+    waiter.block = block;
+    NSArray *ready;
+    @synchronized(self){
+        NSMutableArray *waiting = self.waiters[host];
+        if(!waiting){
+            waiting = [[NSMutableArray alloc]init];
+            self.waiters[host] = waiting;
+        }
+        [waiting addObject:waiter];
+        ready = [self drainHost:host];
+    }
+    for(dispatch_block_t readyBlock in ready){
+        readyBlock();
+    }
+}
+
+/**
+ * Takes tokens for the waiters that can go, in order, and arms a timer for the rest.
+ * Called with the lock held, the returned blocks are run after it is released.
+ */
+-(NSArray *)drainHost:(NSString *)host{
+    NSMutableArray *waiting = self.waiters[host];
+    NSMutableArray *ready = [[NSMutableArray alloc]init];
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    CFAbsoluteTime nextTime = 0;
+    LBTokenBucket *hostBucket = self.hostBuckets[host];
+    NSUInteger index = 0;
+    while(index < waiting.count){
+        LBRateWaiter *waiter = waiting[index];
+        LBTokenBucket *routeBucket = self.routeBuckets[waiter.route];
+        CFAbsoluteTime readyTime = MAX(hostBucket ? [hostBucket readyTime:now] : now, routeBucket ? [routeBucket readyTime:now] : now);
+        if(readyTime <= now){
+            hostBucket.tokens -= 1;
+            routeBucket.tokens -= 1;
+            hostBucket.lastUsed = now;
+            routeBucket.lastUsed = now;
+            [ready addObject:waiter.block];
+            [waiting removeObjectAtIndex:index];
+            continue;
+        }
+        //a throttled route must not hold back the other routes of the host
+        nextTime = nextTime > 0 ? MIN(nextTime, readyTime) : readyTime;
+        index++;
+    }
+    if(!waiting.count){
+        [self.waiters removeObjectForKey:host];
+    }
+    else{
+        [self scheduleDrainOfHost:host at:nextTime];
+    }
+    return ready;
+}
+
+-(void)scheduleDrainOfHost:(NSString *)host at:(CFAbsoluteTime)time{
+    NSNumber *scheduled = self.drainTimes[host];
+    if(scheduled && scheduled.doubleValue <= time){
+        return;
+    }
+    self.drainTimes[host] = @(time);
+    NSTimeInterval delay = MAX(0, time - CFAbsoluteTimeGetCurrent());
+    __weak LBRateLimiter *weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        LBRateLimiter *limiter = weakSelf;
+        NSArray *ready;
+        @synchronized(limiter){
+            if([limiter.drainTimes[host] doubleValue] != time){
+                //superseded by an earlier drain
+                return;
+            }
+            [limiter.drainTimes removeObjectForKey:host];
+            ready = [limiter drainHost:host];
+        }
+        for(dispatch_block_t readyBlock in ready){
+            readyBlock();
+        }
+    });
+}
+
+#pragma mark - feedback
+
+-(void)recordResponse:(NSHTTPURLResponse *)response forURL:(NSURL *)URL{
+    if(!response){
+        return;
+    }
+    NSString *host = URL.host ?: @"";
+    NSString *route = [LBRateLimiter routeForURL:URL];
+    NSInteger statusCode = response.statusCode;
+    NSArray *ready;
+    @synchronized(self){
+        if(statusCode == kHTTPStatusCodeTooManyRequests || statusCode == kHTTPStatusCodeServiceUnavailable){
+            NSMutableDictionary *buckets = statusCode == kHTTPStatusCodeTooManyRequests ? self.routeBuckets : self.hostBuckets;
+            NSString *key = statusCode == kHTTPStatusCodeTooManyRequests ? route : host;
+            [self throttleKey:key inBuckets:buckets retryAfter:[LBRateLimiter retryAfterForResponse:response]];
+        }
+        else{
+            [self recoverKey:route inBuckets:self.routeBuckets];
+            [self recoverKey:host inBuckets:self.hostBuckets];
+            //a faster rate may let waiters go earlier than the armed timer
+            if(self.waiters[host]){
+                ready = [self drainHost:host];
+            }
+        }
+    }
+    for(dispatch_block_t readyBlock in ready){
+        readyBlock();
+    }
+}
+
+-(void)throttleKey:(NSString *)key inBuckets:(NSMutableDictionary *)buckets retryAfter:(NSTimeInterval)retryAfter{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    LBTokenBucket *bucket = buckets[key];
+    if(!bucket){
+        [self evictIdleBuckets:buckets now:now];
+        bucket = [self bucketWithRate:self.throttledRate burst:1];
+        buckets[key] = bucket;
+    }
+    else{
+        [bucket refill:now];
+        bucket.rate = MAX(self.minRate, bucket.rate * self.backoffRatio);
+    }
+    bucket.tokens = 0;
+    bucket.lastRefill = now;
+    bucket.lastUsed = now;
+    if(retryAfter > 0){
+        //one request may go as soon as the server said it would take it
+        bucket.tokens = 1;
+        bucket.blockedUntil = MAX(bucket.blockedUntil, now + MIN(retryAfter, self.maxRetryAfter));
+    }
+}
+
+/**
+ * Drops buckets created by throttling that no request has used for idleTimeout, so
+ * routes with ids in their path do not pile up. Configured buckets, ones still held
+ * by Retry-After and ones with waiters are kept. Called with the lock held.
+ */
+-(void)evictIdleBuckets:(NSMutableDictionary *)buckets now:(CFAbsoluteTime)now{
+    NSMutableSet *waiting = [[NSMutableSet alloc]init];
+    [self.waiters enumerateKeysAndObjectsUsingBlock:^(NSString *host, NSArray *hostWaiters, BOOL *stop) {
+        [waiting addObject:host];
+        for(LBRateWaiter *waiter in hostWaiters){
+            [waiting addObject:waiter.route];
+        }
+    }];
+    NSMutableArray *idle = [[NSMutableArray alloc]init];
+    [buckets enumerateKeysAndObjectsUsingBlock:^(NSString *key, LBTokenBucket *bucket, BOOL *stop) {
+        if(bucket.ceiling <= 0 && now >= bucket.blockedUntil && now - bucket.lastUsed >= self.idleTimeout && ![waiting containsObject:key]){
+            [idle addObject:key];
+        }
+    }];
+    [buckets removeObjectsForKeys:idle];
+}
+
+-(void)recoverKey:(NSString *)key inBuckets:(NSMutableDictionary *)buckets{
+    LBTokenBucket *bucket = buckets[key];
+    if(!bucket){
+        return;
+    }
+    [bucket refill:CFAbsoluteTimeGetCurrent()];
+    bucket.rate += self.recoveryStep;
+    if(bucket.ceiling > 0){
+        bucket.rate = MIN(bucket.rate, bucket.ceiling);
+    }
+    else if(bucket.rate >= self.releaseRate){
+        [buckets removeObjectForKey:key];
+    }
+}
+
++(NSTimeInterval)retryAfterForResponse:(NSHTTPURLResponse *)response{
+    NSString *retryAfter = nil;
+    for(NSString *field in response.allHeaderFields){
+        if([field caseInsensitiveCompare:@"Retry-After"] == NSOrderedSame){
+            retryAfter = response.allHeaderFields[field];
+            break;
+        }
+    }
+    retryAfter = [retryAfter stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    if(!retryAfter.length){
+        return 0;
+    }
+    NSScanner *scanner = [NSScanner scannerWithString:retryAfter];
+    NSInteger seconds;
+    if([scanner scanInteger:&seconds] && scanner.isAtEnd){
+        return MAX(0, seconds);
+    }
+    static NSDateFormatter *formatter;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        formatter = [[NSDateFormatter alloc]init];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.timeZone = [NSTimeZone timeZoneWithAbbreviation:@"GMT"];
+        formatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss zzz";
+    });
+    NSDate *date;
+    @synchronized(formatter){
+        date = [formatter dateFromString:retryAfter];
+    }
+    return date ? MAX(0, date.timeIntervalSinceNow) : 0;
+}
+
+#pragma mark - inspection
+
+-(double)rateForHost:(NSString *)host{
+    @synchronized(self){
+        return [self.hostBuckets[host ?: @""] rate];
+    }
+}
+
+-(double)rateForRoute:(NSString *)route{
+    @synchronized(self){
+        return [self.routeBuckets[route] rate];
+    }
+}
+
+-(NSUInteger)waitingForHost:(NSString *)host{
+    @synchronized(self){
+        return [self.waiters[host ?: @""] count];
+    }
+}
+
+@end
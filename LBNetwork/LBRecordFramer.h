@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBRecordFramer.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Splits a streamed response body into records as the bytes arrive.
+ *
+ * Set one on LBServerRequest.recordFramer together with a recordHandler and the client
+ * feeds it from didReceiveData: instead of buffering the body, calling the handler for
+ * every completed record on the delegate queue. Only the incomplete tail is buffered,
+ * appending fails once it grows past maxRecordLength. Handlers run before the next
+ * chunk is read, so a slow consumer holds the connection back instead of piling up
+ * records.
+ *
+ * This class is abstract, see LBLineFramer, LBServerSentEventFramer and
+ * LBLengthPrefixedFramer.
+ */
+@interface LBRecordFramer : NSObject
+
+@property (nonatomic,assign)NSUInteger maxRecordLength;
+/**
+ * NSData records are deserialized with the deserializer registered for this type,
+ * nil hands them over as data
+ */
+@property (nonatomic,copy)NSString *recordContentType;
+@property (nonatomic,assign,readonly)NSUInteger bufferedLength;
+
++(instancetype)framer;
+
+/**
+ * Returns NO when a record exceeds maxRecordLength or is malformed, records framed
+ * before that are still available from nextRecord
+ */
+-(BOOL)appendData:(NSData *)data error:(NSError **)error;
+-(id)nextRecord;
+/**
+ * End of stream, frames what is left if it forms a record
+ */
+-(void)finish;
+-(void)reset;
+
+/**
+ * For subclasses: frames the start of bytes, returns the number of bytes consumed,
+ * 0 when more are needed and NSNotFound on errors. A line can be consumed without
+ * completing a record.
+ */
+-(NSUInteger)frameBytes:(const uint8_t *)bytes length:(NSUInteger)length record:(id *)record error:(NSError **)error;
+-(id)recordFromRemainingBytes:(const uint8_t *)bytes length:(NSUInteger)length;
+@end
+
+/**
+ * Newline delimited records, NDJSON by default. Blank lines are skipped and a
+ * trailing "\r" is dropped.
+ */
+@interface LBLineFramer : LBRecordFramer
+@end
+
+@interface LBServerSentEvent : NSObject
+@property (nonatomic,copy)NSString *type;
+@property (nonatomic,copy)NSString *data;
+@property (nonatomic,copy)NSString *identifier;
+@property (nonatomic,assign)NSTimeInterval retry;
+@end
+
+/**
+ * text/event-stream, records are LBServerSentEvents
+ */
+@interface LBServerSentEventFramer : LBRecordFramer
+@property (nonatomic,copy,readonly)NSString *lastEventIdentifier;
+@end
+
+/**
+ * Frames prefixed with their length as a 32 bit big endian integer
+ */
+@interface LBLengthPrefixedFramer : LBRecordFramer
+@end
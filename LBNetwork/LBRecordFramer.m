@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBRecordFramer.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#define kDefaultMaxRecordLength (1024 * 1024)
+
+static NSError *LBRecordTooLargeError(NSUInteger maxRecordLength) {
+    NSString *description = [NSString stringWithFormat:@"Streamed record exceeds %lu bytes", (unsigned long) maxRecordLength];
+    return [NSError errorWithDomain:LBNetworkErrorDomain code:LBNetworkErrorRecordTooLarge userInfo:@{NSLocalizedDescriptionKey : description}];
+}
+
+@interface LBRecordFramer ()
+@property (nonatomic,strong)NSMutableData *buffer;
+@property (nonatomic,strong)NSMutableArray *records;
+@end
+
+@implementation LBRecordFramer
+
++(instancetype)framer{
+    return [[self alloc]init];
+}
+
+-(instancetype)init{
+    self = [super init];
+    if (self) {
+        self.buffer = [[NSMutableData alloc]init];
+        self.records = [[NSMutableArray alloc]init];
+        self.maxRecordLength = kDefaultMaxRecordLength;
+    }
+    return self;
+}
+
+-(NSUInteger)bufferedLength{
+    return self.buffer.length;
+}
+
+-(BOOL)appendData:(NSData *)data error:(NSError **)error{
+    [self.buffer appendData:data];
+    const uint8_t *bytes = self.buffer.bytes;
+    NSUInteger length = self.buffer.length;
+    NSUInteger offset = 0;
+    BOOL framed = YES;
+    while (offset < length) {
+        id record = nil;
+        NSUInteger consumed = [self frameBytes:bytes + offset length:length - offset record:&record error:error];
+        if (consumed == NSNotFound) {
+            framed = NO;
+            break;
+        }
+        if (consumed == 0) {
+            break;
+        }
+        offset += consumed;
+        if (record) {
+            [self.records addObject:record];
+        }
+    }
+    //only the incomplete tail stays buffered
+    if (offset > 0) {
+        [self.buffer replaceBytesInRange:NSMakeRange(0, offset) withBytes:NULL length:0];
+    }
+    if (framed && self.buffer.length > self.maxRecordLength) {
+        if (error) {
+            *error = LBRecordTooLargeError(self.maxRecordLength);
+        }
+        framed = NO;
+    }
+    return framed;
+}
+
+-(id)nextRecord{
+    if (!self.records.count) {
+        return nil;
+    }
+    id record = self.records.firstObject;
+    [self.records removeObjectAtIndex:0];
+    return record;
+}
+
+-(void)finish{
+    if (self.buffer.length) {
+        id record = [self recordFromRemainingBytes:self.buffer.bytes length:self.buffer.length];
+        if (record) {
+            [self.records addObject:record];
+        }
+        [self.buffer setLength:0];
+    }
+}
+
+-(void)reset{
+    [self.buffer setLength:0];
+    [self.records removeAllObjects];
+}
+
+-(NSUInteger)frameBytes:(const uint8_t *)bytes length:(NSUInteger)length record:(id *)record error:(NSError **)error{
+    [self doesNotRecognizeSelector:_cmd];
+    return NSNotFound;
+}
+
+-(id)recordFromRemainingBytes:(const uint8_t *)bytes length:(NSUInteger)length{
+    return nil;
+}
+@end
+
+@implementation LBLineFramer {
+    //the tail was already searched up to here, long records are not rescanned per chunk
+    NSUInteger scanOffset;
+}
+
+-(instancetype)init{
+    self = [super init];
+    if (self) {
+        self.recordContentType = ContentTypeJSON;
+    }
+    return self;
+}
+
+-(void)reset{
+    [super reset];
+    scanOffset = 0;
+}
+
+-(NSData *)lineFromBytes:(const uint8_t *)bytes length:(NSUInteger)length{
+    if (length && bytes[length - 1] == '\r') {
+        length--;
+    }
+    return length ? [NSData dataWithBytes:bytes length:length] : nil;
+}
+
+-(NSUInteger)frameBytes:(const uint8_t *)bytes length:(NSUInteger)length record:(id *)record error:(NSError **)error{
+    NSUInteger from = MIN(scanOffset, length);
+    const uint8_t *newline = memchr(bytes + from, '\n', length - from);
+    if (!newline) {
+        scanOffset = length;
+        return 0;
+    }
+    scanOffset = 0;
+    NSUInteger lineLength = (NSUInteger) (newline - bytes);
+    *record = [self lineFromBytes:bytes length:lineLength];
+    return lineLength + 1;
+}
+
+-(id)recordFromRemainingBytes:(const uint8_t *)bytes length:(NSUInteger)length{
+    scanOffset = 0;
+    return [self lineFromBytes:bytes length:length];
+}
+@end
+
+@implementation LBServerSentEvent
+@end
+
+@interface LBServerSentEventFramer ()
+@property (nonatomic,copy,readwrite)NSString *lastEventIdentifier;
+@property (nonatomic,strong)NSMutableString *eventData;
+@property (nonatomic,copy)NSString *eventType;
+@property (nonatomic,assign)NSTimeInterval eventRetry;
+@end
+
+@implementation LBServerSentEventFramer {
+    NSUInteger scanOffset;
+}
+
+-(void)reset{
+    [super reset];
+    scanOffset = 0;
+    self.eventData = nil;
+    self.eventType = nil;
+    self.eventRetry = 0;
+}
+
+-(NSUInteger)frameBytes:(const uint8_t *)bytes length:(NSUInteger)length record:(id *)record error:(NSError **)error{
+    NSUInteger end = MIN(scanOffset, length);
+    while (end < length && bytes[end] != '\n' && bytes[end] != '\r') {
+        end++;
+    }
+    if (end == length || (bytes[end] == '\r' && end + 1 == length)) {
+        //no line yet, or a "\r" that may still be followed by "\n"
+        scanOffset = end;
+        return 0;
+    }
+    scanOffset = 0;
+    NSUInteger terminatorLength = bytes[end] == '\r' && bytes[end + 1] == '\n' ? 2 : 1;
+    *record = [self processLine:bytes length:end];
+    return end + terminatorLength;
+}
+
+-(LBServerSentEvent *)processLine:(const uint8_t *)bytes length:(NSUInteger)length{
+    if (length == 0) {
+        return [self dispatchEvent];
+    }
+    if (bytes[0] == ':') {
+        //comment, servers use them as keep alives
+        return nil;
+    }
+    const uint8_t *colon = memchr(bytes, ':', length);
+    NSUInteger nameLength = colon ? (NSUInteger) (colon - bytes) : length;
+    NSUInteger valueStart = colon ? nameLength + 1 : length;
+    if (valueStart < length && bytes[valueStart] == ' ') {
+        valueStart++;
+    }
+    NSString *name = [[NSString alloc] initWithBytes:bytes length:nameLength encoding:NSUTF8StringEncoding];
+    NSString *value = [[NSString alloc] initWithBytes:bytes + valueStart length:length - valueStart encoding:NSUTF8StringEncoding] ?: @"";
+
+    if ([name isEqualToString:@"data"]) {
+        if (self.eventData) {
+            [self.eventData appendString:@"\n"];
+            [self.eventData appendString:value];
+        }
+        else {
+            self.eventData = [value mutableCopy];
+        }
+    }
+    else if ([name isEqualToString:@"event"]) {
+        self.eventType = value;
+    }
+    else if ([name isEqualToString:@"id"]) {
+        if ([value rangeOfString:@"\0"].location == NSNotFound) {
+            self.lastEventIdentifier = value;
+        }
+    }
+    else if ([name isEqualToString:@"retry"]) {
+        NSScanner *scanner = [NSScanner scannerWithString:value];
+        long long milliseconds;
+        if ([scanner scanLongLong:&milliseconds] && scanner.isAtEnd) {
+            self.eventRetry = milliseconds / 1000.0;
+        }
+    }
+    return nil;
+}
+
+-(LBServerSentEvent *)dispatchEvent{
+    LBServerSentEvent *event = nil;
+    if (self.eventData) {
+        event = [[LBServerSentEvent alloc]init];
+        event.type = self.eventType.length ? self.eventType : @"message";
+        event.data = self.eventData;
+        event.identifier = self.lastEventIdentifier;
+        event.retry = self.eventRetry;
+    }
+    self.eventData = nil;
+    self.eventType = nil;
+    self.eventRetry = 0;
+    return event;
+}
+
+-(id)recordFromRemainingBytes:(const uint8_t *)bytes length:(NSUInteger)length{
+    //an event cut off by the end of the stream is discarded
+    scanOffset = 0;
+    self.eventData = nil;
+    self.eventType = nil;
+    return nil;
+}
+@end
+
+@implementation LBLengthPrefixedFramer
+
+-(NSUInteger)frameBytes:(const uint8_t *)bytes length:(NSUInteger)length record:(id *)record error:(NSError **)error{
+    if (length < sizeof(uint32_t)) {
+        return 0;
+    }
+    uint32_t recordLength;
+    memcpy(&recordLength, bytes, sizeof(recordLength));
+    recordLength = CFSwapInt32BigToHost(recordLength);
+    if (recordLength > self.maxRecordLength) {
+        //fail on the header instead of buffering up to the limit first
+        if (error) {
+            *error = LBRecordTooLargeError(self.maxRecordLength);
+        }
+        return NSNotFound;
+    }
+    if (length - sizeof(uint32_t) < recordLength) {
+        return 0;
+    }
+    *record = [NSData dataWithBytes:bytes + sizeof(uint32_t) length:recordLength];
+    return sizeof(uint32_t) + recordLength;
+}
+@end
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBRecordReplayTransport.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import "LBTransport.h"
+
+typedef enum{
+    LBRecordReplayModeRecord,
+    LBRecordReplayModeReplay,
+}LBRecordReplayMode;
+
+/**
+ * Captures real sessions and plays them back.
+ *
+ * Recording loads every request through transport (the network by default) and keeps
+ * the status, headers, body, the time to the response, the arrival time of every body
+ * chunk and the total duration. save: writes them to path as a binary property list.
+ *
+ * Replaying answers requests by method and URL with the recorded responses, in the
+ * order they were recorded, repeating the last one once a URL runs out, and keeps the
+ * original timing scaled by timeScale. Unrecorded requests fail with
+ * LBNetworkErrorNotRecorded.
+ */
+@interface LBRecordReplayTransport : NSObject <LBTransport>
+
+@property (nonatomic,copy,readonly)NSString *path;
+@property (nonatomic,assign,readonly)LBRecordReplayMode mode;
+/**
+ * Transport the recorder loads through
+ */
+@property (nonatomic,strong)id<LBTransport> transport;
+/**
+ * 1 replays with the original timing, 0 as fast as possible
+ */
+@property (nonatomic,assign)double timeScale;
+
++(instancetype)recorderWithFile:(NSString *)path;
++(instancetype)replayerWithFile:(NSString *)path;
+-(instancetype)initWithFile:(NSString *)path mode:(LBRecordReplayMode)mode;
+
+-(NSUInteger)recordCount;
+-(BOOL)save:(NSError **)error;
+@end
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBRecordReplayTransport.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+
+static NSString *LBRecordKeyForRequest(NSURLRequest *request) {
+    return [NSString stringWithFormat:@"%@ %@", request.HTTPMethod ?: kMethodGET, request.URL.absoluteString];
+}
+
+@interface LBRecordReplayTransport ()
+@property (nonatomic,strong)NSMutableArray *recordedKeys;
+@property (nonatomic,strong)NSMutableArray *records;
+@property (nonatomic,strong)NSMutableDictionary *replayRecords;
+@property (nonatomic,strong)NSMutableDictionary *replayCursors;
+-(void)addRecord:(LBTransportRecord *)record forKey:(NSString *)key;
+@end
+
+/**
+ * Delegate of the connection that really loads a recorded request, it keeps what
+ * arrives and when, and forwards everything to the delegate of the client's connection
+ */
+@interface LBRecordingConnectionDelegate : NSObject <NSURLConnectionDataDelegate>
+@property (nonatomic,strong)LBURLConnection *connection;
+@property (nonatomic,strong)LBRecordReplayTransport *transport;
+@property (nonatomic,copy)NSString *key;
+@property (nonatomic,strong)LBTransportRecord *record;
+@property (nonatomic,strong)NSMutableData *body;
+@property (nonatomic,strong)NSMutableArray *chunks;
+@property (nonatomic,assign)CFAbsoluteTime startTime;
+@end
+
+@implementation LBRecordingConnectionDelegate
+
+-(NSTimeInterval)elapsed{
+    return CFAbsoluteTimeGetCurrent() - self.startTime;
+}
+
+-(void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response{
+    NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *) response;
+    self.record.responseDelay = [self elapsed];
+    self.record.statusCode = httpResponse.statusCode;
+    self.record.headers = httpResponse.allHeaderFields;
+    //a response after a redirect starts the body over
+    self.body = [NSMutableData data];
+    self.chunks = [NSMutableArray array];
+    id delegate = self.connection.connectionDelegate;
+    if ([delegate respondsToSelector:@selector(connection:didReceiveResponse:)]) {
+        [delegate connection:self.connection didReceiveResponse:response];
+    }
+}
+
+-(void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data{
+    [self.body appendData:data];
+    [self.chunks addObject:@[@([self elapsed]), @(data.length)]];
+    id delegate = self.connection.connectionDelegate;
+    if ([delegate respondsToSelector:@selector(connection:didReceiveData:)]) {
+        [delegate connection:self.connection didReceiveData:data];
+    }
+}
+
+-(void)connectionDidFinishLoading:(NSURLConnection *)connection{
+    self.record.duration = [self elapsed];
+    self.record.body = [self.body copy];
+    self.record.chunks = self.chunks.count ? [self.chunks copy] : nil;
+    [self.transport addRecord:self.record forKey:self.key];
+    id delegate = self.connection.connectionDelegate;
+    if ([delegate respondsToSelector:@selector(connectionDidFinishLoading:)]) {
+        [delegate connectionDidFinishLoading:self.connection];
+    }
+}
+
+-(void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error{
+    self.record.duration = [self elapsed];
+    self.record.error = error;
+    [self.transport addRecord:self.record forKey:self.key];
+    id delegate = self.connection.connectionDelegate;
+    if ([delegate respondsToSelector:@selector(connection:didFailWithError:)]) {
+        [delegate connection:self.connection didFailWithError:error];
+    }
+}
+
+-(NSURLRequest *)connection:(NSURLConnection *)connection willSendRequest:(NSURLRequest *)request redirectResponse:(NSURLResponse *)response{
+    id delegate = self.connection.connectionDelegate;
+    if ([delegate respondsToSelector:@selector(connection:willSendRequest:redirectResponse:)]) {
+        return [delegate connection:self.connection willSendRequest:request redirectResponse:response];
+    }
+    return request;
+}
+
+-(NSCachedURLResponse *)connection:(NSURLConnection *)connection willCacheResponse:(NSCachedURLResponse *)cachedResponse{
+    id delegate = self.connection.connectionDelegate;
+    if ([delegate respondsToSelector:@selector(connection:willCacheResponse:)]) {
+        return [delegate connection:self.connection willCacheResponse:cachedResponse];
+    }
+    return cachedResponse;
+}
+
+-(BOOL)connection:(NSURLConnection *)connection canAuthenticateAgainstProtectionSpace:(NSURLProtectionSpace *)protectionSpace{
+    id delegate = self.connection.connectionDelegate;
+    if ([delegate respondsToSelector:@selector(connection:canAuthenticateAgainstProtectionSpace:)]) {
+        return [delegate connection:self.connection canAuthenticateAgainstProtectionSpace:protectionSpace];
+    }
+    return NO;
+}
+
+-(void)connection:(NSURLConnection *)connection didReceiveAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge{
+    id delegate = self.connection.connectionDelegate;
+    if ([delegate respondsToSelector:@selector(connection:didReceiveAuthenticationChallenge:)]) {
+        [delegate connection:self.connection didReceiveAuthenticationChallenge:challenge];
+        return;
+    }
+    [challenge.sender performDefaultHandlingForAuthenticationChallenge:challenge];
+}
+@end
+
+@implementation LBRecordReplayTransport
+
++(instancetype)recorderWithFile:(NSString *)path{
+    return [[self alloc]initWithFile:path mode:LBRecordReplayModeRecord];
+}
+
++(instancetype)replayerWithFile:(NSString *)path{
+    return [[self alloc]initWithFile:path mode:LBRecordReplayModeReplay];
+}
+
+-(instancetype)initWithFile:(NSString *)path mode:(LBRecordReplayMode)mode{
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+        _mode = mode;
+        self.transport = [[LBNetworkTransport alloc]init];
+        self.timeScale = 1.0;
+        self.recordedKeys = [NSMutableArray array];
+        self.records = [NSMutableArray array];
+        self.replayRecords = [NSMutableDictionary dictionary];
+        self.replayCursors = [NSMutableDictionary dictionary];
+        if (mode == LBRecordReplayModeReplay) {
+            [self load];
+        }
+    }
+    return self;
+}
+
+-(NSUInteger)recordCount{
+    @synchronized (self) {
+        return self.records.count;
+    }
+}
+
+#pragma mark - recording
+
+-(void)addRecord:(LBTransportRecord *)record forKey:(NSString *)key{
+    @synchronized (self) {
+        [self.recordedKeys addObject:key];
+        [self.records addObject:record];
+    }
+}
+
+-(void)startConnection:(LBURLConnection *)connection delegateQueue:(NSOperationQueue *)queue{
+    if (self.mode == LBRecordReplayModeReplay) {
+        LBTransportRecord *record = [self replayRecordForRequest:[connection originalRequest]];
+        [record deliverToConnection:connection queue:queue timeScale:self.timeScale];
+        return;
+    }
+
+    LBRecordingConnectionDelegate *recorder = [[LBRecordingConnectionDelegate alloc]init];
+    recorder.connection = connection;
+    recorder.transport = self;
+    recorder.key = LBRecordKeyForRequest([connection originalRequest]);
+    recorder.record = [[LBTransportRecord alloc]init];
+    LBURLConnection *loader = [[LBURLConnection alloc]initWithRequest:connection.request delegate:recorder];
+    connection.cancellationHandler = ^{
+        [loader cancel];
+    };
+    recorder.startTime = CFAbsoluteTimeGetCurrent();
+    [self.transport startConnection:loader delegateQueue:queue];
+}
+
+-(NSData *)sendSynchronousRequest:(NSURLRequest *)request returningResponse:(NSHTTPURLResponse **)response error:(NSError **)error{
+    if (self.mode == LBRecordReplayModeReplay) {
+        LBTransportRecord *record = [self replayRecordForRequest:request];
+        if (record.duration > 0 && self.timeScale > 0) {
+            [NSThread sleepForTimeInterval:record.duration * self.timeScale];
+        }
+        if (record.error) {
+            if (error) {
+                *error = record.error;
+            }
+            return nil;
+        }
+        if (response) {
+            *response = [record responseForURL:request.URL];
+        }
+        return record.body ?: [NSData data];
+    }
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    NSHTTPURLResponse *httpResponse = nil;
+    NSError *loadError = nil;
+    NSData *data = [self.transport sendSynchronousRequest:request returningResponse:&httpResponse error:&loadError];
+    LBTransportRecord *record = [LBTransportRecord recordWithStatusCode:httpResponse.statusCode headers:httpResponse.allHeaderFields body:data];
+    record.error = loadError;
+    record.duration = CFAbsoluteTimeGetCurrent() - startTime;
+    record.responseDelay = record.duration;
+    [self addRecord:record forKey:LBRecordKeyForRequest(request)];
+    if (response) {
+        *response = httpResponse;
+    }
+    if (error) {
+        *error = loadError;
+    }
+    return data;
+}
+
+#pragma mark - replaying
+
+-(LBTransportRecord *)replayRecordForRequest:(NSURLRequest *)request{
+    NSString *key = LBRecordKeyForRequest(request);
+    @synchronized (self) {
+        NSArray *records = self.replayRecords[key];
+        if (records.count) {
+            NSUInteger cursor = [self.replayCursors[key] unsignedIntegerValue];
+            self.replayCursors[key] = @(cursor + 1);
+            return records[MIN(cursor, records.count - 1)];
+        }
+    }
+    NSString *description = [NSString stringWithFormat:@"No recorded response for %@", key];
+    return [LBTransportRecord recordWithError:[NSError errorWithDomain:LBNetworkErrorDomain
+                                                                  code:LBNetworkErrorNotRecorded
+                                                              userInfo:@{NSLocalizedDescriptionKey : description}]];
+}
+
+#pragma mark - file
+
+-(BOOL)save:(NSError **)error{
+    NSMutableArray *propertyList = [NSMutableArray array];
+    @synchronized (self) {
+        for (NSUInteger i = 0; i < self.records.count; i++) {
+            [propertyList addObject:[self propertyListForRecord:self.records[i] key:self.recordedKeys[i]]];
+        }
+    }
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:propertyList format:NSPropertyListBinaryFormat_v1_0 options:0 error:error];
+    return data && [data writeToFile:self.path options:NSDataWritingAtomic error:error];
+}
+
+-(void)load{
+    NSData *data = [NSData dataWithContentsOfFile:self.path options:NSDataReadingMappedIfSafe error:nil];
+    if (!data) {
+        return;
+    }
+    NSArray *propertyList = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil];
+    if (![propertyList isKindOfClass:[NSArray class]]) {
+        return;
+    }
+    for (NSDictionary *entry in propertyList) {
+        if (![entry isKindOfClass:[NSDictionary class]] || ![entry[@"key"] isKindOfClass:[NSString class]]) {
+            continue;
+        }
+        NSString *key = entry[@"key"];
+        LBTransportRecord *record = [self recordFromPropertyList:entry];
+        [self.recordedKeys addObject:key];
+        [self.records addObject:record];
+        NSMutableArray *records = self.replayRecords[key];
+        if (!records) {
+            records = [NSMutableArray array];
+            self.replayRecords[key] = records;
+        }
+        [records addObject:record];
+    }
+}
+
+-(NSDictionary *)propertyListForRecord:(LBTransportRecord *)record key:(NSString *)key{
+    NSMutableDictionary *entry = [NSMutableDictionary dictionary];
+    entry[@"key"] = key;
+    entry[@"status"] = @(record.statusCode);
+    entry[@"headers"] = record.headers ?: @{};
+    entry[@"body"] = record.body ?: [NSData data];
+    entry[@"delay"] = @(record.responseDelay);
+    entry[@"duration"] = @(record.duration);
+    if (record.chunks) {
+        entry[@"chunks"] = record.chunks;
+    }
+    if (record.error) {
+        //userInfo is not a property list, only the description is kept
+        entry[@"errorDomain"] = record.error.domain;
+        entry[@"errorCode"] = @(record.error.code);
+        entry[@"errorDescription"] = record.error.localizedDescription ?: @"";
+    }
+    return entry;
+}
+
+-(LBTransportRecord *)recordFromPropertyList:(NSDictionary *)entry{
+    LBTransportRecord *record = [LBTransportRecord recordWithStatusCode:[entry[@"status"] integerValue]
+                                                                headers:entry[@"headers"]
+                                                                   body:entry[@"body"]];
+    record.responseDelay = [entry[@"delay"] doubleValue];
+    record.duration = [entry[@"duration"] doubleValue];
+    record.chunks = [entry[@"chunks"] count] ? entry[@"chunks"] : nil;
+    if (entry[@"errorDomain"]) {
+        record.error = [NSError errorWithDomain:entry[@"errorDomain"]
+                                           code:[entry[@"errorCode"] integerValue]
+                                       userInfo:@{NSLocalizedDescriptionKey : entry[@"errorDescription"] ?: @""}];
+    }
+    return record;
+}
+@end
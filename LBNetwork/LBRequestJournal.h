@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBRequestJournal.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import "LBServerRequest.h"
+
+@class LBHTTPSClient;
+
+typedef void (^LBRequestJournalCredentialsHandler)(LBServerRequest *request);
+
+/**
+ * Durable outbox for mutating requests.
+ *
+ * Requests marked journaled (and not GET) are appended to an append-only file before
+ * they are sent and acknowledged once the server answers with anything but a 5xx or
+ * 429, or the request finally fails. A request that fails before reaching the server,
+ * offline or unable to connect, is parked instead of burning through its retries, and
+ * so is one answered with a 5xx or 429, replayed no sooner than its Retry-After. Parked entries replay one at a time in the order they were
+ * journaled, each sent once the previous one is answered, with exponential backoff
+ * until the network is back. Timeouts and dropped connections are not parked, the
+ * server may already have applied the write. Entries restored from a previous
+ * launch have no handlers of their own and report through replayResponseHandler.
+ *
+ * Records are written immediately but fsync'ed in batches of syncBatchSize or after
+ * syncInterval, so a crash inside that window can lose the newest entries. Acked
+ * records are dropped by rewriting the file once compactionThreshold acks pile up.
+ *
+ * The file is created 0600 with NSFileProtectionCompleteUntilFirstUserAuthentication.
+ * Credentials are never written to it: basicAuthHeaders and the Authorization,
+ * Proxy-Authorization and Cookie headers are dropped, and requests restored from a
+ * previous launch get them back from credentialsHandler before they are replayed.
+ */
+@interface LBRequestJournal : NSObject
+
+@property (nonatomic,copy,readonly)NSString *path;
+@property (nonatomic,weak)LBHTTPSClient *client;
+
+@property (nonatomic,assign)NSUInteger syncBatchSize;
+@property (nonatomic,assign)NSTimeInterval syncInterval;
+@property (nonatomic,assign)NSUInteger compactionThreshold;
+@property (nonatomic,assign)NSTimeInterval maxReplayBackoff;
+@property (nonatomic,strong)LBServerResponseHandler replayResponseHandler;
+@property (nonatomic,copy)LBRequestJournalCredentialsHandler credentialsHandler;
+
+@property (nonatomic,assign,readonly)NSUInteger pendingCount;
+
+-(instancetype)initWithPath:(NSString *)path;
+
+-(BOOL)shouldJournalRequest:(LBServerRequest *)request;
+-(void)appendRequest:(LBServerRequest *)request;
+-(void)acknowledgeRequest:(LBServerRequest *)request;
+/**
+ * Parks a journaled request that failed on a connectivity error and schedules a replay.
+ * Returns NO when the request is not journaled, no longer pending, or the error is not
+ * a connectivity one; the caller then handles the failure itself.
+ */
+-(BOOL)deferRequest:(LBServerRequest *)request error:(NSError *)error;
+/**
+ * Parks a journaled request the server answered with a 5xx or 429, NO otherwise
+ */
+-(BOOL)deferRequest:(LBServerRequest *)request response:(NSHTTPURLResponse *)response;
+
+-(void)replay;
+-(void)synchronize;
+-(void)compact;
+@end
@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBRequestJournal.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import "Logging.h"
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+#import <libkern/OSByteOrder.h>
+
+#define LBLogDebug(fmt, ...) if ([self.client shouldLog]) LogDebug(fmt,##__VA_ARGS__)
+
+#define kDefaultSyncBatchSize 8
+#define kDefaultSyncInterval 0.5
+#define kDefaultCompactionThreshold 64
+#define kDefaultMaxReplayBackoff 60
+#define kInitialReplayBackoff 1
+
+/**
+ * record := length:u32 | checksum:u32 | type:u8 | sequence:u64 | payload[length]
+ * integers are little endian, the checksum is FNV-1a over type, sequence and payload
+ */
+#define kRecordHeaderLength 17
+#define kRecordChecksumOffset 8
+
+typedef enum{
+    LBJournalRecordRequest = 1,
+    LBJournalRecordAck = 2,
+}LBJournalRecordType;
+
+static uint32_t LBJournalChecksum(const uint8_t *bytes, size_t length){
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++){
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+@interface LBJournalEntry : NSObject
+@property (nonatomic,assign)unsigned long long sequence;
+@property (nonatomic,strong)NSData *payload;
+@property (nonatomic,assign)BOOL inFlight;
+@end
+
+@implementation LBJournalEntry
+@end
+
+@interface LBRequestJournal ()
+@property (nonatomic,strong)dispatch_queue_t queue;
+@property (nonatomic,strong)NSMutableArray *entries;
+@property (nonatomic,strong)NSMutableDictionary *parkedRequests;
+/**
+ * Sequence of the one entry being replayed, 0 when none is
+ */
+@property (nonatomic,assign)unsigned long long replayingSequence;
+@property (nonatomic,assign)unsigned long long nextSequence;
+@property (nonatomic,assign)NSUInteger unsyncedRecords;
+@property (nonatomic,assign)BOOL syncScheduled;
+@property (nonatomic,assign)NSUInteger ackedRecords;
+@property (nonatomic,assign)NSTimeInterval replayBackoff;
+@property (nonatomic,assign)NSUInteger replayGeneration;
+@end
+
+@implementation LBRequestJournal {
+    int fileDescriptor;
+}
+
+-(instancetype)initWithPath:(NSString *)path{
+    self = [super init];
+    if(self){
+        _path = [path copy];
+        _syncBatchSize = kDefaultSyncBatchSize;
+        _syncInterval = kDefaultSyncInterval;
+        _compactionThreshold = kDefaultCompactionThreshold;
+        _maxReplayBackoff = kDefaultMaxReplayBackoff;
+        _replayBackoff = kInitialReplayBackoff;
+        _nextSequence = 1;
+        self.queue = dispatch_queue_create("LBRequestJournalQueue", DISPATCH_QUEUE_SERIAL);
+        self.entries = [[NSMutableArray alloc]init];
+        self.parkedRequests = [[NSMutableDictionary alloc]init];
+        [self load];
+        [[NSNotificationCenter defaultCenter]addObserver:self
+                                                selector:@selector(replay)
+                                                    name:UIApplicationDidBecomeActiveNotification
+                                                  object:nil];
+    }
+    return self;
+}
+
+-(void)dealloc{
+    [[NSNotificationCenter defaultCenter]removeObserver:self];
+    if(fileDescriptor >= 0){
+        fsync(fileDescriptor);
+        close(fileDescriptor);
+    }
+}
+
+-(NSUInteger)pendingCount{
+    __block NSUInteger count;
+    dispatch_sync(self.queue, ^{
+        count = self.entries.count;
+    });
+    return count;
+}
+
+#pragma mark - file
+
+-(void)load{
+    NSData *contents = [NSData dataWithContentsOfFile:self.path options:NSDataReadingMappedIfSafe error:nil];
+    const uint8_t *bytes = contents.bytes;
+    NSUInteger length = contents.length;
+    NSUInteger offset = 0;
+    NSMutableDictionary *live = [[NSMutableDictionary alloc]init];
+
+    while(offset + kRecordHeaderLength <= length){
+        uint32_t payloadLength = OSReadLittleInt32(bytes, offset);
+        uint32_t checksum = OSReadLittleInt32(bytes, offset + 4);
+        if(offset + kRecordHeaderLength + payloadLength > length){
+            break;
+        }
+        if(LBJournalChecksum(bytes + offset + kRecordChecksumOffset, kRecordHeaderLength - kRecordChecksumOffset + payloadLength) != checksum){
+            break;
+        }
+        uint8_t type = bytes[offset + 8];
+        unsigned long long sequence = OSReadLittleInt64(bytes, offset + 9);
+        if(type == LBJournalRecordRequest){
+            LBJournalEntry *entry = [[LBJournalEntry alloc]init];
+            entry.sequence = sequence;
+            entry.payload = [NSData dataWithBytes:bytes + offset + kRecordHeaderLength length:payloadLength];
+            live[@(sequence)] = entry;
+            [self.entries addObject:entry];
+        }
+        else if(type == LBJournalRecordAck){
+            [self.entries removeObject:live[@(sequence)] ?: [NSNull null]];
+            [live removeObjectForKey:@(sequence)];
+            self.ackedRecords++;
+        }
+        self.nextSequence = MAX(self.nextSequence, sequence + 1);
+        offset += kRecordHeaderLength + payloadLength;
+    }
+
+    fileDescriptor = open([self.path fileSystemRepresentation], O_RDWR | O_CREAT, 0600);
+    if(fileDescriptor < 0){
+        LBLogDebug(@"could not open request journal at %@", self.path);
+        return;
+    }
+    //journals written by older versions were world readable
+    fchmod(fileDescriptor, 0600);
+    [LBRequestJournal protectFileAtPath:self.path];
+    //drop a torn tail left behind by a crash mid-write
+    ftruncate(fileDescriptor, (off_t)offset);
+    lseek(fileDescriptor, 0, SEEK_END);
+    LBLogDebug(@"request journal loaded with %lu pending entries", (unsigned long)self.entries.count);
+}
+
+-(NSData *)recordOfType:(LBJournalRecordType)type sequence:(unsigned long long)sequence payload:(NSData *)payload{
+    NSMutableData *record = [NSMutableData dataWithLength:kRecordHeaderLength];
+    [record appendData:payload];
+    uint8_t *bytes = record.mutableBytes;
+    OSWriteLittleInt32(bytes, 0, (uint32_t)payload.length);
+    bytes[8] = type;
+    OSWriteLittleInt64(bytes, 9, sequence);
+    OSWriteLittleInt32(bytes, 4, LBJournalChecksum(bytes + kRecordChecksumOffset, record.length - kRecordChecksumOffset));
+    return record;
+}
+
+-(BOOL)writeRecord:(NSData *)record toFile:(int)fd{
+    const uint8_t *bytes = record.bytes;
+    NSUInteger written = 0;
+    while(written < record.length){
+        ssize_t result = write(fd, bytes + written, record.length - written);
+        if(result < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return NO;
+        }
+        written += result;
+    }
+    return YES;
+}
+
+-(void)appendRecord:(NSData *)record{
+    if(fileDescriptor < 0 || ![self writeRecord:record toFile:fileDescriptor]){
+        LBLogDebug(@"failed writing to request journal");
+        return;
+    }
+    self.unsyncedRecords++;
+    if(self.unsyncedRecords >= self.syncBatchSize){
+        [self syncFile];
+    }
+    else if(!self.syncScheduled){
+        self.syncScheduled = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.syncInterval * NSEC_PER_SEC)), self.queue, ^{
+            [self syncFile];
+        });
+    }
+}
+
+-(void)syncFile{
+    self.syncScheduled = NO;
+    if(self.unsyncedRecords && fileDescriptor >= 0){
+        fsync(fileDescriptor);
+    }
+    self.unsyncedRecords = 0;
+}
+
+-(void)synchronize{
+    dispatch_sync(self.queue, ^{
+        [self syncFile];
+    });
+}
+
+-(void)compact{
+    dispatch_async(self.queue, ^{
+        [self compactFile];
+    });
+}
+
+-(void)compactFile{
+    NSString *temporaryPath = [self.path stringByAppendingString:@".compact"];
+    int fd = open([temporaryPath fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0){
+        return;
+    }
+    [LBRequestJournal protectFileAtPath:temporaryPath];
+    for(LBJournalEntry *entry in self.entries){
+        if(![self writeRecord:[self recordOfType:LBJournalRecordRequest sequence:entry.sequence payload:entry.payload] toFile:fd]){
+            close(fd);
+            unlink([temporaryPath fileSystemRepresentation]);
+            return;
+        }
+    }
+    fsync(fd);
+    if(rename([temporaryPath fileSystemRepresentation], [self.path fileSystemRepresentation]) != 0){
+        close(fd);
+        unlink([temporaryPath fileSystemRepresentation]);
+        return;
+    }
+    close(fileDescriptor);
+    fileDescriptor = fd;
+    lseek(fileDescriptor, 0, SEEK_END);
+    self.unsyncedRecords = 0;
+    self.ackedRecords = 0;
+    LBLogDebug(@"compacted request journal to %lu entries", (unsigned long)self.entries.count);
+}
+
+/**
+ * Readable once the device has been unlocked after boot, so a replay can still run
+ * in the background while it is locked
+ */
++(void)protectFileAtPath:(NSString *)path{
+    [[NSFileManager defaultManager] setAttributes:@{NSFileProtectionKey : NSFileProtectionCompleteUntilFirstUserAuthentication}
+                                     ofItemAtPath:path
+                                            error:nil];
+}
+
+#pragma mark - requests
+
++(BOOL)isCredentialHeader:(NSString *)field{
+    return [field caseInsensitiveCompare:@"Authorization"] == NSOrderedSame
+            || [field caseInsensitiveCompare:@"Proxy-Authorization"] == NSOrderedSame
+            || [field caseInsensitiveCompare:@"Cookie"] == NSOrderedSame;
+}
+
+/**
+ * Credentials are left out, basicAuthHeaders entirely and credential headers from
+ * headers, restored requests get them back from credentialsHandler
+ */
++(NSDictionary *)dictionaryForRequest:(LBServerRequest *)request{
+    NSMutableDictionary *dictionary = [[NSMutableDictionary alloc]init];
+    dictionary[@"method"] = request.method ?: kMethodPOST;
+    dictionary[@"path"] = request.path ?: @"";
+    dictionary[@"timeout"] = @(request.requestTimeoutSeconds);
+    dictionary[@"autoRedirect"] = @(request.shouldAutoRedirect);
+    if(request.headers){
+        NSMutableDictionary *headers = [[NSMutableDictionary alloc]init];
+        [request.headers enumerateKeysAndObjectsUsingBlock:^(NSString *field, id value, BOOL *stop) {
+            if(![LBRequestJournal isCredentialHeader:field]){
+                headers[field] = value;
+            }
+        }];
+        dictionary[@"headers"] = headers;
+    }
+    if(request.params) dictionary[@"params"] = request.params;
+    if(request.requestBodyData) dictionary[@"body"] = request.requestBodyData;
+    if(request.dataContentType) dictionary[@"dataContentType"] = request.dataContentType;
+    if(request.responseClass) dictionary[@"responseClass"] = NSStringFromClass(request.responseClass);
+    return dictionary;
+}
+
+-(LBServerRequest *)requestForEntry:(LBJournalEntry *)entry{
+    NSDictionary *dictionary = [NSPropertyListSerialization propertyListWithData:entry.payload options:NSPropertyListImmutable format:NULL error:nil];
+    if(![dictionary isKindOfClass:[NSDictionary class]]){
+        return nil;
+    }
+    LBServerRequest *request = [LBServerRequest request];
+    request.method = dictionary[@"method"];
+    request.path = dictionary[@"path"];
+    request.requestTimeoutSeconds = [dictionary[@"timeout"] intValue];
+    request.shouldAutoRedirect = [dictionary[@"autoRedirect"] boolValue];
+    request.headers = dictionary[@"headers"];
+    request.params = dictionary[@"params"];
+    request.requestBodyData = dictionary[@"body"];
+    request.dataContentType = dictionary[@"dataContentType"];
+    if(dictionary[@"responseClass"]){
+        request.responseClass = NSClassFromString(dictionary[@"responseClass"]);
+    }
+    request.journaled = YES;
+    request.journalSequence = entry.sequence;
+    request.responseHandler = self.replayResponseHandler;
+    if(self.credentialsHandler){
+        self.credentialsHandler(request);
+    }
+    return request;
+}
+
+-(BOOL)shouldJournalRequest:(LBServerRequest *)request{
+    return request.journaled && request.journalSequence == 0 && ![request.method isEqualToString:kMethodGET];
+}
+
+-(void)appendRequest:(LBServerRequest *)request{
+    NSError *error = nil;
+    NSData *payload = [NSPropertyListSerialization dataWithPropertyList:[LBRequestJournal dictionaryForRequest:request]
+                                                                 format:NSPropertyListBinaryFormat_v1_0
+                                                                options:0
+                                                                  error:&error];
+    if(!payload){
+        LBLogDebug(@"request to %@ cannot be journaled:%@", request.path, error);
+        return;
+    }
+    dispatch_sync(self.queue, ^{
+        LBJournalEntry *entry = [[LBJournalEntry alloc]init];
+        entry.sequence = self.nextSequence++;
+        entry.payload = payload;
+        entry.inFlight = YES;
+        [self.entries addObject:entry];
+        [self appendRecord:[self recordOfType:LBJournalRecordRequest sequence:entry.sequence payload:payload]];
+        request.journalSequence = entry.sequence;
+    });
+}
+
+-(void)acknowledgeRequest:(LBServerRequest *)request{
+    unsigned long long sequence = request.journalSequence;
+    dispatch_async(self.queue, ^{
+        if(sequence){
+            [self acknowledgeSequence:sequence];
+        }
+        //any answer from the server means the network is back
+        if(self.parkedRequests.count && !self.replayingSequence){
+            [self replayNext];
+        }
+    });
+}
+
+-(LBJournalEntry *)entryForSequence:(unsigned long long)sequence{
+    for(LBJournalEntry *entry in self.entries){
+        if(entry.sequence == sequence){
+            return entry;
+        }
+    }
+    return nil;
+}
+
+-(void)acknowledgeSequence:(unsigned long long)sequence{
+    LBJournalEntry *entry = [self entryForSequence:sequence];
+    if(!entry){
+        return;
+    }
+    [self.entries removeObject:entry];
+    [self.parkedRequests removeObjectForKey:@(sequence)];
+    [self appendRecord:[self recordOfType:LBJournalRecordAck sequence:sequence payload:[NSData data]]];
+    self.ackedRecords++;
+
+    if(sequence == self.replayingSequence){
+        //the next entry only goes once the server has answered this one
+        self.replayingSequence = 0;
+        self.replayBackoff = kInitialReplayBackoff;
+        [self replayNext];
+    }
+    if(self.ackedRecords >= self.compactionThreshold){
+        [self compactFile];
+    }
+}
+
+-(BOOL)deferRequest:(LBServerRequest *)request error:(NSError *)error{
+    if(![LBRequestJournal isConnectivityError:error]){
+        return NO;
+    }
+    return [self parkRequest:request retryAfter:0];
+}
+
+-(BOOL)deferRequest:(LBServerRequest *)request response:(NSHTTPURLResponse *)response{
+    if(![LBRequestJournal isRetryableResponse:response]){
+        return NO;
+    }
+    return [self parkRequest:request retryAfter:MIN([LBRateLimiter retryAfterForResponse:response], self.maxReplayBackoff)];
+}
+
+/**
+ * The server could not take the write right now, the request never applied
+ */
++(BOOL)isRetryableResponse:(NSHTTPURLResponse *)response{
+    return response.statusCode >= kHTTPStatusCodeInternalServerError || response.statusCode == kHTTPStatusCodeTooManyRequests;
+}
+
+-(BOOL)parkRequest:(LBServerRequest *)request retryAfter:(NSTimeInterval)retryAfter{
+    if(!request.journalSequence){
+        return NO;
+    }
+    unsigned long long sequence = request.journalSequence;
+    __block BOOL parked = NO;
+    dispatch_sync(self.queue, ^{
+        LBJournalEntry *entry = [self entryForSequence:sequence];
+        if(!entry){
+            //already acknowledged or compacted away, the caller reports the failure
+            return;
+        }
+        parked = YES;
+        entry.inFlight = NO;
+        self.parkedRequests[@(sequence)] = request;
+        if(sequence == self.replayingSequence){
+            self.replayingSequence = 0;
+            [self scheduleReplayAfter:retryAfter];
+        }
+        else if(!self.replayingSequence){
+            [self scheduleReplayAfter:retryAfter];
+        }
+    });
+    if(parked){
+        LBLogDebug(@"parked journaled request %llu until it can be replayed", sequence);
+    }
+    return parked;
+}
+
+/**
+ * Errors raised before the request could reach the server. Timeouts and dropped
+ * connections are left to the retry policy, the server may have applied the write.
+ */
++(BOOL)isConnectivityError:(NSError *)error{
+    if(![error.domain isEqualToString:NSURLErrorDomain]){
+        return NO;
+    }
+    switch(error.code){
+        case NSURLErrorNotConnectedToInternet:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorInternationalRoamingOff:
+        case NSURLErrorDataNotAllowed:
+        case NSURLErrorCallIsActive:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+#pragma mark - replay
+
+-(void)replay{
+    dispatch_async(self.queue, ^{
+        if(!self.replayingSequence){
+            [self replayNext];
+        }
+    });
+}
+
+/**
+ * After the current backoff, or after minimumDelay when the server asked for longer
+ */
+-(void)scheduleReplayAfter:(NSTimeInterval)minimumDelay{
+    NSUInteger generation = ++self.replayGeneration;
+    NSTimeInterval delay = MAX(self.replayBackoff, minimumDelay);
+    self.replayBackoff = MIN(self.replayBackoff * 2, self.maxReplayBackoff);
+    LBLogDebug(@"replaying request journal in %.0fs", delay);
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), self.queue, ^{
+        if(generation == self.replayGeneration && !self.replayingSequence){
+            [self replayNext];
+        }
+    });
+}
+
+/**
+ * Sends the oldest entry not in flight, acknowledgeSequence: moves on to the next
+ */
+-(void)replayNext{
+    LBHTTPSClient *client = self.client;
+    if(!client){
+        return;
+    }
+    LBJournalEntry *next = nil;
+    LBServerRequest *request = nil;
+    NSMutableArray *unreadable = [[NSMutableArray alloc]init];
+    for(LBJournalEntry *entry in self.entries){
+        if(entry.inFlight){
+            continue;
+        }
+        request = self.parkedRequests[@(entry.sequence)] ?: [self requestForEntry:entry];
+        if(request){
+            next = entry;
+            break;
+        }
+        [unreadable addObject:@(entry.sequence)];
+    }
+    for(NSNumber *sequence in unreadable){
+        [self acknowledgeSequence:[sequence unsignedLongLongValue]];
+    }
+    if(!next){
+        return;
+    }
+    self.replayGeneration++;
+    next.inFlight = YES;
+    [self.parkedRequests removeObjectForKey:@(next.sequence)];
+    self.replayingSequence = next.sequence;
+    LBLogDebug(@"replaying journaled request %llu", next.sequence);
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [client sendRequest:request];
+    });
+}
+
+@end
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBRequestTemplate.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+@class LBServerRequest;
+
+/**
+ * Percent encodes a string per RFC 3986, everything but the unreserved set
+ * (ALPHA / DIGIT / "-" / "." / "_" / "~") is escaped from its UTF-8 bytes.
+ */
+FOUNDATION_EXPORT NSString *LBPercentEncodedString(NSString *string);
+
+/**
+ * Builds "key=value&key=value" from a parameter dictionary, keys sorted so equal
+ * parameters always produce the same URL. Values are encoded from their description.
+ */
+FOUNDATION_EXPORT NSString *LBQueryStringFromParameters(NSDictionary *parameters);
+
+/**
+ * Guesses the content type of a request body from its first and last non-whitespace
+ * bytes: a JSON object or array, otherwise form encoded. A body that is not valid
+ * UTF-8 gets ContentTypeAutomatic. The body is scanned, never decoded.
+ */
+FOUNDATION_EXPORT NSString *LBContentTypeForRequestBody(NSData *body);
+
+/**
+ * A request shape that is parsed and encoded once and stamped out many times.
+ *
+ * The path pattern may contain "{name}" placeholders, it is split into literal and
+ * placeholder segments when the template is created. Default headers, the content type
+ * and the Authorization value are merged into a single header dictionary whenever they
+ * change, so building a request is one pass over the segments and the query plus a
+ * single header assignment.
+ *
+ * Requests built from a template carry a prepared httpRequest which the client sends
+ * as is, setupRequest: is skipped for them.
+ */
+@interface LBRequestTemplate : NSObject
+
+@property (nonatomic,copy,readonly)NSString *method;
+@property (nonatomic,strong,readonly)NSURL *baseURL;
+@property (nonatomic,copy,readonly)NSString *pathPattern;
+@property (nonatomic,copy)NSDictionary *defaultHeaders;
+/**
+ * Content type sent with a body, nil to sniff it from the body bytes
+ */
+@property (nonatomic,copy)NSString *contentType;
+@property (nonatomic,assign)NSURLRequestCachePolicy cachePolicy;
+@property (nonatomic,assign)NSTimeInterval timeoutInterval;
+
++(instancetype)templateWithMethod:(NSString *)method baseURL:(NSURL *)baseURL pathPattern:(NSString *)pathPattern;
+-(instancetype)initWithMethod:(NSString *)method baseURL:(NSURL *)baseURL pathPattern:(NSString *)pathPattern;
+
+/**
+ * Encodes the basic Authorization header once for every request of this template
+ */
+-(void)authenticate:(NSString *)username password:(NSString *)password;
+
+/**
+ * Returns nil when a placeholder of the path pattern has no value in pathParameters
+ */
+-(NSMutableURLRequest *)URLRequestWithPathParameters:(NSDictionary *)pathParameters query:(NSDictionary *)query body:(NSData *)body;
+-(LBServerRequest *)requestWithPathParameters:(NSDictionary *)pathParameters query:(NSDictionary *)query body:(NSData *)body;
+@end
@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBRequestTemplate.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#define kDefaultTemplateTimeout 60
+
+static const char LBHexDigits[] = "0123456789ABCDEF";
+
+static inline BOOL LBIsUnreservedByte(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+           c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+static inline BOOL LBIsWhitespaceByte(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ * Same verdict as decoding the bytes into an NSString, without building one;
+ * overlong forms, surrogates and code points past U+10FFFF are rejected
+ */
+static BOOL LBIsValidUTF8(const uint8_t *bytes, NSUInteger length) {
+    NSUInteger i = 0;
+    while (i < length) {
+        uint8_t c = bytes[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        NSUInteger trailing;
+        uint8_t low = 0x80;
+        uint8_t high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            trailing = 1;
+        }
+        else if (c >= 0xE0 && c <= 0xEF) {
+            trailing = 2;
+            if (c == 0xE0) {
+                low = 0xA0;
+            }
+            else if (c == 0xED) {
+                high = 0x9F;
+            }
+        }
+        else if (c >= 0xF0 && c <= 0xF4) {
+            trailing = 3;
+            if (c == 0xF0) {
+                low = 0x90;
+            }
+            else if (c == 0xF4) {
+                high = 0x8F;
+            }
+        }
+        else {
+            return NO;
+        }
+        if (length - i <= trailing) {
+            return NO;
+        }
+        //only the first continuation byte is range limited
+        if (bytes[i + 1] < low || bytes[i + 1] > high) {
+            return NO;
+        }
+        for (NSUInteger j = 2; j <= trailing; j++) {
+            if ((bytes[i + j] & 0xC0) != 0x80) {
+                return NO;
+            }
+        }
+        i += trailing + 1;
+    }
+    return YES;
+}
+
+NSString *LBPercentEncodedString(NSString *string) {
+    if (string.length == 0) {
+        return @"";
+    }
+    const uint8_t *bytes = (const uint8_t *) [string UTF8String];
+    size_t length = strlen((const char *) bytes);
+    size_t escapes = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (!LBIsUnreservedByte(bytes[i])) {
+            escapes++;
+        }
+    }
+    if (escapes == 0) {
+        //nothing to escape, the common case for ids and plain words
+        return [string copy];
+    }
+
+    size_t encodedLength = length + escapes * 2;
+    char *encoded = malloc(encodedLength);
+    if (!encoded) {
+        return nil;
+    }
+    char *out = encoded;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = bytes[i];
+        if (LBIsUnreservedByte(c)) {
+            *out++ = (char) c;
+        }
+        else {
+            *out++ = '%';
+            *out++ = LBHexDigits[c >> 4];
+            *out++ = LBHexDigits[c & 0x0F];
+        }
+    }
+    return [[NSString alloc] initWithBytesNoCopy:encoded length:encodedLength encoding:NSASCIIStringEncoding freeWhenDone:YES];
+}
+
+NSString *LBQueryStringFromParameters(NSDictionary *parameters) {
+    if (parameters.count == 0) {
+        return @"";
+    }
+    NSArray *keys = [[parameters allKeys] sortedArrayUsingSelector:@selector(compare:)];
+    NSMutableString *query = [NSMutableString stringWithCapacity:keys.count * 16];
+    for (id key in keys) {
+        if (query.length) {
+            [query appendString:@"&"];
+        }
+        [query appendString:LBPercentEncodedString([key description])];
+        [query appendString:@"="];
+        [query appendString:LBPercentEncodedString([parameters[key] description])];
+    }
+    return query;
+}
+
+NSString *LBContentTypeForRequestBody(NSData *body) {
+    static NSString *automaticContentType;
+    static NSString *jsonContentType;
+    static NSString *formContentType;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSString *charset = (NSString *) CFStringConvertEncodingToIANACharSetName(CFStringConvertNSStringEncodingToEncoding(NSUTF8StringEncoding));
+        automaticContentType = [NSString stringWithFormat:@"%@; charset=%@", ContentTypeAutomatic, charset];
+        jsonContentType = [NSString stringWithFormat:@"%@; charset=%@", ContentTypeJSON, charset];
+        formContentType = [NSString stringWithFormat:@"%@; charset=%@", ContentTypeWWWEncoded, charset];
+    });
+
+    NSUInteger length = body.length;
+    if (length == 0) {
+        return automaticContentType;
+    }
+    const uint8_t *bytes = body.bytes;
+    //binary bodies are left for the server to sniff
+    if (!LBIsValidUTF8(bytes, length)) {
+        return automaticContentType;
+    }
+    NSUInteger first = 0;
+    NSUInteger last = length - 1;
+    while (first < last && LBIsWhitespaceByte(bytes[first])) {
+        first++;
+    }
+    while (last > first && LBIsWhitespaceByte(bytes[last])) {
+        last--;
+    }
+    //check for "eventual" JSON array or dictionary
+    if ((bytes[first] == '{' && bytes[last] == '}') || (bytes[first] == '[' && bytes[last] == ']')) {
+        return jsonContentType;
+    }
+    //fallback to www form encoded params
+    return formContentType;
+}
+
+@interface LBRequestTemplate ()
+@property (nonatomic,copy)NSString *authorization;
+@end
+
+@implementation LBRequestTemplate {
+    NSArray *literals;
+    NSArray *placeholders;
+    NSDictionary *preparedHeaders;
+    BOOL hasContentType;
+    NSUInteger estimatedLength;
+}
+
++(instancetype)templateWithMethod:(NSString *)method baseURL:(NSURL *)baseURL pathPattern:(NSString *)pathPattern{
+    return [[self alloc]initWithMethod:method baseURL:baseURL pathPattern:pathPattern];
+}
+
+-(instancetype)initWithMethod:(NSString *)method baseURL:(NSURL *)baseURL pathPattern:(NSString *)pathPattern{
+    self = [super init];
+    if (self) {
+        _method = [method copy] ?: kMethodGET;
+        _baseURL = baseURL;
+        _pathPattern = [pathPattern copy] ?: @"";
+        _cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+        _timeoutInterval = kDefaultTemplateTimeout;
+        [self compilePattern];
+        [self prepareHeaders];
+    }
+    return self;
+}
+
+-(void)compilePattern{
+    NSMutableString *prefix = [NSMutableString stringWithString:self.baseURL.absoluteString ?: @""];
+    NSString *pattern = self.pathPattern;
+    if (prefix.length && pattern.length) {
+        BOOL baseHasSlash = [prefix hasSuffix:@"/"];
+        BOOL patternHasSlash = [pattern hasPrefix:@"/"];
+        if (baseHasSlash && patternHasSlash) {
+            [prefix deleteCharactersInRange:NSMakeRange(prefix.length - 1, 1)];
+        }
+        else if (!baseHasSlash && !patternHasSlash) {
+            [prefix appendString:@"/"];
+        }
+    }
+
+    NSMutableArray *compiledLiterals = [NSMutableArray array];
+    NSMutableArray *compiledPlaceholders = [NSMutableArray array];
+    NSMutableString *literal = prefix;
+    NSUInteger location = 0;
+    while (location < pattern.length) {
+        NSRange open = [pattern rangeOfString:@"{" options:0 range:NSMakeRange(location, pattern.length - location)];
+        NSRange close = open.location == NSNotFound ? open :
+                [pattern rangeOfString:@"}" options:0 range:NSMakeRange(open.location, pattern.length - open.location)];
+        if (open.location == NSNotFound || close.location == NSNotFound) {
+            [literal appendString:[pattern substringFromIndex:location]];
+            break;
+        }
+        [literal appendString:[pattern substringWithRange:NSMakeRange(location, open.location - location)]];
+        [compiledLiterals addObject:[literal copy]];
+        [compiledPlaceholders addObject:[pattern substringWithRange:NSMakeRange(open.location + 1, close.location - open.location - 1)]];
+        literal = [NSMutableString string];
+        location = close.location + 1;
+    }
+    [compiledLiterals addObject:[literal copy]];
+
+    literals = [compiledLiterals copy];
+    placeholders = [compiledPlaceholders copy];
+    estimatedLength = prefix.length + pattern.length + 64;
+}
+
+-(void)prepareHeaders{
+    NSMutableDictionary *headers = [NSMutableDictionary dictionaryWithDictionary:self.defaultHeaders ?: @{}];
+    if (self.contentType) {
+        headers[@"Content-type"] = self.contentType;
+    }
+    if (self.authorization) {
+        headers[@"Authorization"] = self.authorization;
+    }
+    hasContentType = headers[@"Content-type"] != nil || headers[@"Content-Type"] != nil;
+    preparedHeaders = [headers copy];
+}
+
+-(void)setDefaultHeaders:(NSDictionary *)defaultHeaders{
+    _defaultHeaders = [defaultHeaders copy];
+    [self prepareHeaders];
+}
+
+-(void)setContentType:(NSString *)contentType{
+    _contentType = [contentType copy];
+    [self prepareHeaders];
+}
+
+-(void)authenticate:(NSString *)username password:(NSString *)password{
+    self.authorization = [LBServerRequest basicAuthorizationValueForUsername:username password:password];
+    [self prepareHeaders];
+}
+
+-(NSMutableURLRequest *)URLRequestWithPathParameters:(NSDictionary *)pathParameters query:(NSDictionary *)query body:(NSData *)body{
+    NSMutableString *URLString = [NSMutableString stringWithCapacity:estimatedLength];
+    [URLString appendString:literals[0]];
+    NSUInteger count = placeholders.count;
+    for (NSUInteger i = 0; i < count; i++) {
+        id value = pathParameters[placeholders[i]];
+        if (!value) {
+            return nil;
+        }
+        [URLString appendString:LBPercentEncodedString([value description])];
+        [URLString appendString:literals[i + 1]];
+    }
+    if (query.count) {
+        [URLString appendString:[URLString rangeOfString:@"?"].location == NSNotFound ? @"?" : @"&"];
+        [URLString appendString:LBQueryStringFromParameters(query)];
+    }
+
+    NSURL *URL = [NSURL URLWithString:URLString];
+    if (!URL) {
+        return nil;
+    }
+    NSMutableURLRequest *httpRequest = [[NSMutableURLRequest alloc] initWithURL:URL
+                                                                    cachePolicy:self.cachePolicy
+                                                                timeoutInterval:self.timeoutInterval];
+    [httpRequest setHTTPMethod:self.method];
+    [httpRequest setAllHTTPHeaderFields:preparedHeaders];
+    if (body.length && ![self.method isEqualToString:kMethodGET]) {
+        [httpRequest setHTTPBody:body];
+        [httpRequest setValue:[NSString stringWithFormat:@"%lu", (unsigned long) body.length] forHTTPHeaderField:@"Content-Length"];
+        if (!hasContentType) {
+            [httpRequest setValue:LBContentTypeForRequestBody(body) forHTTPHeaderField:@"Content-type"];
+        }
+    }
+    return httpRequest;
+}
+
+-(LBServerRequest *)requestWithPathParameters:(NSDictionary *)pathParameters query:(NSDictionary *)query body:(NSData *)body{
+    NSMutableURLRequest *httpRequest = [self URLRequestWithPathParameters:pathParameters query:query body:body];
+    if (!httpRequest) {
+        return nil;
+    }
+    LBServerRequest *request = [LBServerRequest request];
+    request.method = self.method;
+    request.path = httpRequest.URL.absoluteString;
+    request.headers = preparedHeaders;
+    request.requestBodyData = body;
+    request.requestTimeoutSeconds = (int) self.timeoutInterval;
+    request.httpRequest = httpRequest;
+    request.preparedHTTPRequest = YES;
+    return request;
+}
+@end
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBResponseCache.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * A stored response. The body is kept as given, callers hand in a copy they own.
+ */
+@interface LBCachedResponse : NSObject
+
+@property (nonatomic,assign,readonly)NSInteger statusCode;
+@property (nonatomic,copy,readonly)NSDictionary *headers;
+@property (nonatomic,strong,readonly)NSData *body;
+@property (nonatomic,strong,readonly)NSDate *date;
+
++(instancetype)cachedResponseWithResponse:(NSHTTPURLResponse *)response body:(NSData *)body;
+
+-(NSString *)entityTag;
+-(NSString *)lastModified;
+-(NSHTTPURLResponse *)responseForURL:(NSURL *)URL;
+@end
+
+/**
+ * Last good response per request, used by LBRequestCacheModeStaleWhileRevalidate.
+ *
+ * Responses are kept in memory up to memoryCapacity bytes of bodies, and when a
+ * directory is given also written to it so they survive relaunches. Disk writes
+ * happen on a private serial queue.
+ */
+@interface LBResponseCache : NSObject
+
+@property (nonatomic,copy,readonly)NSString *directory;
+@property (nonatomic,assign)NSUInteger memoryCapacity;
+
+/**
+ * directory nil keeps responses in memory only
+ */
+-(instancetype)initWithDirectory:(NSString *)directory;
+
+/**
+ * Method and URL, plus a hash of the Authorization and Cookie headers when present so
+ * one account never sees another's responses
+ */
++(NSString *)keyForRequest:(NSURLRequest *)request;
+/**
+ * Stored response for request whose Vary headers match it, nil otherwise. Responses
+ * with Vary: *, with no-store on the request or response, or private without
+ * credentials on the request are never stored, and replace what was stored before.
+ */
+-(LBCachedResponse *)cachedResponseForRequest:(NSURLRequest *)request;
+-(LBCachedResponse *)storeResponse:(NSHTTPURLResponse *)response data:(NSData *)data forRequest:(NSURLRequest *)request;
++(BOOL)isStorableResponse:(NSHTTPURLResponse *)response forRequest:(NSURLRequest *)request;
+/**
+ * Whether a Cache-Control value names any of directives, which are lowercase
+ */
++(BOOL)cacheControl:(NSString *)cacheControl containsDirectives:(NSArray<NSString *> *)directives;
+/**
+ * By key, without Vary matching
+ */
+-(LBCachedResponse *)cachedResponseForKey:(NSString *)key;
+-(LBCachedResponse *)storeResponse:(NSHTTPURLResponse *)response data:(NSData *)data forKey:(NSString *)key;
+-(void)removeResponseForKey:(NSString *)key;
+-(void)removeAllResponses;
+@end
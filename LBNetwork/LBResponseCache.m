@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBResponseCache.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import <CommonCrypto/CommonDigest.h>
+#define kDefaultMemoryCapacity (4 * 1024 * 1024)
+
+@interface LBCachedResponse ()
+@property (nonatomic,assign,readwrite)NSInteger statusCode;
+@property (nonatomic,copy,readwrite)NSDictionary *headers;
+@property (nonatomic,strong,readwrite)NSData *body;
+@property (nonatomic,strong,readwrite)NSDate *date;
+//request header values the response varies on, by lowercased name
+@property (nonatomic,copy)NSDictionary *varyValues;
+@end
+
+@implementation LBCachedResponse
+
++(instancetype)cachedResponseWithResponse:(NSHTTPURLResponse *)response body:(NSData *)body{
+    LBCachedResponse *cachedResponse = [[self alloc]init];
+    cachedResponse.statusCode = response.statusCode;
+    cachedResponse.headers = response.allHeaderFields;
+    cachedResponse.body = body ?: [NSData data];
+    cachedResponse.date = [NSDate date];
+    cachedResponse.varyValues = @{};
+    return cachedResponse;
+}
+
+-(NSString *)headerNamed:(NSString *)name{
+    NSString *value = self.headers[name];
+    if (value) {
+        return value;
+    }
+    //header names are case insensitive, allHeaderFields is not
+    for (NSString *key in self.headers) {
+        if ([key caseInsensitiveCompare:name] == NSOrderedSame) {
+            return self.headers[key];
+        }
+    }
+    return nil;
+}
+
+-(NSString *)entityTag{
+    return [self headerNamed:@"ETag"];
+}
+
+-(NSString *)lastModified{
+    return [self headerNamed:@"Last-Modified"];
+}
+
+/**
+ * Values of the request headers named by Vary, nil for Vary: * which no request matches
+ */
++(NSDictionary *)varyValuesForResponse:(NSHTTPURLResponse *)response request:(NSURLRequest *)request{
+    NSString *vary = nil;
+    for (NSString *field in response.allHeaderFields) {
+        if ([field caseInsensitiveCompare:@"Vary"] == NSOrderedSame) {
+            vary = response.allHeaderFields[field];
+            break;
+        }
+    }
+    NSMutableDictionary *values = [NSMutableDictionary dictionary];
+    for (NSString *component in [vary componentsSeparatedByString:@","]) {
+        NSString *name = [[component stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] lowercaseString];
+        if ([name isEqualToString:@"*"]) {
+            return nil;
+        }
+        if (name.length) {
+            values[name] = [request valueForHTTPHeaderField:name] ?: @"";
+        }
+    }
+    return values;
+}
+
+-(BOOL)matchesRequest:(NSURLRequest *)request{
+    if (!self.varyValues) {
+        return NO;
+    }
+    for (NSString *name in self.varyValues) {
+        if (![self.varyValues[name] isEqualToString:[request valueForHTTPHeaderField:name] ?: @""]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+-(NSHTTPURLResponse *)responseForURL:(NSURL *)URL{
+    return [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:self.statusCode HTTPVersion:@"HTTP/1.1" headerFields:self.headers];
+}
+
+-(NSDictionary *)propertyList{
+    NSMutableDictionary *propertyList = [@{@"status" : @(self.statusCode),
+                                           @"headers" : self.headers ?: @{},
+                                           @"body" : self.body ?: [NSData data],
+                                           @"date" : self.date ?: [NSDate date]} mutableCopy];
+    if (self.varyValues) {
+        propertyList[@"vary"] = self.varyValues;
+    }
+    return propertyList;
+}
+
++(instancetype)cachedResponseWithPropertyList:(NSDictionary *)propertyList{
+    if (![propertyList isKindOfClass:[NSDictionary class]] || ![propertyList[@"body"] isKindOfClass:[NSData class]]) {
+        return nil;
+    }
+    LBCachedResponse *cachedResponse = [[self alloc]init];
+    cachedResponse.statusCode = [propertyList[@"status"] integerValue];
+    cachedResponse.headers = propertyList[@"headers"];
+    cachedResponse.body = propertyList[@"body"];
+    cachedResponse.date = propertyList[@"date"];
+    cachedResponse.varyValues = [propertyList[@"vary"] isKindOfClass:[NSDictionary class]] ? propertyList[@"vary"] : nil;
+    return cachedResponse;
+}
+@end
+
+@interface LBResponseCache ()
+@property (nonatomic,strong)NSCache *memoryCache;
+@property (nonatomic,strong)dispatch_queue_t ioQueue;
+@end
+
+@implementation LBResponseCache
+
+-(instancetype)init{
+    return [self initWithDirectory:nil];
+}
+
+-(instancetype)initWithDirectory:(NSString *)directory{
+    self = [super init];
+    if (self) {
+        _directory = [directory copy];
+        self.memoryCache = [[NSCache alloc]init];
+        self.memoryCapacity = kDefaultMemoryCapacity;
+        self.ioQueue = dispatch_queue_create("LBResponseCache", DISPATCH_QUEUE_SERIAL);
+        if (directory) {
+            [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+        }
+    }
+    return self;
+}
+
+-(void)setMemoryCapacity:(NSUInteger)memoryCapacity{
+    _memoryCapacity = memoryCapacity;
+    self.memoryCache.totalCostLimit = memoryCapacity;
+}
+
++(NSString *)keyForRequest:(NSURLRequest *)request{
+    NSString *key = [NSString stringWithFormat:@"%@ %@", request.HTTPMethod ?: kMethodGET, request.URL.absoluteString];
+    NSString *authorization = [request valueForHTTPHeaderField:@"Authorization"];
+    NSString *cookie = [request valueForHTTPHeaderField:@"Cookie"];
+    if (!authorization && !cookie) {
+        return key;
+    }
+    //responses are per credential, hashed so no token ends up in a cache file name
+    NSString *credentials = [NSString stringWithFormat:@"%@\n%@", authorization ?: @"", cookie ?: @""];
+    return [NSString stringWithFormat:@"%@ %@", key, [self hexDigestOfString:credentials]];
+}
+
++(NSString *)hexDigestOfString:(NSString *)string{
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(data.bytes, (CC_LONG) data.length, digest);
+    NSMutableString *hex = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH * 2];
+    for (int i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
+        [hex appendFormat:@"%02x", digest[i]];
+    }
+    return hex;
+}
+
+-(NSString *)pathForKey:(NSString *)key{
+    if (!self.directory) {
+        return nil;
+    }
+    return [self.directory stringByAppendingPathComponent:[LBResponseCache hexDigestOfString:key]];
+}
+
+-(LBCachedResponse *)cachedResponseForRequest:(NSURLRequest *)request{
+    LBCachedResponse *cachedResponse = [self cachedResponseForKey:[LBResponseCache keyForRequest:request]];
+    return [cachedResponse matchesRequest:request] ? cachedResponse : nil;
+}
+
++(BOOL)cacheControl:(NSString *)cacheControl containsDirectives:(NSArray<NSString *> *)directives{
+    for (NSString *directive in [cacheControl.lowercaseString componentsSeparatedByString:@","]) {
+        NSString *name = [[directive componentsSeparatedByString:@"="].firstObject stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if ([directives containsObject:name]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
++(BOOL)isStorableResponse:(NSHTTPURLResponse *)response forRequest:(NSURLRequest *)request{
+    NSString *cacheControl = nil;
+    for (NSString *field in response.allHeaderFields) {
+        if ([field caseInsensitiveCompare:@"Cache-Control"] == NSOrderedSame) {
+            cacheControl = response.allHeaderFields[field];
+        }
+    }
+    if ([self cacheControl:cacheControl containsDirectives:@[@"no-store"]]
+            || [self cacheControl:[request valueForHTTPHeaderField:@"Cache-Control"] containsDirectives:@[@"no-store"]]) {
+        return NO;
+    }
+    //private is fine once the key is scoped to the credentials it was fetched with
+    BOOL credentialScoped = [request valueForHTTPHeaderField:@"Authorization"] || [request valueForHTTPHeaderField:@"Cookie"];
+    return credentialScoped || ![self cacheControl:cacheControl containsDirectives:@[@"private"]];
+}
+
+-(LBCachedResponse *)storeResponse:(NSHTTPURLResponse *)response data:(NSData *)data forRequest:(NSURLRequest *)request{
+    NSString *key = [LBResponseCache keyForRequest:request];
+    NSDictionary *varyValues = [LBCachedResponse varyValuesForResponse:response request:request];
+    if (!varyValues || ![LBResponseCache isStorableResponse:response forRequest:request]) {
+        //Vary: * cannot be matched and no-store must not be kept, do not leave an older response behind either
+        [self removeResponseForKey:key];
+        return nil;
+    }
+    return [self storeResponse:response data:data forKey:key varyValues:varyValues];
+}
+
+-(LBCachedResponse *)cachedResponseForKey:(NSString *)key{
+    if (!key) {
+        return nil;
+    }
+    LBCachedResponse *cachedResponse = [self.memoryCache objectForKey:key];
+    if (cachedResponse) {
+        return cachedResponse;
+    }
+    NSString *path = [self pathForKey:key];
+    if (!path) {
+        return nil;
+    }
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    if (!data) {
+        return nil;
+    }
+    id propertyList = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil];
+    cachedResponse = [LBCachedResponse cachedResponseWithPropertyList:propertyList];
+    if (cachedResponse) {
+        [self.memoryCache setObject:cachedResponse forKey:key cost:cachedResponse.body.length];
+    }
+    return cachedResponse;
+}
+
+-(LBCachedResponse *)storeResponse:(NSHTTPURLResponse *)response data:(NSData *)data forKey:(NSString *)key{
+    return [self storeResponse:response data:data forKey:key varyValues:@{}];
+}
+
+-(LBCachedResponse *)storeResponse:(NSHTTPURLResponse *)response data:(NSData *)data forKey:(NSString *)key varyValues:(NSDictionary *)varyValues{
+    if (!key || !response) {
+        return nil;
+    }
+    //response bodies live in pooled buffers, keep a copy of our own
+    LBCachedResponse *cachedResponse = [LBCachedResponse cachedResponseWithResponse:response body:[NSData dataWithData:data ?: [NSData data]]];
+    cachedResponse.varyValues = varyValues;
+    [self.memoryCache setObject:cachedResponse forKey:key cost:cachedResponse.body.length];
+
+    NSString *path = [self pathForKey:key];
+    if (path) {
+        dispatch_async(self.ioQueue, ^{
+            NSData *archive = [NSPropertyListSerialization dataWithPropertyList:[cachedResponse propertyList]
+                                                                         format:NSPropertyListBinaryFormat_v1_0
+                                                                        options:0
+                                                                          error:nil];
+            [archive writeToFile:path options:NSDataWritingAtomic error:nil];
+        });
+    }
+    return cachedResponse;
+}
+
+-(void)removeResponseForKey:(NSString *)key{
+    if (!key) {
+        return;
+    }
+    [self.memoryCache removeObjectForKey:key];
+    NSString *path = [self pathForKey:key];
+    if (path) {
+        dispatch_async(self.ioQueue, ^{
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        });
+    }
+}
+
+-(void)removeAllResponses{
+    [self.memoryCache removeAllObjects];
+    NSString *directory = self.directory;
+    if (directory) {
+        dispatch_async(self.ioQueue, ^{
+            NSFileManager *fileManager = [NSFileManager defaultManager];
+            for (NSString *name in [fileManager contentsOfDirectoryAtPath:directory error:nil]) {
+                [fileManager removeItemAtPath:[directory stringByAppendingPathComponent:name] error:nil];
+            }
+        });
+    }
+}
+@end
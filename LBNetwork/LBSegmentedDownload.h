@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBSegmentedDownload.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import "LBServerRequest.h"
+
+@class LBHTTPSClient;
+
+typedef void (^LBSegmentedDownloadProgressHandler)(long long receivedBytes, long long totalBytes);
+
+/**
+ * Downloads a single resource into a file over several concurrent connections.
+ *
+ * The resource is split into byte ranges of segmentSize bytes which are fetched with
+ * Range requests and written straight into a preallocated file at their offsets.
+ * The number of concurrent connections starts at initialSegments and is adapted
+ * between 1 and maxSegments according to the aggregate throughput observed.
+ * Servers that do not answer range requests with 206 are downloaded over the single
+ * probing connection.
+ * Segments are scheduled through the client like any other request, so they wait
+ * for its rate limiter and count against its per-host concurrency limit; a target
+ * above that limit only queues segments.
+ *
+ * On completion the request's successResponseHandler receives the file path, or its
+ * responseHandler receives an LBServerResponse whose output is the file path.
+ */
+@interface LBSegmentedDownload : NSObject <NSURLConnectionDataDelegate>
+
+@property (nonatomic,strong,readonly)LBServerRequest *request;
+@property (nonatomic,copy,readonly)NSString *filePath;
+
+@property (nonatomic,assign)NSUInteger initialSegments;
+@property (nonatomic,assign)NSUInteger maxSegments;
+@property (nonatomic,assign)long long segmentSize;
+@property (nonatomic,strong)LBSegmentedDownloadProgressHandler progressHandler;
+
+@property (nonatomic,assign,readonly)long long totalBytes;
+@property (nonatomic,assign,readonly)long long receivedBytes;
+@property (nonatomic,assign,readonly)NSUInteger activeSegments;
+
+-(instancetype)initWithRequest:(LBServerRequest *)request filePath:(NSString *)filePath client:(LBHTTPSClient *)client;
+-(void)start;
+-(void)cancel;
+@end
@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+//
+//  LBSegmentedDownload.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import "Logging.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+#define LBLogDebug(fmt, ...) if ([self.client shouldLog]) LogDebug(fmt,##__VA_ARGS__)
+
+#define kDefaultSegmentSize (2 * 1024 * 1024)
+#define kDefaultInitialSegments 2
+#define kDefaultMaxSegments 6
+#define kThroughputSampleInterval 0.5
+
+@interface LBDownloadSegment : NSObject
+@property (nonatomic,assign)long long offset;
+@property (nonatomic,assign)long long length;
+@property (nonatomic,assign)long long received;
+//received over the current connection, for the client's metrics
+@property (nonatomic,assign)NSUInteger connectionBytes;
+@property (nonatomic,assign)NSInteger retries;
+@end
+
+@implementation LBDownloadSegment
+@end
+
+@interface LBSegmentedDownload ()
+@property (nonatomic,strong)LBHTTPSClient *client;
+@property (nonatomic,strong)NSOperationQueue *queue;
+@property (nonatomic,strong)NSMutableArray *pendingSegments;
+@property (nonatomic,strong)NSMapTable *activeConnections;
+@property (nonatomic,strong)NSHTTPURLResponse *probeResponse;
+@property (nonatomic,assign)NSUInteger targetSegments;
+@property (nonatomic,assign)BOOL rangesSupported;
+@property (nonatomic,assign)BOOL finished;
+@property (nonatomic,assign)double lastThroughput;
+@property (nonatomic,assign)long long sampleBytes;
+@property (nonatomic,assign)CFAbsoluteTime sampleStart;
+@end
+
+@implementation LBSegmentedDownload {
+    int fileDescriptor;
+}
+
+-(instancetype)initWithRequest:(LBServerRequest *)request filePath:(NSString *)filePath client:(LBHTTPSClient *)client{
+    self = [super init];
+    if(self){
+        _request = request;
+        _filePath = [filePath copy];
+        _initialSegments = kDefaultInitialSegments;
+        _maxSegments = kDefaultMaxSegments;
+        _segmentSize = kDefaultSegmentSize;
+        _totalBytes = NSURLResponseUnknownLength;
+        fileDescriptor = -1;
+        self.client = client;
+        self.queue = [[NSOperationQueue alloc]init];
+        self.queue.maxConcurrentOperationCount = 1;
+        self.queue.name = @"LBSegmentedDownloadQueue";
+        self.pendingSegments = [[NSMutableArray alloc]init];
+        self.activeConnections = [NSMapTable strongToStrongObjectsMapTable];
+    }
+    return self;
+}
+
+-(void)dealloc{
+    [self closeFile];
+}
+
+-(NSUInteger)activeSegments{
+    return self.activeConnections.count;
+}
+
+#pragma mark - scheduling
+
+-(void)start{
+    [self.queue addOperationWithBlock:^{
+        self->fileDescriptor = open([self.filePath fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(self->fileDescriptor < 0){
+            [self failWithError:[NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil]];
+            return;
+        }
+        //the first segment doubles as a probe for range support and the total length
+        LBDownloadSegment *probe = [[LBDownloadSegment alloc]init];
+        probe.offset = 0;
+        probe.length = self.segmentSize;
+        self.targetSegments = 1;
+        [self startSegment:probe];
+    }];
+}
+
+-(void)cancel{
+    [self.queue addOperationWithBlock:^{
+        [self failWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+    }];
+}
+
+-(void)startSegment:(LBDownloadSegment *)segment{
+    LBServerRequest *segmentRequest = [self.request copy];
+    if(!self.probeResponse || self.rangesSupported){
+        long long first = segment.offset + segment.received;
+        long long last = segment.offset + segment.length - 1;
+        [segmentRequest.httpRequest setValue:[NSString stringWithFormat:@"bytes=%lld-%lld", first, last] forHTTPHeaderField:@"Range"];
+    }
+    //offsets are only meaningful on the identity encoding
+    [segmentRequest.httpRequest setValue:@"identity" forHTTPHeaderField:@"Accept-Encoding"];
+
+    LBURLConnection *con = [[LBURLConnection alloc]initWithRequest:segmentRequest delegate:self];
+    segment.connectionBytes = 0;
+    [self.activeConnections setObject:segment forKey:con];
+    //segments share the host's limiter slots and rate budget with every other request
+    [self.client scheduleConnection:con delegateQueue:self.queue];
+    LBLogDebug(@"started segment at offset:%lld length:%lld", segment.offset + segment.received, segment.length - segment.received);
+}
+
+-(void)startPendingSegments{
+    while(self.pendingSegments.count && self.activeConnections.count < self.targetSegments){
+        LBDownloadSegment *segment = self.pendingSegments.firstObject;
+        [self.pendingSegments removeObjectAtIndex:0];
+        [self startSegment:segment];
+    }
+}
+
+-(void)adaptSegmentCount{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    CFAbsoluteTime elapsed = now - self.sampleStart;
+    if(elapsed < kThroughputSampleInterval){
+        return;
+    }
+    double throughput = self.sampleBytes / elapsed;
+    NSUInteger previous = self.targetSegments;
+    if(self.lastThroughput <= 0 || throughput > self.lastThroughput * 1.1){
+        //more connections paid off, keep climbing
+        if(self.targetSegments < self.maxSegments){
+            self.targetSegments++;
+        }
+    }
+    else if(throughput < self.lastThroughput * 0.9 && self.targetSegments > 1){
+        self.targetSegments--;
+    }
+    if(previous != self.targetSegments){
+        LBLogDebug(@"throughput %.0f B/s, segments %lu -> %lu", throughput, (unsigned long)previous, (unsigned long)self.targetSegments);
+    }
+    self.lastThroughput = throughput;
+    self.sampleBytes = 0;
+    self.sampleStart = now;
+}
+
+-(void)handleProbeResponse:(NSHTTPURLResponse *)response segment:(LBDownloadSegment *)segment{
+    if(response.statusCode == kHTTPStatusCodePartialContent){
+        long long total = [self totalLengthFromContentRange:[[response allHeaderFields]objectForKey:@"Content-Range"]];
+        if(total >= 0){
+            self.rangesSupported = YES;
+            _totalBytes = total;
+            if(![self preallocate:total]){
+                [self failWithError:[NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil]];
+                return;
+            }
+            segment.length = MIN(segment.length, total);
+            for(long long offset = segment.length; offset < total; offset += self.segmentSize){
+                LBDownloadSegment *next = [[LBDownloadSegment alloc]init];
+                next.offset = offset;
+                next.length = MIN(self.segmentSize, total - offset);
+                [self.pendingSegments addObject:next];
+            }
+            self.targetSegments = MAX(1, MIN(self.initialSegments, self.maxSegments));
+            self.sampleStart = CFAbsoluteTimeGetCurrent();
+            LBLogDebug(@"segmented download of %lld bytes in %lu segments", total, (unsigned long)self.pendingSegments.count + 1);
+            [self startPendingSegments];
+            return;
+        }
+    }
+    else if(response.statusCode >= kHTTPStatusCodeOK && response.statusCode < kHTTPStatusCodeMultipleChoices){
+        //no range support, the probe carries the whole body
+        LBLogDebug(@"server ignored the range request, downloading over a single connection");
+        self.rangesSupported = NO;
+        segment.length = LLONG_MAX;
+        _totalBytes = response.expectedContentLength;
+        if(_totalBytes > 0){
+            [self preallocate:_totalBytes];
+        }
+        return;
+    }
+    [self failWithError:[self errorForResponse:response]];
+}
+
+-(long long)totalLengthFromContentRange:(NSString *)contentRange{
+    NSRange slash = [contentRange rangeOfString:@"/"];
+    if(slash.location == NSNotFound){
+        return -1;
+    }
+    NSString *total = [contentRange substringFromIndex:slash.location + 1];
+    if([total isEqualToString:@"*"]){
+        return -1;
+    }
+    return [total longLongValue];
+}
+
+-(NSError *)errorForResponse:(NSHTTPURLResponse *)response{
+    NSString *description = [NSString stringWithFormat:@"Unexpected status code %ld for segmented download", (long)response.statusCode];
+    return [NSError errorWithDomain:LBNetworkErrorDomain
+                               code:LBNetworkErrorUnexpectedStatusCode
+                           userInfo:@{NSLocalizedDescriptionKey:description}];
+}
+
+#pragma mark - file
+
+-(BOOL)preallocate:(long long)length{
+#ifdef F_PREALLOCATE
+    fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)length, 0};
+    if(fcntl(fileDescriptor, F_PREALLOCATE, &store) == -1){
+        store.fst_flags = F_ALLOCATEALL;
+        fcntl(fileDescriptor, F_PREALLOCATE, &store);
+    }
+#endif
+    return ftruncate(fileDescriptor, (off_t)length) == 0;
+}
+
+-(BOOL)writeBytes:(const char *)bytes length:(NSUInteger)length atOffset:(long long)offset{
+    NSUInteger written = 0;
+    while(written < length){
+        ssize_t result = pwrite(fileDescriptor, bytes + written, length - written, (off_t)(offset + written));
+        if(result < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return NO;
+        }
+        written += result;
+    }
+    return YES;
+}
+
+-(void)closeFile{
+    if(fileDescriptor >= 0){
+        close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+}
+
+#pragma mark - completion
+
+-(void)complete{
+    self.finished = YES;
+    if(!self.rangesSupported){
+        ftruncate(fileDescriptor, (off_t)_receivedBytes);
+        _totalBytes = _receivedBytes;
+    }
+    [self closeFile];
+    LBLogDebug(@"segmented download finished, %lld bytes", _receivedBytes);
+
+    LBServerResponse *response = [LBServerResponse handleServerResponse:self.probeResponse request:self.request data:nil deserializer:nil error:nil];
+    response.output = self.filePath;
+    if(self.request.responseHandler){
+        self.request.responseHandler(response);
+    }
+    else if(self.request.successResponseHandler){
+        self.request.successResponseHandler(self.filePath);
+    }
+    [self.request cleanUp];
+}
+
+-(void)failWithError:(NSError *)error{
+    if(self.finished){
+        return;
+    }
+    self.finished = YES;
+    LBLogDebug(@"segmented download failed:%@", error);
+    for(LBURLConnection *con in [[self.activeConnections keyEnumerator]allObjects]){
+        [self.client cancelConnection:con];
+    }
+    [self.activeConnections removeAllObjects];
+    [self.pendingSegments removeAllObjects];
+    [self closeFile];
+    unlink([self.filePath fileSystemRepresentation]);
+
+    LBServerResponse *response = [LBServerResponse handleServerResponse:self.probeResponse request:self.request data:nil deserializer:nil error:error];
+    if(self.request.failResponseHandler){
+        self.request.failResponseHandler(error);
+    }
+    else if(self.request.responseHandler){
+        self.request.responseHandler(response);
+    }
+    [self.request cleanUp];
+}
+
+-(void)retrySegment:(LBDownloadSegment *)segment error:(NSError *)error{
+    BOOL shouldRetry = NO;
+    id<LBConnectionErrorHandler> errorHandler = self.client.connectionProperties.errorHandler;
+    if([errorHandler respondsToSelector:@selector(shouldRetryRequest:forCurrentTry:)]){
+        shouldRetry = [errorHandler shouldRetryRequest:error forCurrentTry:segment.retries + 1];
+    }
+    if(!shouldRetry){
+        [self failWithError:error];
+        return;
+    }
+    segment.retries++;
+    if(self.probeResponse && !self.rangesSupported){
+        //cannot resume without ranges, start over
+        _receivedBytes -= segment.received;
+        segment.received = 0;
+    }
+    [self startSegment:segment];
+}
+
+#pragma mark - NSURLConnectionDataDelegate
+
+-(void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response{
+    LBURLConnection *con = (LBURLConnection *)connection;
+    NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
+    LBDownloadSegment *segment = [self.activeConnections objectForKey:con];
+    if(!segment || self.finished){
+        return;
+    }
+    con.rawResponse = httpResponse;
+    con.responseTime = CFAbsoluteTimeGetCurrent();
+    if(!self.probeResponse){
+        self.probeResponse = httpResponse;
+        [self handleProbeResponse:httpResponse segment:segment];
+        return;
+    }
+    BOOL expected = self.rangesSupported
+            ? httpResponse.statusCode == kHTTPStatusCodePartialContent
+            : httpResponse.statusCode >= kHTTPStatusCodeOK && httpResponse.statusCode < kHTTPStatusCodeMultipleChoices;
+    if(!expected){
+        [self failWithError:[self errorForResponse:httpResponse]];
+    }
+}
+
+-(void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data{
+    LBDownloadSegment *segment = [self.activeConnections objectForKey:connection];
+    if(!segment || self.finished){
+        return;
+    }
+    NSUInteger length = data.length;
+    long long remaining = segment.length - segment.received;
+    if((long long)length > remaining){
+        length = (NSUInteger)remaining;
+    }
+    if(![self writeBytes:data.bytes length:length atOffset:segment.offset + segment.received]){
+        [self failWithError:[NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil]];
+        return;
+    }
+    segment.received += length;
+    segment.connectionBytes += length;
+    _receivedBytes += length;
+    self.sampleBytes += length;
+    if(self.progressHandler){
+        self.progressHandler(_receivedBytes, _totalBytes);
+    }
+}
+
+-(void)connectionDidFinishLoading:(NSURLConnection *)connection{
+    LBDownloadSegment *segment = [self.activeConnections objectForKey:connection];
+    [self.activeConnections removeObjectForKey:connection];
+    if(!segment || self.finished){
+        return;
+    }
+    BOOL truncated = self.rangesSupported && segment.received < segment.length;
+    [self.client finishConnection:(LBURLConnection *)connection bytes:segment.connectionBytes failed:truncated];
+    if(truncated){
+        //the server closed the range early, fetch the rest of it
+        [self retrySegment:segment error:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil]];
+        return;
+    }
+    if(!self.rangesSupported || (self.pendingSegments.count == 0 && self.activeConnections.count == 0)){
+        [self complete];
+        return;
+    }
+    [self adaptSegmentCount];
+    [self startPendingSegments];
+}
+
+-(void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error{
+    LBDownloadSegment *segment = [self.activeConnections objectForKey:connection];
+    [self.activeConnections removeObjectForKey:connection];
+    if(!segment || self.finished){
+        return;
+    }
+    [self.client finishConnection:(LBURLConnection *)connection bytes:segment.connectionBytes failed:YES];
+    LBLogDebug(@"segment at offset:%lld failed:%@", segment.offset, error);
+    [self retrySegment:segment error:error];
+}
+
+-(NSCachedURLResponse *)connection:(NSURLConnection *)connection willCacheResponse:(NSCachedURLResponse *)cachedResponse{
+    return nil;
+}
+
+-(BOOL)connection:(NSURLConnection *)connection canAuthenticateAgainstProtectionSpace:(NSURLProtectionSpace *)protectionSpace{
+    return [self.client connection:connection canAuthenticateAgainstProtectionSpace:protectionSpace];
+}
+
+-(void)connection:(NSURLConnection *)connection didReceiveAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge{
+    [self.client connection:connection didReceiveAuthenticationChallenge:challenge];
+}
+
+@end
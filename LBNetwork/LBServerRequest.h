@@ -25,10 +25,25 @@
 #import <Foundation/Foundation.h>
 @class UIImage;
 @class LBServerResponse;
+@class LBCachedResponse;
+@class LBRecordFramer;
+#import "LBDigest.h"
+#import "LBTracer.h"
+
+typedef enum{
+    LBRequestCacheModeNone,
+    /**
+     * sendRequest: first calls the handlers with the cached response flagged stale,
+     * then revalidates and calls them again only if the content changed
+     */
+    LBRequestCacheModeStaleWhileRevalidate,
+}LBRequestCacheMode;
+
 @interface LBServerRequest : NSObject <NSCopying>
 typedef void (^LBServerResponseHandler)(LBServerResponse *response);
 typedef void (^LBServerSuccessResponseHandler)(id output);
 typedef void (^LBServerFailResponseHandler)(NSError *error);
+typedef void (^LBServerRecordHandler)(id record);
 
 @property (nonatomic,strong)NSDictionary *headers;
 @property (nonatomic,strong)NSDictionary *basicAuthHeaders;
@@ -45,13 +60,80 @@ typedef void (^LBServerFailResponseHandler)(NSError *error);
 @property (nonatomic,strong)NSMutableURLRequest *httpRequest;
 @property (nonatomic,assign)int requestTimeoutSeconds;
 @property (nonatomic,assign)BOOL shouldAutoRedirect;
+/**
+ * Opt-in to the client's requestJournal, only honoured for non-GET requests
+ */
+@property (nonatomic,assign)BOOL journaled;
+@property (nonatomic,assign)unsigned long long journalSequence;
+/**
+ * Set by LBRequestTemplate, the client sends httpRequest as is instead of rebuilding it
+ */
+@property (nonatomic,assign)BOOL preparedHTTPRequest;
+@property (nonatomic,assign)LBRequestCacheMode cacheMode;
+/**
+ * The response delivered stale while this request revalidates, set by the client
+ */
+@property (nonatomic,strong)LBCachedResponse *cachedResponse;
+/**
+ * Streams a successful response through the framer, recordHandler runs for every
+ * completed record and the response handlers once the stream ends, without a body.
+ * A stream failing after it delivered records is not retried or failed over, the
+ * failure goes straight to the fail handlers, so each record is delivered at most once.
+ */
+@property (nonatomic,strong)LBRecordFramer *recordFramer;
+@property (nonatomic,strong)LBServerRecordHandler recordHandler;
+/**
+ * Longest side, in pixels, LBImageDeserializer decodes an image response to, 0 for its default
+ */
+@property (nonatomic,assign)NSUInteger imageMaxPixelSize;
+/**
+ * Digested as the body arrives, a successful response whose digest differs from
+ * expectedDigest fails with LBNetworkErrorDigestMismatch. Without an expectedDigest
+ * the digest is only reported on the response.
+ */
+@property (nonatomic,assign)LBDigestAlgorithm digestAlgorithm;
+@property (nonatomic,strong)NSData *expectedDigest;
+/**
+ * Name of an LBEndpointGroup added to the client, path is then relative to the
+ * replica the client picks. Ignored for requests prepared by an LBRequestTemplate.
+ */
+@property (nonatomic,copy)NSString *endpointGroup;
+/**
+ * Base path is relative to, set by the caller it pins the request there and the
+ * endpointGroup is not consulted
+ */
+@property (nonatomic,strong)NSURL *baseURL;
+/**
+ * The replica the client picked for the current send and the ones it already failed
+ * over from, picked again every time the request is sent
+ */
+@property (nonatomic,strong)NSURL *endpointBaseURL;
+@property (nonatomic,copy)NSArray<NSURL *> *triedBaseURLs;
+/**
+ * Row of the request in the client's tracer, assigned by sendRequest: and kept across retries
+ */
+@property (nonatomic,assign)LBTraceID traceID;
+/**
+ * Never raises the error alert, for requests the client sends on its own behalf
+ */
+@property (nonatomic,assign)BOOL silent;
+/**
+ * Neither answered from nor stored in the client's imageCache
+ */
+@property (nonatomic,assign)BOOL ignoresImageCache;
 
 +(instancetype)request;
 +(instancetype)getRequest;
 +(instancetype)postRequest;
 +(instancetype)uploadRequest:(NSData *)data;
+/**
+ * Encodes at full quality on the calling thread, LBHTTPSClient's
+ * asyncUploadImage:request:fileName:encoder: downsamples and encodes in the background
+ */
 +(instancetype)imageUploadRequest:(UIImage *)image;
 -(NSURL *)requestURL;
+-(NSString *)requestURLString;
 -(void)cleanUp;
 -(void)authenticate:(NSString *)username password:(NSString *)password;
++(NSString *)basicAuthorizationValueForUsername:(NSString *)username password:(NSString *)password;
 @end
@@ -67,7 +67,25 @@
     return [self uploadRequest:imageData];
 }
 -(NSURL *)requestURL{
-    return [NSURL URLWithString:[NSString stringWithFormat:@"%@",self.path]];
+    return [NSURL URLWithString:[self requestURLString]];
+}
+
+-(NSString *)requestURLString{
+    NSString *path = [NSString stringWithFormat:@"%@",self.path];
+    NSURL *baseURL = self.endpointBaseURL ?: self.baseURL;
+    if(!baseURL){
+        return path;
+    }
+    NSString *base = baseURL.absoluteString;
+    BOOL baseSlash = [base hasSuffix:@"/"];
+    BOOL pathSlash = [path hasPrefix:@"/"];
+    if(baseSlash && pathSlash){
+        return [base stringByAppendingString:[path substringFromIndex:1]];
+    }
+    if(!baseSlash && !pathSlash && path.length){
+        return [NSString stringWithFormat:@"%@/%@",base,path];
+    }
+    return [base stringByAppendingString:path];
 }
 
 -(NSData *)requestBodyData{
@@ -85,12 +103,33 @@
     copy.failResponseHandler = [self.failResponseHandler copy];
     copy.responseHandler = [self.responseHandler copy];
     copy.headers = [self.headers copy];
+    copy.basicAuthHeaders = [self.basicAuthHeaders copy];
+    copy.params = [self.params copy];
+    copy.dataContentType = [self.dataContentType copy];
+    copy.requestTimeoutSeconds = self.requestTimeoutSeconds;
     copy.method = self.method.copy;
     copy.requestBodyString = [self.requestBodyString copy];
     copy.requestBodyData = [self.requestBodyData copy];
     copy.httpRequest = [self.httpRequest mutableCopy];
     copy.responseClass = self.responseClass;
     copy.shouldAutoRedirect = self.shouldAutoRedirect;
+    copy.journaled = self.journaled;
+    copy.journalSequence = self.journalSequence;
+    copy.preparedHTTPRequest = self.preparedHTTPRequest;
+    copy.cacheMode = self.cacheMode;
+    copy.cachedResponse = self.cachedResponse;
+    copy.recordFramer = self.recordFramer;
+    copy.recordHandler = [self.recordHandler copy];
+    copy.imageMaxPixelSize = self.imageMaxPixelSize;
+    copy.digestAlgorithm = self.digestAlgorithm;
+    copy.expectedDigest = self.expectedDigest;
+    copy.endpointGroup = self.endpointGroup;
+    copy.baseURL = self.baseURL;
+    copy.endpointBaseURL = self.endpointBaseURL;
+    copy.triedBaseURLs = self.triedBaseURLs;
+    copy.traceID = self.traceID;
+    copy.silent = self.silent;
+    copy.ignoresImageCache = self.ignoresImageCache;
     return copy;
 }
 
@@ -105,12 +144,17 @@
     self.successResponseHandler = nil;
     self.failResponseHandler = nil;
     self.responseHandler = nil;
+    self.recordHandler = nil;
 }
 
 -(void)authenticate:(NSString *)username password:(NSString *)password{
+    self.basicAuthHeaders = @{@"Authorization":[[self class] basicAuthorizationValueForUsername:username password:password]};
+}
+
++(NSString *)basicAuthorizationValueForUsername:(NSString *)username password:(NSString *)password{
     NSString *authStr = [NSString stringWithFormat:@"%@:%@", username, password];
-    NSData *authData = [authStr dataUsingEncoding:NSASCIIStringEncoding];
-    NSString *authValue = [NSString stringWithFormat:@"Basic %@", [authData  base64EncodedStringWithOptions:NSDataBase64Encoding76CharacterLineLength]];
-    self.basicAuthHeaders = @{@"Authorization":authValue};
+    NSData *authData = [authStr dataUsingEncoding:NSUTF8StringEncoding];
+    //no line breaks, a wrapped value is not a valid header
+    return [NSString stringWithFormat:@"Basic %@", [authData base64EncodedStringWithOptions:0]];
 }
 @end
@@ -35,6 +35,20 @@
 @property (nonatomic,strong)NSString *rawResponseString;
 @property (nonatomic,strong)NSURL *requestURL;
 @property (nonatomic,assign)NSInteger currentRequestTryCount;
+@property (nonatomic,assign)NSTimeInterval duration;
+/**
+ * Delivered from the response cache while the request revalidates
+ */
+@property (nonatomic,assign,getter=isStale)BOOL stale;
+/**
+ * Digest of the body with the request's digestAlgorithm, nil when it has none
+ */
+@property (nonatomic,strong)NSData *digest;
+/**
+ * An upload skipped because the server already had the payload. Status, headers and
+ * output are those of the lookup, not of an upload, see LBUploadDeduplicator
+ */
+@property (nonatomic,assign,getter=isDeduplicated)BOOL deduplicated;
 @property (nonatomic,strong)LBServerRequest *request;
 
 + (instancetype)handleServerResponse:(NSHTTPURLResponse *)rawResponse
@@ -36,9 +36,14 @@
     [res setHeaders:[response allHeaderFields]];
     [res setStatusCode:[response statusCode]];
     [res setResponseData:data];
+    //data may be a pooled buffer the client recycles, everything past here sees our copy
+    data = res.rawResponseData;
     [res setError:error];
     [res setRequest:request];
-    if (deserializer) {
+    if ([deserializer respondsToSelector:@selector(deserialize:forRequest:response:)]) {
+        res.output = [deserializer deserialize:data forRequest:request response:rawResponse];
+    }
+    else if (deserializer) {
         res.output = [deserializer deserialize:data toClass:[request responseClass]];
     }
     return res;
@@ -58,7 +63,7 @@
         }
     }
 
-    _rawResponseData = data;
+    _rawResponseData = [data copy];
     if (charset && [charset isEqualToString:@"EUC-JP"]) {
         _rawResponseString = [[NSString alloc] initWithData:_rawResponseData encoding:NSJapaneseEUCStringEncoding];
     }
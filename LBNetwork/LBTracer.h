@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBTracer.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+
+typedef uint64_t LBTraceID;
+
+/**
+ * Fixed size ring buffer of request lifecycle spans, the oldest are overwritten once
+ * it is full. Recording copies a few words under a lock and allocates nothing, span
+ * names must be string literals.
+ *
+ * chromeTraceData renders the buffer in the Chrome trace event format, every request
+ * on its own row, for chrome://tracing or ui.perfetto.dev.
+ */
+@interface LBTracer : NSObject
+
+@property (nonatomic,assign,readonly)NSUInteger capacity;
+
+-(instancetype)initWithCapacity:(NSUInteger)capacity;
+
+-(LBTraceID)newTraceID;
+-(CFAbsoluteTime)timestamp;
+-(void)recordSpan:(const char *)name trace:(LBTraceID)trace start:(CFAbsoluteTime)start end:(CFAbsoluteTime)end detail:(NSString *)detail;
+-(void)recordSpan:(const char *)name trace:(LBTraceID)trace start:(CFAbsoluteTime)start;
+-(void)recordInstant:(const char *)name trace:(LBTraceID)trace detail:(NSString *)detail;
+
+-(NSUInteger)count;
+-(void)reset;
+-(NSData *)chromeTraceData;
+-(BOOL)writeChromeTraceToFile:(NSString *)path error:(NSError **)error;
+@end
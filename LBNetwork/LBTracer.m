@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBTracer.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+#import <pthread.h>
+#import <stdatomic.h>
+
+#define kDefaultTraceCapacity 4096
+
+typedef struct {
+    const char *name;
+    LBTraceID trace;
+    CFAbsoluteTime start;
+    CFAbsoluteTime end;
+    BOOL instant;
+} LBTraceSpan;
+
+@implementation LBTracer {
+    LBTraceSpan *spans;
+    //details are kept apart, ARC objects can't live in C structs
+    CFTypeRef *details;
+    NSUInteger next;
+    NSUInteger count;
+    CFAbsoluteTime origin;
+    atomic_ullong traceIDs;
+    pthread_mutex_t lock;
+}
+
+-(instancetype)init{
+    return [self initWithCapacity:kDefaultTraceCapacity];
+}
+
+-(instancetype)initWithCapacity:(NSUInteger)capacity{
+    self = [super init];
+    if(self){
+        _capacity = MAX(1u, capacity);
+        spans = calloc(_capacity, sizeof(LBTraceSpan));
+        details = calloc(_capacity, sizeof(CFTypeRef));
+        origin = CFAbsoluteTimeGetCurrent();
+        atomic_init(&traceIDs, 0);
+        pthread_mutex_init(&lock, NULL);
+    }
+    return self;
+}
+
+-(void)dealloc{
+    [self clearDetails];
+    free(spans);
+    free(details);
+    pthread_mutex_destroy(&lock);
+}
+
+-(void)clearDetails{
+    for(NSUInteger i = 0; i < _capacity; i++){
+        if(details[i]){
+            CFRelease(details[i]);
+            details[i] = NULL;
+        }
+    }
+}
+
+-(LBTraceID)newTraceID{
+    return atomic_fetch_add(&traceIDs, 1) + 1;
+}
+
+-(CFAbsoluteTime)timestamp{
+    return CFAbsoluteTimeGetCurrent();
+}
+
+-(void)recordSpan:(const char *)name trace:(LBTraceID)trace start:(CFAbsoluteTime)start end:(CFAbsoluteTime)end detail:(NSString *)detail{
+    [self record:name trace:trace start:start end:end instant:NO detail:detail];
+}
+
+-(void)recordSpan:(const char *)name trace:(LBTraceID)trace start:(CFAbsoluteTime)start{
+    [self record:name trace:trace start:start end:CFAbsoluteTimeGetCurrent() instant:NO detail:nil];
+}
+
+-(void)recordInstant:(const char *)name trace:(LBTraceID)trace detail:(NSString *)detail{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    [self record:name trace:trace start:now end:now instant:YES detail:detail];
+}
+
+-(void)record:(const char *)name trace:(LBTraceID)trace start:(CFAbsoluteTime)start end:(CFAbsoluteTime)end instant:(BOOL)instant detail:(NSString *)detail{
+    if(start <= 0){
+        //the stage never started, e.g. no first byte before a failure
+        return;
+    }
+    CFTypeRef retained = detail ? CFBridgingRetain([detail copy]) : NULL;
+    CFTypeRef overwritten;
+    pthread_mutex_lock(&lock);
+    NSUInteger index = next;
+    spans[index] = (LBTraceSpan){name, trace, start, MAX(start, end), instant};
+    overwritten = details[index];
+    details[index] = retained;
+    next = (index + 1) % _capacity;
+    count = MIN(count + 1, _capacity);
+    pthread_mutex_unlock(&lock);
+    if(overwritten){
+        CFRelease(overwritten);
+    }
+}
+
+-(NSUInteger)count{
+    pthread_mutex_lock(&lock);
+    NSUInteger spanCount = count;
+    pthread_mutex_unlock(&lock);
+    return spanCount;
+}
+
+-(void)reset{
+    pthread_mutex_lock(&lock);
+    [self clearDetails];
+    next = 0;
+    count = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+-(NSData *)chromeTraceData{
+    NSMutableArray *events;
+    pthread_mutex_lock(&lock);
+    events = [[NSMutableArray alloc]initWithCapacity:count];
+    NSUInteger first = (next + _capacity - count) % _capacity;
+    for(NSUInteger i = 0; i < count; i++){
+        NSUInteger index = (first + i) % _capacity;
+        LBTraceSpan span = spans[index];
+        NSMutableDictionary *event = [@{@"name" : @(span.name),
+                @"cat" : @"LBNetwork",
+                @"ph" : span.instant ? @"i" : @"X",
+                @"ts" : @((span.start - origin) * 1000000.0),
+                @"pid" : @1,
+                @"tid" : @(span.trace)} mutableCopy];
+        if(span.instant){
+            event[@"s"] = @"t";
+        }
+        else{
+            event[@"dur"] = @((span.end - span.start) * 1000000.0);
+        }
+        if(details[index]){
+            event[@"args"] = @{@"detail" : (__bridge NSString *) details[index]};
+        }
+        [events addObject:event];
+    }
+    pthread_mutex_unlock(&lock);
+    return [NSJSONSerialization dataWithJSONObject:@{@"traceEvents" : events, @"displayTimeUnit" : @"ms"} options:0 error:nil];
+}
+
+-(BOOL)writeChromeTraceToFile:(NSString *)path error:(NSError **)error{
+    return [[self chromeTraceData] writeToFile:path options:NSDataWritingAtomic error:error];
+}
+
+@end
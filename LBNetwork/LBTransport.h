@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBTransport.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+@class LBURLConnection;
+
+/**
+ * What sits beneath LBHTTPSClient's startRequest: and startSynchronousRequest:.
+ *
+ * A transport loads the connection's original request and delivers the usual
+ * NSURLConnectionDataDelegate callbacks to connection.connectionDelegate on queue,
+ * always passing the LBURLConnection it was handed as the connection argument.
+ * LBNetworkTransport, the default, simply starts the connection.
+ */
+@protocol LBTransport <NSObject>
+
+-(void)startConnection:(LBURLConnection *)connection delegateQueue:(NSOperationQueue *)queue;
+-(NSData *)sendSynchronousRequest:(NSURLRequest *)request returningResponse:(NSHTTPURLResponse **)response error:(NSError **)error;
+@end
+
+@interface LBNetworkTransport : NSObject <LBTransport>
+@end
+
+/**
+ * One response as a transport delivers it: status, headers and body, or an error,
+ * with the time to the response, the arrival time of each body chunk and the total
+ * duration, all relative to the start of the request.
+ */
+@interface LBTransportRecord : NSObject
+
+@property (nonatomic,assign)NSInteger statusCode;
+@property (nonatomic,copy)NSDictionary *headers;
+@property (nonatomic,strong)NSData *body;
+@property (nonatomic,strong)NSError *error;
+@property (nonatomic,assign)NSTimeInterval responseDelay;
+@property (nonatomic,assign)NSTimeInterval duration;
+/**
+ * @[offset in seconds, length] per body chunk, nil to deliver the body at once
+ */
+@property (nonatomic,copy)NSArray *chunks;
+
++(instancetype)recordWithStatusCode:(NSInteger)statusCode headers:(NSDictionary *)headers body:(NSData *)body;
++(instancetype)recordWithError:(NSError *)error;
+
+-(NSHTTPURLResponse *)responseForURL:(NSURL *)URL;
+/**
+ * Plays the record to the connection's delegate on queue, every delay multiplied by
+ * timeScale. Delivery stops once the connection is cancelled.
+ */
+-(void)deliverToConnection:(LBURLConnection *)connection queue:(NSOperationQueue *)queue timeScale:(double)timeScale;
+@end
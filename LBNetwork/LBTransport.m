@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBTransport.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+
+@implementation LBNetworkTransport
+
+-(void)startConnection:(LBURLConnection *)connection delegateQueue:(NSOperationQueue *)queue{
+    [connection setDelegateQueue:queue];
+    [connection start];
+}
+
+-(NSData *)sendSynchronousRequest:(NSURLRequest *)request returningResponse:(NSHTTPURLResponse **)response error:(NSError **)error{
+    NSURLResponse *urlResponse = nil;
+    NSData *data = [NSURLConnection sendSynchronousRequest:request returningResponse:&urlResponse error:error];
+    if (response) {
+        *response = (NSHTTPURLResponse *) urlResponse;
+    }
+    return data;
+}
+@end
+
+@implementation LBTransportRecord
+
++(instancetype)recordWithStatusCode:(NSInteger)statusCode headers:(NSDictionary *)headers body:(NSData *)body{
+    LBTransportRecord *record = [[self alloc]init];
+    record.statusCode = statusCode;
+    record.headers = headers;
+    record.body = body;
+    return record;
+}
+
++(instancetype)recordWithError:(NSError *)error{
+    LBTransportRecord *record = [[self alloc]init];
+    record.error = error;
+    return record;
+}
+
+-(NSHTTPURLResponse *)responseForURL:(NSURL *)URL{
+    NSMutableDictionary *headers = [NSMutableDictionary dictionaryWithDictionary:self.headers ?: @{}];
+    if (!headers[@"Content-Length"]) {
+        //lets the client presize the body buffer like it does for real responses
+        headers[@"Content-Length"] = [NSString stringWithFormat:@"%lu", (unsigned long) self.body.length];
+    }
+    return [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:self.statusCode HTTPVersion:@"HTTP/1.1" headerFields:headers];
+}
+
+-(void)deliverToConnection:(LBURLConnection *)connection queue:(NSOperationQueue *)queue timeScale:(double)timeScale{
+    id delegate = connection.connectionDelegate;
+    NSMutableArray *times = [NSMutableArray array];
+    NSMutableArray *events = [NSMutableArray array];
+    void (^addEvent)(NSTimeInterval, dispatch_block_t) = ^(NSTimeInterval time, dispatch_block_t event) {
+        [times addObject:@(time * timeScale)];
+        [events addObject:[event copy]];
+    };
+
+    if (self.error) {
+        NSError *error = self.error;
+        addEvent(self.duration, ^{
+            if ([delegate respondsToSelector:@selector(connection:didFailWithError:)]) {
+                [delegate connection:connection didFailWithError:error];
+            }
+        });
+    }
+    else {
+        NSHTTPURLResponse *response = [self responseForURL:[connection originalRequest].URL];
+        addEvent(self.responseDelay, ^{
+            if ([delegate respondsToSelector:@selector(connection:didReceiveResponse:)]) {
+                [delegate connection:connection didReceiveResponse:response];
+            }
+        });
+
+        NSData *body = self.body;
+        NSArray *chunks = self.chunks;
+        if (!chunks) {
+            chunks = body.length ? @[@[@(self.responseDelay), @(body.length)]] : @[];
+        }
+        NSUInteger offset = 0;
+        NSTimeInterval lastTime = self.responseDelay;
+        for (NSArray *chunk in chunks) {
+            NSUInteger length = MIN([chunk[1] unsignedIntegerValue], body.length - offset);
+            if (length == 0) {
+                continue;
+            }
+            NSData *piece = offset == 0 && length == body.length ? body : [body subdataWithRange:NSMakeRange(offset, length)];
+            offset += length;
+            lastTime = MAX(lastTime, [chunk[0] doubleValue]);
+            addEvent(lastTime, ^{
+                if ([delegate respondsToSelector:@selector(connection:didReceiveData:)]) {
+                    [delegate connection:connection didReceiveData:piece];
+                }
+            });
+        }
+        addEvent(MAX(lastTime, self.duration), ^{
+            if ([delegate respondsToSelector:@selector(connectionDidFinishLoading:)]) {
+                [delegate connectionDidFinishLoading:connection];
+            }
+        });
+    }
+
+    [LBTransportRecord deliverEvents:events times:times index:0 start:CFAbsoluteTimeGetCurrent() connection:connection queue:queue];
+}
+
+/**
+ * Events that are due run back to back in one operation, the rest are chained
+ * through dispatch_after so they keep their order on a concurrent queue
+ */
++(void)deliverEvents:(NSArray *)events times:(NSArray *)times index:(NSUInteger)index start:(CFAbsoluteTime)start connection:(LBURLConnection *)connection queue:(NSOperationQueue *)queue{
+    [queue addOperationWithBlock:^{
+        NSUInteger i = index;
+        while (i < events.count && !connection.isCancelled) {
+            NSTimeInterval wait = start + [times[i] doubleValue] - CFAbsoluteTimeGetCurrent();
+            if (wait > 0) {
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (wait * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    [LBTransportRecord deliverEvents:events times:times index:i start:start connection:connection queue:queue];
+                });
+                return;
+            }
+            ((dispatch_block_t) events[i])();
+            i++;
+        }
+    }];
+}
+@end
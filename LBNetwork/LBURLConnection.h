@@ -22,6 +22,7 @@
 //  Created by Lena Brusilovski on 3/16/14.
 
 @class LBServerRequest;
+@class LBDigest;
 
 #import "LBServerRequest.h"
 @interface LBURLConnection : NSURLConnection <NSCopying>
@@ -32,6 +33,31 @@
 @property (nonatomic,strong) NSMutableData *data;
 @property (nonatomic,assign) NSInteger retries;
 @property (nonatomic,strong) NSMutableString *retryCount;
+@property (nonatomic,assign) CFAbsoluteTime scheduleTime;
+@property (nonatomic,assign) CFAbsoluteTime startTime;
+@property (nonatomic,assign) CFAbsoluteTime responseTime;
+@property (nonatomic,assign) BOOL showsActivityIndicator;
+@property (nonatomic,strong) LBDigest *digest;
+/**
+ * Queue the delegate is called on, the client's own connection queue when nil
+ */
+@property (nonatomic,strong) NSOperationQueue *delegateQueue;
+/**
+ * Speculative load by LBPrefetcher, not counted as foreground load and never shown
+ * in the activity indicator
+ */
+@property (nonatomic,assign) BOOL prefetch;
+/**
+ * Records handed to the request's recordHandler, a stream that delivered any is not resent
+ */
+@property (nonatomic,assign) NSUInteger deliveredRecords;
+@property (nonatomic,assign,readonly) id connectionDelegate;
+@property (atomic,assign,readonly,getter=isCancelled) BOOL cancelled;
+/**
+ * Run once when the connection is cancelled, transports that load on another
+ * connection use it to cancel that one too
+ */
+@property (atomic,copy) dispatch_block_t cancellationHandler;
 
 -(instancetype)initWithRequest:(LBServerRequest *)request delegate:(id)delegate;
 -(instancetype)initWithRequest:(LBServerRequest *)request delegate:(id)delegate startImmediately:(BOOL)startImmediately;
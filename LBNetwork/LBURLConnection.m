@@ -27,6 +27,7 @@
 #import "Logging.h"
 @interface LBURLConnection ()
 @property(nonatomic,assign)id connectionDelegate;
+@property(atomic,assign,readwrite,getter=isCancelled)BOOL cancelled;
 @end
 @implementation LBURLConnection
 
@@ -41,7 +42,8 @@
 		self.retryCount = [[NSMutableString alloc]init];
 
 		if(!request.successResponseHandler){
-			if([LBHTTPSClient shouldLog]){
+			BOOL shouldLog = [delegate respondsToSelector:@selector(shouldLog)] ? [delegate shouldLog] : [LBHTTPSClient shouldLog];
+			if(shouldLog){
 				LogInfo(@"set nill response handler");
 			}
 		}
@@ -69,11 +71,25 @@
 	return [[response allHeaderFields]objectForKey:@"Content-Type"];
 }
 
+-(void)cancel{
+    [super cancel];
+    dispatch_block_t cancellationHandler;
+    @synchronized (self) {
+        self.cancelled = YES;
+        cancellationHandler = self.cancellationHandler;
+        self.cancellationHandler = nil;
+    }
+    if(cancellationHandler){
+        cancellationHandler();
+    }
+}
+
 -(instancetype)copy {
     LBURLConnection *copy = [[LBURLConnection alloc]initWithRequest:self.request delegate:self.connectionDelegate];
 	copy.retries = self.retries;
 	copy.retryCount = self.retryCount;
-    copy.data = [self.data copy];
+	copy.delegateQueue = self.delegateQueue;
+	copy.prefetch = self.prefetch;
     return  copy;
 }
 
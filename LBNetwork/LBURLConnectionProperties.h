@@ -24,6 +24,7 @@
 
 #import <Foundation/Foundation.h>
 #import "LBDeserializer.h"
+#import "LBDeserializerRegistry.h"
 
 @protocol LBResponseTypeResolver<NSObject>
 
@@ -61,6 +62,10 @@ typedef enum{
 @property (nonatomic,assign)LogLevel logLevel;
 @property (nonatomic,assign)id<LBConnectionErrorHandler>errorHandler;
 @property (nonatomic,assign)id<LBResponseTypeResolver>responseTypeResolver;
+/**
+ * Current immutable snapshot, replaced atomically by registerDeserializer:forContentType:
+ */
+@property (atomic,strong)LBDeserializerRegistry *deserializerRegistry;
 -(id<LBDeserializer>)registerDeserializer:(id<LBDeserializer>)deserializer forContentType:(NSString *)contentType;
 -(id<LBDeserializer>)deserializerForContentType:(NSString *)contentType;
 @end
@@ -54,7 +54,6 @@
 @end
 @interface LBURLConnectionProperties()<LBConnectionErrorHandler,LBResponseTypeResolver>
 
-@property (nonatomic,strong)NSMutableDictionary *registeredDeserializers;
 @end
 
 @implementation LBURLConnectionProperties
@@ -62,10 +61,9 @@
 -(id)init{
     self = [super init];
     if(self) {
-        self.registeredDeserializers = [[NSMutableDictionary alloc]init];
         LBDictionaryDeserializer *dictionaryDeserializer = [[LBDictionaryDeserializer alloc]init];
         LBJavaScriptDeserializer *javaScriptDeserializer = [[LBJavaScriptDeserializer alloc]init];
-        [self registerDeserializer:dictionaryDeserializer forContentType:kDefaultDeserializer];
+        self.deserializerRegistry = [[LBDeserializerRegistry alloc]initWithDefaultDeserializer:dictionaryDeserializer];
         [self registerDeserializer:javaScriptDeserializer forContentType:ContentTypeApplicationJavaScript];
         self.errorHandler = self;
         self.responseTypeResolver = self;
@@ -83,7 +81,8 @@
 }
 
 -(BOOL)shouldDisplayErrorForResponse:(LBServerResponse *)response{
-    return  response.statusCode>kHTTPStatusCodeBadRequest && [[UIApplication sharedApplication]applicationState] == UIApplicationStateActive;
+    //throttling is absorbed by the client's rateLimiter, not worth an alert
+    return  response.statusCode>kHTTPStatusCodeBadRequest && response.statusCode != kHTTPStatusCodeTooManyRequests && [[UIApplication sharedApplication]applicationState] == UIApplicationStateActive;
 }
 
 -(NSString *)messageForErrorForResponse:(LBServerResponse *)response{
@@ -100,17 +99,24 @@
 
 
 -(id<LBDeserializer>)registerDeserializer:(id<LBDeserializer>)deserializer forContentType:(NSString *)contentType{
-    id<LBDeserializer> prev = [self.registeredDeserializers objectForKey:contentType];
-    [self.registeredDeserializers setObject:deserializer forKey:contentType];
-    return prev;
+    //writers serialize among themselves, readers just take whatever snapshot is current
+    @synchronized(self){
+        LBDeserializerRegistry *registry = self.deserializerRegistry;
+        id<LBDeserializer> prev;
+        if ([contentType isEqualToString:kDefaultDeserializer]) {
+            prev = registry.defaultDeserializer;
+            self.deserializerRegistry = [registry registryWithDefaultDeserializer:deserializer];
+        }
+        else {
+            prev = [registry registeredDeserializerForContentType:contentType];
+            self.deserializerRegistry = [registry registryByAddingDeserializer:deserializer forContentType:contentType];
+        }
+        return prev;
+    }
 }
 
 -(id<LBDeserializer>)deserializerForContentType:(NSString *)contentType{
-    id<LBDeserializer> prev = [self.registeredDeserializers objectForKey:contentType];
-    if (!prev) {
-        return [self.registeredDeserializers objectForKey:kDefaultDeserializer];
-    }
-    return prev;
+    return [self.deserializerRegistry deserializerForContentType:contentType];
 }
 
 -(LBResponseType)responseType:(LBServerResponse *)response{
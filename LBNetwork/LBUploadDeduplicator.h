@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBUploadDeduplicator.h
+//  LBNetwork
+//
+
+#import <Foundation/Foundation.h>
+#import "LBDigest.h"
+@class LBServerRequest;
+@class LBServerResponse;
+
+/**
+ * Content addressed uploads. The payload is digested in a streaming pass off the
+ * calling thread, then looked up at lookupURLFormat with the hex digest in place of
+ * %@, so a repeated upload costs one small round trip. The lookup carries the
+ * upload's headers and basic auth so it reaches an authenticated endpoint.
+ *
+ * Only the payload to digest mapping is remembered on the client, in a bounded
+ * cache keyed by the payload itself, so uploading the same data again skips the
+ * hashing pass but is always looked up; the server stays the judge of what it has.
+ * The cache holds on to up to digestCacheLimit payloads, a mapped file costs no
+ * memory while kept.
+ *
+ * When the server has the payload, a 2xx to the lookup, the upload is not sent. Its
+ * handlers get the lookup's response instead, status, headers and body deserialized
+ * like the upload's would be, flagged deduplicated; use a GET lookupMethod when
+ * callers need the stored resource back. Uploads with params are always sent since
+ * the lookup cannot carry them.
+ */
+@interface LBUploadDeduplicator : NSObject
+
+@property (nonatomic,copy,readonly)NSString *lookupURLFormat;
+@property (nonatomic,copy)NSString *lookupMethod;
+@property (nonatomic,assign)LBDigestAlgorithm algorithm;
+/**
+ * Header the upload carries its hex digest in, nil to send none
+ */
+@property (nonatomic,copy)NSString *digestHeaderField;
+/**
+ * Payloads whose digest is remembered, 0 for no limit
+ */
+@property (nonatomic,assign)NSUInteger digestCacheLimit;
+
+-(instancetype)initWithLookupURLFormat:(NSString *)lookupURLFormat;
+
+-(void)digestData:(NSData *)data completion:(void (^)(NSData *digest))completion;
+-(LBServerRequest *)lookupRequestForDigest:(NSData *)digest upload:(LBServerRequest *)upload;
+-(BOOL)lookupFoundDigest:(LBServerResponse *)response;
+@end
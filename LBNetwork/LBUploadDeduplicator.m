@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBUploadDeduplicator.m
+//  LBNetwork
+//
+
+#import "LBNetwork.h"
+
+#define kDefaultDigestHeaderField @"X-Content-Digest"
+#define kDefaultDigestCacheLimit 32
+
+@interface LBUploadDeduplicator ()
+@property (nonatomic,copy,readwrite)NSString *lookupURLFormat;
+@property (nonatomic,strong)dispatch_queue_t digestQueue;
+@property (nonatomic,strong)NSCache *digestCache;
+@end
+
+@implementation LBUploadDeduplicator
+
+-(instancetype)initWithLookupURLFormat:(NSString *)lookupURLFormat{
+    self = [super init];
+    if(self){
+        self.lookupURLFormat = lookupURLFormat;
+        _lookupMethod = @"HEAD";
+        _algorithm = LBDigestAlgorithmSHA256;
+        _digestHeaderField = kDefaultDigestHeaderField;
+        self.digestQueue = dispatch_queue_create("LBUploadDeduplicator.digest", DISPATCH_QUEUE_CONCURRENT);
+        self.digestCache = [[NSCache alloc]init];
+        self.digestCache.countLimit = kDefaultDigestCacheLimit;
+    }
+    return self;
+}
+
+-(NSUInteger)digestCacheLimit{
+    return self.digestCache.countLimit;
+}
+
+-(void)setDigestCacheLimit:(NSUInteger)digestCacheLimit{
+    self.digestCache.countLimit = digestCacheLimit;
+}
+
+-(void)setAlgorithm:(LBDigestAlgorithm)algorithm{
+    if(_algorithm != algorithm){
+        //remembered digests are of the previous algorithm
+        [self.digestCache removeAllObjects];
+    }
+    _algorithm = algorithm;
+}
+
+-(void)digestData:(NSData *)data completion:(void (^)(NSData *digest))completion{
+    LBDigestAlgorithm algorithm = self.algorithm;
+    NSCache *digestCache = self.digestCache;
+    //a mutable payload is snapshotted so the key cannot change under the cache
+    NSData *payload = [data copy];
+    dispatch_async(self.digestQueue, ^{
+        //the same instance compares by pointer, equal bytes by memcmp, both cheaper than the hash
+        NSData *digest = [digestCache objectForKey:payload];
+        if(!digest){
+            //one pass over the byte ranges, a mapped file is never copied
+            digest = [LBDigest digestOfData:payload algorithm:algorithm];
+            [digestCache setObject:digest forKey:payload];
+        }
+        completion(digest);
+    });
+}
+
+-(LBServerRequest *)lookupRequestForDigest:(NSData *)digest upload:(LBServerRequest *)upload{
+    LBServerRequest *request = [LBServerRequest request];
+    request.method = self.lookupMethod;
+    request.path = [NSString stringWithFormat:self.lookupURLFormat, [LBDigest hexStringWithData:digest]];
+    request.silent = YES;
+    //whatever authenticates the upload authenticates its lookup, the body's own headers stay behind
+    NSMutableDictionary *headers = [upload.headers mutableCopy];
+    for(NSString *field in upload.headers){
+        if([field.lowercaseString hasPrefix:@"content-"]){
+            [headers removeObjectForKey:field];
+        }
+    }
+    request.headers = headers;
+    request.basicAuthHeaders = upload.basicAuthHeaders;
+    return request;
+}
+
+-(BOOL)lookupFoundDigest:(LBServerResponse *)response{
+    return !response.error && response.statusCode >= 200 && response.statusCode < 300;
+}
+
+@end
@@ -24,6 +24,111 @@
 //
 #import "LBNetwork.h"
 #import <XCTest/XCTest.h>
+#import <libkern/OSByteOrder.h>
+
+@interface LBChannel (Testing)
++(NSData *)frameWithOpcode:(uint8_t)opcode payload:(NSData *)payload;
++(NSData *)payloadOfFrame:(NSData *)buffer opcode:(uint8_t *)opcode fin:(BOOL *)fin frameLength:(NSUInteger *)frameLength maxLength:(NSUInteger)maxLength error:(NSError **)error;
+@end
+
+@interface LBConcurrencyLimiter (Testing)
+-(NSMutableDictionary *)hosts;
+@end
+
+@interface LBUploadDeduplicator (Testing)
+-(NSCache *)digestCache;
+@end
+
+@interface LBRequestJournal (Testing)
+-(NSUInteger)unsyncedRecords;
+-(NSMutableArray *)entries;
+-(LBServerRequest *)requestForEntry:(id)entry;
+@end
+
+/**
+ * Records of a request journal file up to the first torn or corrupt one, as
+ * type, sequence, offset and length
+ */
+static NSArray<NSDictionary *> *LBJournalRecordsOfFile(NSString *path){
+    NSData *contents = [NSData dataWithContentsOfFile:path];
+    const uint8_t *bytes = contents.bytes;
+    NSMutableArray *records = [NSMutableArray array];
+    NSUInteger offset = 0;
+    while (offset + 17 <= contents.length) {
+        uint32_t length = OSReadLittleInt32(bytes, offset);
+        if (offset + 17 + length > contents.length) {
+            break;
+        }
+        uint32_t hash = 2166136261u;
+        for (NSUInteger i = offset + 8; i < offset + 17 + length; i++) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+        if (hash != OSReadLittleInt32(bytes, offset + 4)) {
+            break;
+        }
+        [records addObject:@{@"type" : @(bytes[offset + 8]),
+                @"sequence" : @(OSReadLittleInt64(bytes, offset + 9)),
+                @"offset" : @(offset),
+                @"length" : @(17 + length)}];
+        offset += 17 + length;
+    }
+    return records;
+}
+
+static LBServerRequest *LBJournaledRequest(NSString *name){
+    LBServerRequest *request = [LBServerRequest request];
+    request.method = kMethodPOST;
+    request.path = [@"https://example.com/outbox/" stringByAppendingString:name];
+    request.requestBodyData = [name dataUsingEncoding:NSUTF8StringEncoding];
+    request.journaled = YES;
+    return request;
+}
+
+/**
+ * Answers a GET for body like a file server, with a 206 for the requested
+ * byte range when ranges is set and the whole body otherwise
+ */
+static LBTransportRecord *LBRangeRecord(NSURLRequest *request, NSData *body, BOOL ranges){
+    NSString *range = [request valueForHTTPHeaderField:@"Range"];
+    if (!ranges || ![range hasPrefix:@"bytes="]) {
+        return [LBTransportRecord recordWithStatusCode:200 headers:@{@"Content-Type" : @"application/octet-stream"} body:body];
+    }
+    NSArray *bounds = [[range substringFromIndex:6] componentsSeparatedByString:@"-"];
+    long long first = [bounds[0] longLongValue];
+    long long last = MIN([bounds[1] longLongValue], (long long)body.length - 1);
+    NSString *contentRange = [NSString stringWithFormat:@"bytes %lld-%lld/%lu", first, last, (unsigned long)body.length];
+    return [LBTransportRecord recordWithStatusCode:206
+                                           headers:@{@"Content-Type" : @"application/octet-stream", @"Content-Range" : contentRange}
+                                              body:[body subdataWithRange:NSMakeRange((NSUInteger)first, (NSUInteger)(last - first + 1))]];
+}
+
+static NSData *LBPatternData(NSUInteger length){
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    uint8_t *bytes = data.mutableBytes;
+    for (NSUInteger i = 0; i < length; i++) {
+        bytes[i] = (uint8_t)((i * 7 + i / 251) % 251);
+    }
+    return data;
+}
+
+/**
+ * Blocks of pseudo random colour, noisy enough that JPEG size tracks quality and pixel count
+ */
+static UIImage *LBNoiseImage(CGSize size){
+    UIGraphicsBeginImageContextWithOptions(size, YES, 1.0);
+    uint32_t state = 1;
+    for (CGFloat y = 0; y < size.height; y += 4) {
+        for (CGFloat x = 0; x < size.width; x += 4) {
+            state = state * 1664525u + 1013904223u;
+            [[UIColor colorWithRed:(state >> 24) / 255.0 green:((state >> 16) & 0xff) / 255.0 blue:((state >> 8) & 0xff) / 255.0 alpha:1] setFill];
+            UIRectFill(CGRectMake(x, y, 4, 4));
+        }
+    }
+    UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    return image;
+}
 
 @interface LBNetworkTests : XCTestCase<NSURLConnectionDataDelegate>
 
@@ -102,6 +207,1086 @@
     
 }
 
+-(void)testMediaTypeParsing{
+    LBMediaType *mediaType = [LBMediaType mediaTypeWithString:@"Application/Vnd.Api+JSON; Charset=\"UTF-8\""];
+    XCTAssertEqualObjects(mediaType.type, @"application");
+    XCTAssertEqualObjects(mediaType.subtype, @"vnd.api+json");
+    XCTAssertEqualObjects(mediaType.suffix, @"json");
+    XCTAssertEqualObjects(mediaType.parameters[@"charset"], @"UTF-8");
+    XCTAssertEqual(mediaType.essence, [LBMediaType mediaTypeWithString:@"application/vnd.api+json"].essence, @"essences should be interned");
+    XCTAssertNil([LBMediaType mediaTypeWithString:@"garbage"]);
+}
+
+-(void)testDeserializerLookup{
+    LBURLConnectionProperties *properties = [[LBURLConnectionProperties alloc]init];
+    id<LBDeserializer> defaultDeserializer = [properties deserializerForContentType:nil];
+    id<LBDeserializer> javaScript = [properties deserializerForContentType:ContentTypeApplicationJavaScript];
+    XCTAssertNotNil(defaultDeserializer);
+    XCTAssertNotEqual(javaScript, defaultDeserializer);
+    XCTAssertEqual([properties deserializerForContentType:@"application/javascript; charset=utf-8"], javaScript, @"parameters should not affect lookup");
+
+    id<LBDeserializer> json = [properties deserializerForContentType:@"application/json"];
+    [properties registerDeserializer:javaScript forContentType:@"application/json"];
+    XCTAssertEqual([properties deserializerForContentType:@"application/problem+json"], javaScript, @"+json should fall back to application/json");
+    XCTAssertEqual([properties registerDeserializer:json forContentType:@"application/json"], javaScript, @"registering should return the previous deserializer");
+    XCTAssertEqual([properties deserializerForContentType:@"text/html"], defaultDeserializer);
+
+    [properties registerDeserializer:javaScript forContentType:@"legacy-json"];
+    XCTAssertEqual([properties deserializerForContentType:@"legacy-json"], javaScript, @"keys that are not media types should match exactly");
+}
+
+-(void)testRequestTemplate{
+    XCTAssertEqualObjects(LBPercentEncodedString(@"a b&c=d/é~"), @"a%20b%26c%3Dd%2F%C3%A9~");
+    XCTAssertEqualObjects(LBQueryStringFromParameters(@{@"q":@"x y",@"a":@1}), @"a=1&q=x%20y", @"keys should be sorted");
+    XCTAssertEqualObjects(LBContentTypeForRequestBody([@" {\"a\":1}\n" dataUsingEncoding:NSUTF8StringEncoding]), @"application/json; charset=utf-8");
+    XCTAssertEqualObjects(LBContentTypeForRequestBody([@"a=1" dataUsingEncoding:NSUTF8StringEncoding]), @"application/x-www-form-urlencoded; charset=utf-8");
+    XCTAssertEqualObjects(LBContentTypeForRequestBody(UIImagePNGRepresentation(LBNoiseImage(CGSizeMake(8, 8)))), @"jsonmodel/automatic; charset=utf-8", @"binary bodies should not be labelled form encoded");
+
+    LBRequestTemplate *template = [LBRequestTemplate templateWithMethod:kMethodGET baseURL:[NSURL URLWithString:@"https://example.com/api/"] pathPattern:@"/users/{id}/posts"];
+    template.defaultHeaders = @{@"Accept":@"application/json"};
+    [template authenticate:@"user" password:@"pass"];
+    LBServerRequest *request = [template requestWithPathParameters:@{@"id":@"a/b"} query:@{@"page":@2} body:nil];
+    XCTAssertEqualObjects(request.httpRequest.URL.absoluteString, @"https://example.com/api/users/a%2Fb/posts?page=2");
+    XCTAssertEqualObjects([request.httpRequest valueForHTTPHeaderField:@"Authorization"], @"Basic dXNlcjpwYXNz");
+    XCTAssertEqualObjects([request.httpRequest valueForHTTPHeaderField:@"Accept"], @"application/json");
+    XCTAssertTrue(request.preparedHTTPRequest);
+    XCTAssertNil([template requestWithPathParameters:nil query:nil body:nil], @"missing placeholder values should fail");
+}
+
+-(void)testLoopbackTransport{
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    LBLoopbackTransport *transport = [[LBLoopbackTransport alloc]init];
+    NSURL *URL = [NSURL URLWithString:@"https://example.com/items"];
+    [transport setRecord:[LBTransportRecord recordWithStatusCode:200 headers:@{@"Content-Type":@"application/json"} body:[@"{\"a\":1}" dataUsingEncoding:NSUTF8StringEncoding]] forURL:URL];
+    client.transport = transport;
+
+    LBServerRequest *request = [LBServerRequest getRequest];
+    request.path = URL.absoluteString;
+    __block LBServerResponse *received;
+    [client startSynchronousRequest:request responseHandler:^(LBServerResponse *response) {
+        received = response;
+    }];
+    XCTAssertEqual(received.statusCode, 200);
+    XCTAssertEqualObjects(received.output[@"a"], @1);
+    XCTAssertEqual(transport.requestCount, 1u);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"async loopback"];
+    transport.responder = ^LBTransportRecord *(NSURLRequest *URLRequest) {
+        return [LBTransportRecord recordWithStatusCode:201 headers:nil body:nil];
+    };
+    LBServerRequest *created = [LBServerRequest postRequest];
+    created.path = @"https://example.com/created";
+    created.responseHandler = ^(LBServerResponse *response) {
+        XCTAssertEqual(response.statusCode, 201);
+        [expectation fulfill];
+    };
+    [client sendRequest:created];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+-(void)testStaleWhileRevalidate{
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    __block NSInteger version = 1;
+    client.transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        NSString *body = [NSString stringWithFormat:@"{\"version\":%ld}", (long) version];
+        return [LBTransportRecord recordWithStatusCode:200 headers:@{@"Content-Type":@"application/json"} body:[body dataUsingEncoding:NSUTF8StringEncoding]];
+    }];
+
+    NSMutableArray *deliveries = [NSMutableArray array];
+    LBServerRequest *(^feedRequest)(XCTestExpectation *, NSUInteger) = ^LBServerRequest *(XCTestExpectation *expectation, NSUInteger expectedCount) {
+        LBServerRequest *request = [LBServerRequest getRequest];
+        request.path = @"https://example.com/feed";
+        request.cacheMode = LBRequestCacheModeStaleWhileRevalidate;
+        request.responseHandler = ^(LBServerResponse *response) {
+            @synchronized (deliveries) {
+                [deliveries addObject:@[@(response.isStale), response.output[@"version"] ?: @0]];
+                if (deliveries.count == expectedCount) {
+                    [expectation fulfill];
+                }
+            }
+        };
+        return request;
+    };
+
+    [client sendRequest:feedRequest([self expectationWithDescription:@"fresh"], 1)];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    version = 2;
+    [client sendRequest:feedRequest([self expectationWithDescription:@"stale then fresh"], 3)];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    NSArray *expected = @[@[@NO, @1], @[@YES, @1], @[@NO, @2]];
+    XCTAssertEqualObjects(deliveries, expected);
+}
+
+-(void)testPrefetchStore{
+    LBPrefetchStore *store = [[LBPrefetchStore alloc]init];
+    store.maxEntries = 2;
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc]initWithURL:[NSURL URLWithString:@"https://example.com"] statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:nil];
+    for (NSString *key in @[@"a", @"b", @"c"]) {
+        [store setResponse:[LBCachedResponse cachedResponseWithResponse:response body:[key dataUsingEncoding:NSUTF8StringEncoding]] forKey:key];
+    }
+    XCTAssertEqual(store.count, 2u);
+    XCTAssertNil([store takeResponseForKey:@"a"], @"the oldest entry should be evicted");
+    XCTAssertNotNil([store takeResponseForKey:@"b"]);
+    XCTAssertNil([store takeResponseForKey:@"b"], @"prefetched responses are handed out once");
+    XCTAssertEqual(store.bytes, 1u);
+}
+
+-(void)testRecordFramers{
+    LBLineFramer *lines = [LBLineFramer framer];
+    XCTAssertTrue([lines appendData:[@"{\"a\":1}\r\n\n{\"a\"" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+    XCTAssertEqualObjects([lines nextRecord], [@"{\"a\":1}" dataUsingEncoding:NSUTF8StringEncoding]);
+    XCTAssertNil([lines nextRecord], @"blank lines and partial records are not records");
+    XCTAssertTrue([lines appendData:[@":2}" dataUsingEncoding:NSUTF8StringEncoding] error:nil]);
+    [lines finish];
+    XCTAssertEqualObjects([lines nextRecord], [@"{\"a\":2}" dataUsingEncoding:NSUTF8StringEncoding]);
+
+    LBServerSentEventFramer *events = [LBServerSentEventFramer framer];
+    [events appendData:[@": keep alive\nevent: update\nid: 7\ndata: one\r" dataUsingEncoding:NSUTF8StringEncoding] error:nil];
+    XCTAssertNil([events nextRecord]);
+    [events appendData:[@"\ndata: two\n\n" dataUsingEncoding:NSUTF8StringEncoding] error:nil];
+    LBServerSentEvent *event = [events nextRecord];
+    XCTAssertEqualObjects(event.type, @"update");
+    XCTAssertEqualObjects(event.data, @"one\ntwo");
+    XCTAssertEqualObjects(event.identifier, @"7");
+
+    LBLengthPrefixedFramer *frames = [LBLengthPrefixedFramer framer];
+    frames.maxRecordLength = 8;
+    const uint8_t frame[] = {0, 0, 0, 2, 'h', 'i', 0, 0, 0, 9};
+    NSError *error = nil;
+    XCTAssertFalse([frames appendData:[NSData dataWithBytes:frame length:sizeof(frame)] error:&error]);
+    XCTAssertEqual(error.code, LBNetworkErrorRecordTooLarge);
+    XCTAssertEqualObjects([frames nextRecord], [@"hi" dataUsingEncoding:NSUTF8StringEncoding], @"records before the error are kept");
+}
+
+-(void)testImageDecodingAndCache{
+    UIGraphicsBeginImageContextWithOptions(CGSizeMake(40, 20), YES, 1.0);
+    [[UIColor redColor] setFill];
+    UIRectFill(CGRectMake(0, 0, 40, 20));
+    UIImage *source = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+
+    UIImage *decoded = [LBImageDeserializer decodeImageData:UIImagePNGRepresentation(source) maxPixelSize:10];
+    XCTAssertEqual(CGImageGetWidth(decoded.CGImage), 10u, @"the longest side should be downsampled");
+    XCTAssertEqual(CGImageGetHeight(decoded.CGImage), 5u);
+
+    LBImageCache *cache = [[LBImageCache alloc]init];
+    NSUInteger cost = [LBImageCache costForImage:decoded];
+    cache.totalCostLimit = cost * 2;
+    NSURL *URL = [NSURL URLWithString:@"https://example.com/a.png"];
+    [cache setImage:decoded forURL:URL pixelSize:10];
+    [cache setImage:decoded forURL:URL pixelSize:20];
+    XCTAssertNotNil([cache imageForURL:URL pixelSize:10], @"touching an image makes it the most recently used");
+    [cache setImage:decoded forURL:URL pixelSize:30];
+    XCTAssertNil([cache imageForURL:URL pixelSize:20], @"the least recently used image should be evicted");
+    XCTAssertNotNil([cache imageForURL:URL pixelSize:10]);
+    XCTAssertEqual(cache.totalCost, cost * 2);
+
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:URL];
+    XCTAssertTrue([LBImageCache isCacheableRequest:request]);
+    [request setValue:@"Bearer token" forHTTPHeaderField:@"Authorization"];
+    XCTAssertFalse([LBImageCache isCacheableRequest:request], @"authenticated images should not be shared by URL");
+    [request setValue:nil forHTTPHeaderField:@"Authorization"];
+    [request setValue:@"max-age=0, no-cache" forHTTPHeaderField:@"Cache-Control"];
+    XCTAssertFalse([LBImageCache isCacheableRequest:request]);
+    NSHTTPURLResponse *(^response)(NSDictionary *) = ^NSHTTPURLResponse *(NSDictionary *headers) {
+        return [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:headers];
+    };
+    XCTAssertTrue([LBImageCache isCacheableResponse:response(@{@"Cache-Control" : @"public, max-age=60"})]);
+    XCTAssertFalse([LBImageCache isCacheableResponse:response(@{@"cache-control" : @"Private"})]);
+}
+
+-(void)testResponseDigest{
+    NSData *abc = [@"abc" dataUsingEncoding:NSUTF8StringEncoding];
+    XCTAssertEqualObjects([LBDigest hexStringWithData:[LBDigest digestOfData:abc algorithm:LBDigestAlgorithmSHA256]], @"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    LBDigest *crc = [LBDigest digestWithAlgorithm:LBDigestAlgorithmCRC32];
+    [crc updateWithData:[@"1234" dataUsingEncoding:NSUTF8StringEncoding]];
+    [crc updateWithData:[@"56789" dataUsingEncoding:NSUTF8StringEncoding]];
+    XCTAssertEqualObjects([crc finalDigest], [LBDigest dataWithHexString:@"CBF43926"], @"chunks should digest like the whole body");
+
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    LBLoopbackTransport *transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        return [LBTransportRecord recordWithStatusCode:200 headers:nil body:abc];
+    }];
+    client.transport = transport;
+
+    LBServerRequest *request = [LBServerRequest getRequest];
+    request.path = @"https://example.com/abc";
+    request.digestAlgorithm = LBDigestAlgorithmCRC32;
+    request.expectedDigest = [LBDigest digestOfData:abc algorithm:LBDigestAlgorithmCRC32];
+    __block LBServerResponse *received;
+    [client startSynchronousRequest:request responseHandler:^(LBServerResponse *response) {
+        received = response;
+    }];
+    XCTAssertEqualObjects(received.digest, request.expectedDigest);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"digest mismatch"];
+    LBServerRequest *corrupted = [LBServerRequest getRequest];
+    corrupted.path = @"https://example.com/abc";
+    corrupted.digestAlgorithm = LBDigestAlgorithmSHA256;
+    corrupted.expectedDigest = [LBDigest digestOfData:[NSData data] algorithm:LBDigestAlgorithmSHA256];
+    corrupted.failResponseHandler = ^(NSError *error) {
+        XCTAssertEqualObjects(error.domain, LBNetworkErrorDomain);
+        XCTAssertEqual(error.code, LBNetworkErrorDigestMismatch);
+        [expectation fulfill];
+    };
+    [client sendRequest:corrupted];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    //a cached body is held to the expected digest too
+    __block NSData *body = abc;
+    client.transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        return [LBTransportRecord recordWithStatusCode:200 headers:nil body:body];
+    }];
+    LBServerResponse *(^fetchCached)(NSData *) = ^LBServerResponse *(NSData *expectedDigest) {
+        XCTestExpectation *fetched = [self expectationWithDescription:@"cached"];
+        NSMutableArray *responses = [NSMutableArray array];
+        LBServerRequest *cached = [LBServerRequest getRequest];
+        cached.path = @"https://example.com/cached";
+        cached.cacheMode = LBRequestCacheModeStaleWhileRevalidate;
+        cached.digestAlgorithm = LBDigestAlgorithmSHA256;
+        cached.expectedDigest = expectedDigest;
+        cached.responseHandler = ^(LBServerResponse *response) {
+            [responses addObject:response];
+            if (!response.isStale) {
+                [fetched fulfill];
+            }
+        };
+        [client sendRequest:cached];
+        [self waitForExpectationsWithTimeout:5 handler:nil];
+        XCTAssertEqual(responses.count, 1u, @"a cached body not matching the expected digest should not be delivered");
+        return responses.lastObject;
+    };
+    fetchCached([LBDigest digestOfData:abc algorithm:LBDigestAlgorithmSHA256]);
+    body = [@"abcd" dataUsingEncoding:NSUTF8StringEncoding];
+    LBServerResponse *fresh = fetchCached([LBDigest digestOfData:body algorithm:LBDigestAlgorithmSHA256]);
+    XCTAssertEqualObjects(fresh.rawResponseData, body);
+    XCTAssertEqualObjects(fresh.digest, [LBDigest digestOfData:body algorithm:LBDigestAlgorithmSHA256]);
+}
+
+-(void)testEndpointGroupFailover{
+    NSURL *east = [NSURL URLWithString:@"https://east.example.com/v1"];
+    NSURL *west = [NSURL URLWithString:@"https://west.example.com/v1"];
+    LBEndpointGroup *scored = [LBEndpointGroup groupWithName:@"scored" baseURLs:@[east, west]];
+    XCTAssertEqualObjects([scored baseURLExcluding:nil], east, @"unmeasured replicas should be tried in order");
+    [scored recordLatency:0.5 failed:NO forBaseURL:east];
+    [scored recordLatency:0.1 failed:NO forBaseURL:west];
+    XCTAssertEqualObjects([scored baseURLExcluding:nil], west, @"the faster replica should win");
+    [scored recordLatency:0 failed:YES forBaseURL:west];
+    [scored recordLatency:0 failed:YES forBaseURL:west];
+    XCTAssertEqualObjects([scored baseURLExcluding:nil], east, @"errors should outweigh latency");
+    XCTAssertNil([scored baseURLExcluding:@[east, west]]);
+
+    LBEndpointGroup *decaying = [LBEndpointGroup groupWithName:@"decaying" baseURLs:@[east, west]];
+    decaying.errorHalfLife = 0.05;
+    [decaying recordLatency:1.0 failed:NO forBaseURL:east];
+    [decaying recordLatency:0.1 failed:NO forBaseURL:west];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.3]];
+    [decaying recordLatency:0.1 failed:NO forBaseURL:west];
+    XCTAssertEqualObjects([decaying baseURLExcluding:nil], east, @"an idle slow replica should drift back to be probed");
+
+    NSError *timedOut = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil];
+    XCTAssertTrue([LBEndpointGroup isFailoverError:timedOut method:kMethodGET]);
+    XCTAssertFalse([LBEndpointGroup isFailoverError:timedOut method:kMethodPOST], @"a POST the replica may have applied should not be resent");
+    XCTAssertTrue([LBEndpointGroup isFailoverError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotConnectToHost userInfo:nil] method:kMethodPOST]);
+
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    [client addEndpointGroup:[LBEndpointGroup groupWithName:@"api" baseURLs:@[east, west]]];
+    __block NSInteger eastAttempts = 0;
+    client.transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        if ([request.URL.host isEqualToString:east.host]) {
+            eastAttempts++;
+            return [LBTransportRecord recordWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotConnectToHost userInfo:nil]];
+        }
+        return [LBTransportRecord recordWithStatusCode:200 headers:nil body:nil];
+    }];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"failover"];
+    LBServerRequest *request = [LBServerRequest getRequest];
+    request.endpointGroup = @"api";
+    request.path = @"/items";
+    request.params = @{@"page":@"2"};
+    request.responseHandler = ^(LBServerResponse *response) {
+        XCTAssertEqual(response.statusCode, 200);
+        XCTAssertEqualObjects(response.request.endpointBaseURL, west);
+        XCTAssertEqualObjects(response.request.httpRequest.URL.absoluteString, @"https://west.example.com/v1/items?page=2");
+        [expectation fulfill];
+    };
+    [client sendRequest:request];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertGreaterThan([[client endpointGroupNamed:@"api"] errorRateForBaseURL:east], 0);
+    XCTAssertNil(request.baseURL, @"the client's pick should not become the caller's base");
+    XCTAssertEqual(eastAttempts, 1);
+
+    XCTestExpectation *resent = [self expectationWithDescription:@"resent"];
+    request.responseHandler = ^(LBServerResponse *response) {
+        XCTAssertEqual(response.statusCode, 200);
+        [resent fulfill];
+    };
+    [client sendRequest:request];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertEqualObjects(request.endpointBaseURL, west, @"a resend should be routed afresh");
+    XCTAssertEqual(eastAttempts, 1);
+
+    XCTestExpectation *pinned = [self expectationWithDescription:@"pinned"];
+    LBServerRequest *pinnedRequest = [LBServerRequest getRequest];
+    pinnedRequest.endpointGroup = @"api";
+    pinnedRequest.baseURL = east;
+    pinnedRequest.path = @"/items";
+    pinnedRequest.responseHandler = ^(LBServerResponse *response) {
+        XCTAssertNotNil(response.error, @"a caller-set base should neither be rerouted nor failed over");
+        [pinned fulfill];
+    };
+    [client sendRequest:pinnedRequest];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertNil(pinnedRequest.endpointBaseURL);
+    XCTAssertGreaterThan(eastAttempts, 1);
+}
+
+-(void)testRateLimiterBackoff{
+    NSURL *URL = [NSURL URLWithString:@"https://api.example.com/v1/search?q=a"];
+    NSHTTPURLResponse *(^response)(NSInteger, NSDictionary *) = ^NSHTTPURLResponse *(NSInteger statusCode, NSDictionary *headers) {
+        return [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:headers];
+    };
+    XCTAssertEqual([LBRateLimiter retryAfterForResponse:response(429, @{@"Retry-After":@"5"})], 5);
+    XCTAssertEqual([LBRateLimiter retryAfterForResponse:response(429, @{@"Retry-After":@"Wed, 21 Oct 2015 07:28:00 GMT"})], 0, @"dates in the past hold nothing");
+    XCTAssertEqualObjects([LBRateLimiter routeForURL:URL], @"api.example.com/v1/search");
+
+    LBRateLimiter *limiter = [[LBRateLimiter alloc]init];
+    [limiter setRate:10 burst:2 forHost:URL.host];
+    [limiter recordResponse:response(503, nil) forURL:URL];
+    XCTAssertEqualWithAccuracy([limiter rateForHost:URL.host], 5, 0.001, @"a 503 should halve the host rate");
+    [limiter recordResponse:response(200, nil) forURL:URL];
+    XCTAssertEqualWithAccuracy([limiter rateForHost:URL.host], 5.5, 0.001);
+
+    limiter = [[LBRateLimiter alloc]init];
+    [limiter recordResponse:response(429, @{@"Retry-After":@"1"}) forURL:URL];
+    XCTAssertEqualWithAccuracy([limiter rateForRoute:[LBRateLimiter routeForURL:URL]], limiter.throttledRate, 0.001);
+    XCTestExpectation *expectation = [self expectationWithDescription:@"held for Retry-After"];
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    __block BOOL started = NO;
+    [limiter scheduleForURL:URL block:^{
+        started = YES;
+        XCTAssertGreaterThanOrEqual(CFAbsoluteTimeGetCurrent() - start, 0.9);
+        [expectation fulfill];
+    }];
+    XCTAssertFalse(started);
+    XCTAssertEqual([limiter waitingForHost:URL.host], 1u);
+    __block BOOL otherRouteStarted = NO;
+    [limiter scheduleForURL:[NSURL URLWithString:@"https://api.example.com/v1/items"] block:^{
+        otherRouteStarted = YES;
+    }];
+    XCTAssertTrue(otherRouteStarted, @"a throttled route should not hold back the rest of the host");
+    [self waitForExpectationsWithTimeout:3 handler:nil];
+}
+
+-(void)testRequestTracing{
+    LBTracer *ring = [[LBTracer alloc]initWithCapacity:2];
+    [ring recordInstant:"first" trace:1 detail:nil];
+    [ring recordInstant:"second" trace:1 detail:@"kept"];
+    [ring recordSpan:"third" trace:2 start:[ring timestamp]];
+    XCTAssertEqual(ring.count, 2u);
+    NSArray *ringEvents = [NSJSONSerialization JSONObjectWithData:[ring chromeTraceData] options:0 error:nil][@"traceEvents"];
+    XCTAssertEqualObjects([ringEvents valueForKey:@"name"], (@[@"second", @"third"]), @"the oldest span should be overwritten");
+    XCTAssertEqualObjects(ringEvents[0][@"args"][@"detail"], @"kept");
+
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    client.tracer = [[LBTracer alloc]init];
+    client.transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        return [LBTransportRecord recordWithStatusCode:200 headers:@{@"Content-Type":@"application/json"} body:[@"{}" dataUsingEncoding:NSUTF8StringEncoding]];
+    }];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"traced"];
+    LBServerRequest *request = [LBServerRequest getRequest];
+    request.path = @"https://example.com/traced";
+    request.responseHandler = ^(LBServerResponse *response) {
+        [expectation fulfill];
+    };
+    [client sendRequest:request];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    NSArray *events = [NSJSONSerialization JSONObjectWithData:[client.tracer chromeTraceData] options:0 error:nil][@"traceEvents"];
+    NSSet *names = [NSSet setWithArray:[events valueForKey:@"name"]];
+    for (NSString *stage in @[@"sendRequest", @"setupRequest", @"queueWait", @"connectionStart", @"firstByte", @"download", @"deserialize"]) {
+        XCTAssertTrue([names containsObject:stage], @"missing %@", stage);
+    }
+    XCTAssertEqualObjects([[NSSet setWithArray:[events valueForKey:@"tid"]] allObjects], @[@(request.traceID)], @"a request should stay on one row");
+}
+
+-(void)testUploadDeduplication{
+    NSData *first = [@"first payload" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *second = [@"second payload" dataUsingEncoding:NSUTF8StringEncoding];
+    NSString *firstDigest = [LBDigest hexStringWithData:[LBDigest digestOfData:first algorithm:LBDigestAlgorithmSHA256]];
+    NSMutableSet *stored = [NSMutableSet set];
+    __block NSUInteger lookups = 0;
+    __block NSUInteger uploads = 0;
+    __block NSString *uploadedDigest;
+
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    client.uploadDeduplicator = [[LBUploadDeduplicator alloc]initWithLookupURLFormat:@"https://example.com/blobs/%@"];
+    client.uploadDeduplicator.lookupMethod = @"GET";
+    client.transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        @synchronized (self) {
+            if ([request.HTTPMethod isEqualToString:@"GET"]) {
+                lookups++;
+                if (![request valueForHTTPHeaderField:@"Authorization"]) {
+                    return [LBTransportRecord recordWithStatusCode:401 headers:nil body:nil];
+                }
+                NSString *digest = request.URL.lastPathComponent;
+                if (![stored containsObject:digest]) {
+                    return [LBTransportRecord recordWithStatusCode:404 headers:nil body:nil];
+                }
+                NSData *body = [[NSString stringWithFormat:@"{\"id\":\"%@\"}", digest] dataUsingEncoding:NSUTF8StringEncoding];
+                return [LBTransportRecord recordWithStatusCode:200 headers:@{@"Content-Type" : ContentTypeJSON} body:body];
+            }
+            uploads++;
+            uploadedDigest = [request valueForHTTPHeaderField:@"X-Content-Digest"];
+            if (uploadedDigest) {
+                [stored addObject:uploadedDigest];
+            }
+            return [LBTransportRecord recordWithStatusCode:201 headers:nil body:nil];
+        }
+    }];
+
+    LBServerResponse *(^upload)(NSData *, NSDictionary *) = ^LBServerResponse *(NSData *payload, NSDictionary *params) {
+        XCTestExpectation *expectation = [self expectationWithDescription:@"upload"];
+        __block LBServerResponse *received;
+        LBServerRequest *request = [LBServerRequest uploadRequest:payload];
+        request.path = @"https://example.com/files";
+        request.params = params;
+        [request authenticate:@"user" password:@"hunter2"];
+        request.responseHandler = ^(LBServerResponse *response) {
+            received = response;
+            [expectation fulfill];
+        };
+        [client asyncUploadRequestRawData:request];
+        [self waitForExpectationsWithTimeout:5 handler:nil];
+        return received;
+    };
+
+    LBServerResponse *response = upload(first, nil);
+    XCTAssertEqual(response.statusCode, 201);
+    XCTAssertFalse(response.isDeduplicated);
+    XCTAssertEqualObjects(uploadedDigest, firstDigest);
+
+    response = upload(first, nil);
+    XCTAssertTrue(response.isDeduplicated, @"a payload the server has should not be sent");
+    XCTAssertEqual(response.statusCode, 200, @"the lookup's response should stand in for the upload's");
+    XCTAssertEqualObjects(response.rawResponseString, ([NSString stringWithFormat:@"{\"id\":\"%@\"}", firstDigest]));
+    XCTAssertEqual(lookups, 2u, @"every upload should be looked up, only the digest is remembered on the client");
+    XCTAssertEqualObjects([LBDigest hexStringWithData:[client.uploadDeduplicator.digestCache objectForKey:first]], firstDigest);
+    XCTAssertEqual(uploads, 1u);
+
+    [stored removeAllObjects];
+    response = upload(first, nil);
+    XCTAssertFalse(response.isDeduplicated, @"a payload the server dropped should be sent again");
+    XCTAssertEqual(uploads, 2u);
+
+    response = upload(second, @{@"album" : @"1"});
+    XCTAssertFalse(response.isDeduplicated);
+    XCTAssertEqual(lookups, 3u, @"uploads with params should not be looked up");
+    XCTAssertEqual(uploads, 3u);
+}
+
+-(void)testChannelFraming{
+    //example from RFC 6455 section 1.3
+    XCTAssertEqualObjects([LBChannel acceptValueForKey:@"dGhlIHNhbXBsZSBub25jZQ=="], @"s3pPLMBiTxaQ9kYGzzhZ+oQ=");
+
+    LBChannel *channel = [[[LBHTTPSClient alloc]init] channelWithURL:[NSURL URLWithString:@"wss://example.com/push"]];
+    XCTAssertEqual(channel.state, LBChannelStateClosed);
+    XCTAssertEqualWithAccuracy([channel reconnectDelayForAttempt:0], 1, 0.001);
+    XCTAssertEqualWithAccuracy([channel reconnectDelayForAttempt:3], 8, 0.001);
+    XCTAssertEqualWithAccuracy([channel reconnectDelayForAttempt:20], 60, 0.001, @"backoff should be capped");
+
+    NSMutableData *payload = [NSMutableData dataWithLength:70000];
+    arc4random_buf(payload.mutableBytes, payload.length);
+    for (NSData *sent in @[[@"{}" dataUsingEncoding:NSUTF8StringEncoding], [payload subdataWithRange:NSMakeRange(0, 300)], payload]) {
+        NSMutableData *buffer = [[LBChannel frameWithOpcode:0x2 payload:sent] mutableCopy];
+        uint8_t opcode = 0;
+        BOOL fin = NO;
+        NSUInteger frameLength = 0;
+        NSError *error = nil;
+        NSData *partial = [buffer subdataWithRange:NSMakeRange(0, buffer.length - 1)];
+        XCTAssertNil([LBChannel payloadOfFrame:partial opcode:&opcode fin:&fin frameLength:&frameLength maxLength:NSUIntegerMax error:&error], @"an incomplete frame should wait for more bytes");
+        XCTAssertNil(error);
+
+        [buffer appendBytes:"x" length:1];
+        NSData *received = [LBChannel payloadOfFrame:buffer opcode:&opcode fin:&fin frameLength:&frameLength maxLength:NSUIntegerMax error:&error];
+        XCTAssertEqualObjects(received, sent);
+        XCTAssertEqual(opcode, 0x2);
+        XCTAssertTrue(fin);
+        XCTAssertEqual(frameLength, buffer.length - 1, @"bytes of the next frame should be left alone");
+
+        XCTAssertNil([LBChannel payloadOfFrame:buffer opcode:&opcode fin:&fin frameLength:&frameLength maxLength:1 error:&error]);
+        XCTAssertEqual(error.code, LBNetworkErrorChannelProtocolError);
+    }
+}
+
+-(void)testBufferPool{
+    LBBufferPool *pool = [[LBBufferPool alloc]init];
+    pool.minimumBufferSize = 1024;
+    pool.maximumBufferSize = 8192;
+    pool.maxBuffersPerClass = 2;
+    pool.maxRetainedBytes = 12288;
+
+    NSMutableData *small = [pool bufferForExpectedLength:1000];
+    NSMutableData *medium = [pool bufferForExpectedLength:3000];
+    [small appendBytes:"abc" length:3];
+    [pool recycleBuffer:small];
+    [pool recycleBuffer:medium];
+    XCTAssertEqual(pool.bytesRetained, 1024u + 4096u, @"buffers should be retained by their size class");
+
+    NSMutableData *reused = [pool bufferForExpectedLength:900];
+    XCTAssertEqual(reused, small, @"a request fitting a pooled class should reuse its buffer");
+    XCTAssertEqual(reused.length, 0u);
+    XCTAssertEqual(pool.bytesRetained, 4096u);
+
+    [pool recycleBuffer:[pool bufferForExpectedLength:5000]];
+    XCTAssertEqual(pool.bytesRetained, 4096u + 8192u);
+    [pool recycleBuffer:[pool bufferForExpectedLength:6000]];
+    XCTAssertEqual(pool.bytesRetained, 4096u + 8192u, @"maxRetainedBytes should not be exceeded");
+
+    XCTAssertNotNil([pool bufferForExpectedLength:1LL << 40], @"an oversized expected length should not be presized");
+
+    [pool trim];
+    XCTAssertEqual(pool.bytesRetained, 0u);
+
+    NSMutableData *grown = [pool bufferForExpectedLength:100];
+    [grown setLength:5000];
+    [pool recycleBuffer:grown];
+    XCTAssertEqual(pool.bytesRetained, 4096u, @"a buffer that grew should move to the class it now fits");
+    XCTAssertEqual([pool bufferForExpectedLength:4000], grown);
+
+    NSDictionary *statistics = [pool statistics];
+    XCTAssertEqualObjects(statistics[@"hits"], @2);
+    XCTAssertEqualObjects(statistics[@"misses"], @6);
+    XCTAssertEqualObjects(statistics[@"bytesRetained"], @0);
+}
+
+-(void)testRequestJournalRecords{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    LBRequestJournal *journal = [[LBRequestJournal alloc]initWithPath:path];
+    LBServerRequest *first = LBJournaledRequest(@"first");
+    [journal appendRequest:first];
+    [journal appendRequest:LBJournaledRequest(@"second")];
+    [journal appendRequest:LBJournaledRequest(@"third")];
+    [journal acknowledgeRequest:first];
+    [journal synchronize];
+
+    NSArray<NSDictionary *> *records = LBJournalRecordsOfFile(path);
+    XCTAssertEqual(records.count, 4u, @"three requests and an ack, each with a valid checksum");
+    XCTAssertEqualObjects(records[0][@"type"], @1);
+    XCTAssertEqualObjects(records[0][@"sequence"], @1);
+    XCTAssertEqualObjects(records[2][@"sequence"], @3);
+    XCTAssertEqualObjects(records[3][@"type"], @2);
+    XCTAssertEqualObjects(records[3][@"sequence"], @1);
+    XCTAssertEqualObjects(records[3][@"length"], @17, @"an ack carries no payload");
+    XCTAssertEqual([[LBRequestJournal alloc]initWithPath:path].pendingCount, 2u);
+
+    //a crash mid-write leaves part of a record behind
+    NSData *contents = [NSData dataWithContentsOfFile:path];
+    NSFileHandle *handle = [NSFileHandle fileHandleForWritingAtPath:path];
+    [handle seekToEndOfFile];
+    [handle writeData:[contents subdataWithRange:NSMakeRange(0, 30)]];
+    [handle closeFile];
+    XCTAssertEqual([[LBRequestJournal alloc]initWithPath:path].pendingCount, 2u);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:path], contents, @"a torn tail should be truncated");
+
+    //a corrupt record drops it and everything written after it
+    NSMutableData *corrupt = [contents mutableCopy];
+    NSUInteger third = [records[2][@"offset"] unsignedIntegerValue];
+    ((uint8_t *) corrupt.mutableBytes)[third + 20] ^= 0xFF;
+    [corrupt writeToFile:path atomically:NO];
+    XCTAssertEqual([[LBRequestJournal alloc]initWithPath:path].pendingCount, 2u, @"the first two requests, their ack was after the corruption");
+    XCTAssertEqual([[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil].fileSize, third);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+-(void)testRequestJournalSyncAndCompaction{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    LBRequestJournal *journal = [[LBRequestJournal alloc]initWithPath:path];
+    journal.syncBatchSize = 3;
+    journal.syncInterval = 60;
+    journal.compactionThreshold = 2;
+
+    LBServerRequest *first = LBJournaledRequest(@"first");
+    LBServerRequest *second = LBJournaledRequest(@"second");
+    [journal appendRequest:first];
+    [journal appendRequest:second];
+    XCTAssertEqual([journal unsyncedRecords], 2u);
+    [journal appendRequest:LBJournaledRequest(@"third")];
+    XCTAssertEqual([journal unsyncedRecords], 0u, @"a full batch should be synced at once");
+    [journal appendRequest:LBJournaledRequest(@"fourth")];
+    XCTAssertEqual([journal unsyncedRecords], 1u);
+    [journal synchronize];
+    XCTAssertEqual([journal unsyncedRecords], 0u);
+
+    [journal acknowledgeRequest:first];
+    [journal acknowledgeRequest:second];
+    [journal synchronize];
+    NSArray<NSDictionary *> *records = LBJournalRecordsOfFile(path);
+    XCTAssertEqual(records.count, 2u, @"compaction should leave only the pending requests");
+    XCTAssertEqualObjects(records[0][@"sequence"], @3);
+    XCTAssertEqualObjects(records[1][@"sequence"], @4);
+    XCTAssertEqual([[LBRequestJournal alloc]initWithPath:path].pendingCount, 2u);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+-(void)testRequestJournalReplayOrder{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NSMutableArray *delivered = [NSMutableArray array];
+    __block BOOL offline = YES;
+    __block NSUInteger offlineAttempts = 0;
+    __block NSUInteger handled = 0;
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    client.transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        @synchronized (delivered) {
+            if (offline) {
+                offlineAttempts++;
+                return [LBTransportRecord recordWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNotConnectedToInternet userInfo:nil]];
+            }
+            [delivered addObject:request.URL.lastPathComponent];
+            return [LBTransportRecord recordWithStatusCode:200 headers:nil body:nil];
+        }
+    }];
+    LBRequestJournal *journal = [[LBRequestJournal alloc]initWithPath:path];
+    client.requestJournal = journal;
+
+    NSArray *names = @[@"0", @"1", @"2", @"3", @"4"];
+    for (NSString *name in names) {
+        LBServerRequest *request = LBJournaledRequest(name);
+        request.responseHandler = ^(LBServerResponse *response) {
+            @synchronized (delivered) {
+                handled++;
+            }
+        };
+        [client sendRequest:request];
+    }
+    [self expectationForPredicate:[NSPredicate predicateWithBlock:^BOOL(id object, NSDictionary *bindings) {
+        @synchronized (delivered) {
+            return offlineAttempts >= names.count;
+        }
+    }] evaluatedWithObject:self handler:nil];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    //let the last failures park before the network comes back
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+    @synchronized (delivered) {
+        XCTAssertEqual(handled, 0u, @"requests failing offline should be parked, not reported");
+        offline = NO;
+    }
+    [journal replay];
+    [self expectationForPredicate:[NSPredicate predicateWithBlock:^BOOL(id object, NSDictionary *bindings) {
+        @synchronized (delivered) {
+            return handled >= names.count;
+        }
+    }] evaluatedWithObject:self handler:nil];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertEqualObjects(delivered, names, @"parked requests should replay one at a time in journal order");
+    XCTAssertEqual(journal.pendingCount, 0u);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+-(void)testStreamFailingAfterRecords{
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    const uint8_t frames[] = {0, 0, 0, 2, 'h', 'i', 0, 0, 0, 9};
+    LBLoopbackTransport *transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        return [LBTransportRecord recordWithStatusCode:200 headers:nil body:[NSData dataWithBytes:frames length:sizeof(frames)]];
+    }];
+    client.transport = transport;
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"stream"];
+    NSMutableArray *records = [NSMutableArray array];
+    LBServerRequest *request = [LBServerRequest getRequest];
+    request.path = @"https://example.com/feed";
+    LBLengthPrefixedFramer *framer = [LBLengthPrefixedFramer framer];
+    framer.maxRecordLength = 8;
+    request.recordFramer = framer;
+    request.recordHandler = ^(id record) {
+        [records addObject:record];
+    };
+    request.failResponseHandler = ^(NSError *error) {
+        XCTAssertEqual(error.code, LBNetworkErrorRecordTooLarge);
+        [expectation fulfill];
+    };
+    [client sendRequest:request];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertEqual(records.count, 1u, @"a stream that delivered records should not be resent");
+    XCTAssertEqual(transport.requestCount, 1u);
+}
+
+-(void)testSegmentedDownload{
+    NSData *body = LBPatternData(10000);
+    for (NSNumber *segments in @[@1, @3, @6]) {
+        LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+        client.concurrencyLimiter.initialLimit = 2;
+        client.concurrencyLimiter.maxLimit = 2;
+        __block NSUInteger maxInFlight = 0;
+        NSMutableArray *ranges = [NSMutableArray array];
+        LBLoopbackTransport *transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+            @synchronized (ranges) {
+                [ranges addObject:[request valueForHTTPHeaderField:@"Range"]];
+                maxInFlight = MAX(maxInFlight, [client.concurrencyLimiter inFlightForHost:@"example.com"]);
+            }
+            return LBRangeRecord(request, body, YES);
+        }];
+        client.transport = transport;
+
+        NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+        XCTestExpectation *expectation = [self expectationWithDescription:@"download"];
+        LBServerRequest *request = [LBServerRequest getRequest];
+        request.path = @"https://example.com/large.bin";
+        request.successResponseHandler = ^(id output) {
+            XCTAssertEqualObjects(output, path);
+            [expectation fulfill];
+        };
+        request.failResponseHandler = ^(NSError *error) {
+            XCTFail(@"segmented download failed:%@", error);
+            [expectation fulfill];
+        };
+        LBSegmentedDownload *download = [client segmentedDownloadForRequest:request toFile:path];
+        download.segmentSize = 1500;
+        download.initialSegments = segments.unsignedIntegerValue;
+        download.maxSegments = segments.unsignedIntegerValue;
+        [download start];
+        [self waitForExpectationsWithTimeout:5 handler:nil];
+
+        XCTAssertEqualObjects([NSData dataWithContentsOfFile:path], body, @"every segment should land at its own offset");
+        XCTAssertEqual(download.totalBytes, 10000LL);
+        XCTAssertEqual(download.receivedBytes, 10000LL);
+        XCTAssertEqual(transport.requestCount, 7u);
+        XCTAssertEqualObjects(ranges.firstObject, @"bytes=0-1499", @"the first segment probes for range support");
+        XCTAssertTrue([ranges containsObject:@"bytes=9000-9999"], @"the last segment should be clipped to the probed length");
+        XCTAssertGreaterThan(maxInFlight, 0u, @"segments should hold the host's limiter slots");
+        XCTAssertLessThanOrEqual(maxInFlight, 2u, @"segments should not exceed the host's concurrency limit");
+        XCTAssertEqual([client.concurrencyLimiter inFlightForHost:@"example.com"], 0u);
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    }
+}
+
+-(void)testSegmentedDownloadWithoutRanges{
+    NSData *body = LBPatternData(5000);
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    LBLoopbackTransport *transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        return LBRangeRecord(request, body, NO);
+    }];
+    client.transport = transport;
+
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"download"];
+    LBServerRequest *request = [LBServerRequest getRequest];
+    request.path = @"https://example.com/large.bin";
+    request.successResponseHandler = ^(id output) {
+        [expectation fulfill];
+    };
+    LBSegmentedDownload *download = [client segmentedDownloadForRequest:request toFile:path];
+    download.segmentSize = 1000;
+    download.initialSegments = 4;
+    [download start];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:path], body, @"the whole body should come over the probing connection");
+    XCTAssertEqual(download.totalBytes, 5000LL);
+    XCTAssertEqual(transport.requestCount, 1u);
+    XCTAssertEqual([client.concurrencyLimiter inFlightForHost:@"example.com"], 0u);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+-(void)testConcurrencyLimiterGrowthAndBackoff{
+    LBConcurrencyLimiter *limiter = [[LBConcurrencyLimiter alloc]init];
+    limiter.initialLimit = 2;
+    limiter.maxLimit = 8;
+    NSString *host = @"example.com";
+    XCTAssertEqual([limiter limitForHost:host], 2u);
+
+    //steady latency, the limit climbs by about one per round of completions
+    for (NSUInteger i = 0; i < 8; i++) {
+        [limiter scheduleForHost:host block:^{}];
+        [limiter releaseForHost:host latency:10 failed:NO];
+    }
+    NSUInteger grown = [limiter limitForHost:host];
+    XCTAssertGreaterThanOrEqual(grown, 4u);
+    XCTAssertLessThanOrEqual(grown, 8u);
+
+    [limiter scheduleForHost:host block:^{}];
+    [limiter releaseForHost:host latency:10 failed:YES];
+    NSUInteger backedOff = [limiter limitForHost:host];
+    XCTAssertLessThan(backedOff, grown, @"a failure should back the limit off");
+    [limiter scheduleForHost:host block:^{}];
+    [limiter releaseForHost:host latency:10 failed:YES];
+    XCTAssertEqual([limiter limitForHost:host], backedOff, @"backoff should happen at most once per round trip");
+
+    //latency well above the best seen counts as congestion too
+    NSString *slowHost = @"slow.example.com";
+    [limiter scheduleForHost:slowHost block:^{}];
+    [limiter releaseForHost:slowHost latency:1 failed:NO];
+    NSUInteger before = [limiter limitForHost:slowHost];
+    [limiter scheduleForHost:slowHost block:^{}];
+    [limiter releaseForHost:slowHost latency:100 failed:NO];
+    XCTAssertLessThan([limiter limitForHost:slowHost], before);
+
+    for (NSUInteger i = 0; i < 100; i++) {
+        [limiter releaseForHost:host latency:10 failed:NO];
+    }
+    XCTAssertEqual([limiter limitForHost:host], 8u, @"the limit should not grow past maxLimit");
+}
+
+-(void)testConcurrencyLimiterQueue{
+    LBConcurrencyLimiter *limiter = [[LBConcurrencyLimiter alloc]init];
+    limiter.initialLimit = 1;
+    limiter.maxLimit = 1;
+    NSString *host = @"example.com";
+    NSMutableArray *started = [NSMutableArray array];
+    [limiter scheduleForHost:host block:^{ [started addObject:@1]; }];
+    [limiter scheduleForHost:host block:^{ [started addObject:@2]; }];
+    [limiter scheduleForHost:host block:^{ [started addObject:@3]; }];
+    XCTAssertEqualObjects(started, @[@1]);
+    XCTAssertEqual([limiter inFlightForHost:host], 1u);
+    XCTAssertEqual([limiter queuedForHost:host], 2u);
+
+    [limiter releaseForHost:host latency:0.1 failed:NO];
+    XCTAssertEqualObjects(started, (@[@1, @2]), @"a release should start the next queued block in order");
+    XCTAssertEqual([limiter queuedForHost:host], 1u);
+
+    [limiter cancelForHost:host];
+    XCTAssertEqualObjects(started, (@[@1, @2, @3]));
+    XCTAssertEqual([limiter inFlightForHost:host], 1u);
+    XCTAssertEqual([limiter queuedForHost:host], 0u);
+    [limiter releaseForHost:host latency:0.1 failed:NO];
+    XCTAssertEqual([limiter inFlightForHost:host], 0u);
+}
+
+-(void)testConcurrencyLimiterEviction{
+    LBConcurrencyLimiter *limiter = [[LBConcurrencyLimiter alloc]init];
+    limiter.idleTimeout = 0;
+    [limiter scheduleForHost:@"a.example.com" block:^{}];
+    [limiter scheduleForHost:@"b.example.com" block:^{}];
+    [limiter releaseForHost:@"a.example.com" latency:0.1 failed:NO];
+    [limiter scheduleForHost:@"c.example.com" block:^{}];
+    XCTAssertNil(limiter.hosts[@"a.example.com"], @"an idle host should be forgotten");
+    XCTAssertNotNil(limiter.hosts[@"b.example.com"], @"a host with work in flight should be kept");
+    XCTAssertEqual(limiter.hosts.count, 2u);
+}
+
+-(void)testImageEncoderBudget{
+    UIImage *image = LBNoiseImage(CGSizeMake(400, 200));
+    LBImageEncoder *encoder = [LBImageEncoder encoder];
+    encoder.targetByteCount = 0;
+    XCTAssertEqualObjects([encoder encodeImage:image], UIImageJPEGRepresentation(image, encoder.maxQuality), @"without a budget the image is encoded once at maxQuality");
+
+    NSUInteger full = UIImageJPEGRepresentation(image, encoder.maxQuality).length;
+    NSUInteger lowest = UIImageJPEGRepresentation(image, encoder.minQuality).length;
+    XCTAssertLessThan(lowest, full);
+    encoder.targetByteCount = (lowest + full) / 2;
+    NSError *error = nil;
+    NSData *data = [encoder encodeImage:image error:&error];
+    XCTAssertNil(error);
+    XCTAssertLessThanOrEqual(data.length, encoder.targetByteCount);
+    XCTAssertGreaterThan(data.length, lowest, @"the search should settle above minQuality when there is room");
+    XCTAssertEqual([UIImage imageWithData:data].size.width, 400.0, @"an image that fits by quality keeps its size");
+    XCTAssertEqualObjects([encoder encodeImage:image], data, @"the search is deterministic");
+
+    encoder.targetByteCount = lowest / 3;
+    data = [encoder encodeImage:image error:&error];
+    XCTAssertNil(error);
+    XCTAssertLessThanOrEqual(data.length, encoder.targetByteCount);
+    XCTAssertLessThan([UIImage imageWithData:data].size.width, 400.0, @"an image that does not fit at minQuality is scaled down");
+
+    encoder.maxPixelSize = 100;
+    encoder.targetByteCount = 0;
+    UIImage *scaled = [UIImage imageWithData:[encoder encodeImage:image]];
+    XCTAssertEqual(scaled.size.width, 100.0, @"the longest side should be capped at maxPixelSize");
+    XCTAssertEqual(scaled.size.height, 50.0);
+}
+
+-(void)testImageEncoderOverBudget{
+    UIImage *image = LBNoiseImage(CGSizeMake(400, 200));
+    LBImageEncoder *encoder = [LBImageEncoder encoder];
+    //smaller than any JPEG header
+    encoder.targetByteCount = 64;
+    NSData *bestEffort = [encoder encodeImage:image];
+    XCTAssertGreaterThan(bestEffort.length, encoder.targetByteCount, @"the plain variant returns the smallest encoding it found");
+
+    NSError *error = nil;
+    XCTAssertNil([encoder encodeImage:image error:&error]);
+    XCTAssertEqualObjects(error.domain, LBNetworkErrorDomain);
+    XCTAssertEqual(error.code, LBNetworkErrorImageOverBudget);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"encode"];
+    [encoder encodeImage:image completion:^(NSData *data, NSError *completionError) {
+        XCTAssertNil(data);
+        XCTAssertEqual(completionError.code, LBNetworkErrorImageOverBudget);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    LBLoopbackTransport *transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        return [LBTransportRecord recordWithStatusCode:200 headers:nil body:nil];
+    }];
+    client.transport = transport;
+    XCTestExpectation *failed = [self expectationWithDescription:@"upload"];
+    LBServerRequest *request = [LBServerRequest request];
+    request.method = kMethodPOST;
+    request.path = @"https://example.com/avatar";
+    request.failResponseHandler = ^(NSError *uploadError) {
+        XCTAssertEqual(uploadError.code, LBNetworkErrorImageOverBudget);
+        [failed fulfill];
+    };
+    [client asyncUploadImage:image request:request fileName:@"avatar.jpg" encoder:encoder];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertEqual(transport.requestCount, 0u, @"an oversized image should not be uploaded");
+}
+
+-(void)testRateLimiterEviction{
+    NSHTTPURLResponse *(^tooMany)(NSURL *) = ^NSHTTPURLResponse *(NSURL *URL) {
+        return [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:429 HTTPVersion:@"HTTP/1.1" headerFields:nil];
+    };
+    LBRateLimiter *limiter = [[LBRateLimiter alloc]init];
+    limiter.idleTimeout = 0;
+    [limiter setRate:1 burst:1 forRoute:@"api.example.com/v1/config"];
+    NSURL *first = [NSURL URLWithString:@"https://api.example.com/users/1"];
+    [limiter recordResponse:tooMany(first) forURL:first];
+    XCTAssertGreaterThan([limiter rateForRoute:@"api.example.com/users/1"], 0);
+
+    for (NSUInteger i = 2; i <= 50; i++) {
+        NSURL *URL = [NSURL URLWithString:[NSString stringWithFormat:@"https://api.example.com/users/%lu", (unsigned long)i]];
+        [limiter recordResponse:tooMany(URL) forURL:URL];
+    }
+    XCTAssertEqual([limiter rateForRoute:@"api.example.com/users/1"], 0, @"an idle throttled route should be dropped");
+    XCTAssertGreaterThan([limiter rateForRoute:@"api.example.com/users/50"], 0);
+    XCTAssertEqual([limiter rateForRoute:@"api.example.com/v1/config"], 1, @"configured routes are never dropped");
+
+    limiter.idleTimeout = 60;
+    NSURL *held = [NSURL URLWithString:@"https://api.example.com/users/51"];
+    [limiter recordResponse:tooMany(held) forURL:held];
+    NSURL *next = [NSURL URLWithString:@"https://api.example.com/users/52"];
+    [limiter recordResponse:tooMany(next) forURL:next];
+    XCTAssertGreaterThan([limiter rateForRoute:@"api.example.com/users/51"], 0, @"a recently throttled route should be kept");
+}
+
+-(void)testResponseCacheKeys{
+    NSURL *URL = [NSURL URLWithString:@"https://example.com/me"];
+    NSMutableURLRequest *anonymous = [NSMutableURLRequest requestWithURL:URL];
+    NSMutableURLRequest *alice = [NSMutableURLRequest requestWithURL:URL];
+    [alice setValue:@"Bearer alice" forHTTPHeaderField:@"Authorization"];
+    NSMutableURLRequest *bob = [NSMutableURLRequest requestWithURL:URL];
+    [bob setValue:@"Bearer bob" forHTTPHeaderField:@"Authorization"];
+    XCTAssertEqualObjects([LBResponseCache keyForRequest:anonymous], @"GET https://example.com/me");
+    XCTAssertNotEqualObjects([LBResponseCache keyForRequest:alice], [LBResponseCache keyForRequest:bob], @"accounts should not share cached responses");
+    XCTAssertFalse([[LBResponseCache keyForRequest:alice] containsString:@"alice"], @"credentials should only appear hashed");
+
+    LBResponseCache *cache = [[LBResponseCache alloc]init];
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:@{@"Vary" : @"Accept-Language"}];
+    [alice setValue:@"en" forHTTPHeaderField:@"Accept-Language"];
+    [cache storeResponse:response data:[@"hello" dataUsingEncoding:NSUTF8StringEncoding] forRequest:alice];
+    XCTAssertNotNil([cache cachedResponseForRequest:alice]);
+    XCTAssertNil([cache cachedResponseForRequest:bob]);
+    NSMutableURLRequest *french = [alice mutableCopy];
+    [french setValue:@"fr" forHTTPHeaderField:@"Accept-Language"];
+    XCTAssertNil([cache cachedResponseForRequest:french], @"a response should only match the header values it varies on");
+
+    NSHTTPURLResponse *varyAll = [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:@{@"Vary" : @"*"}];
+    XCTAssertNil([cache storeResponse:varyAll data:[NSData data] forRequest:alice]);
+    XCTAssertNil([cache cachedResponseForRequest:alice], @"Vary: * should replace the stored response with nothing");
+
+    NSHTTPURLResponse *(^withCacheControl)(NSString *) = ^NSHTTPURLResponse *(NSString *cacheControl) {
+        return [[NSHTTPURLResponse alloc] initWithURL:URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:@{@"cache-control" : cacheControl}];
+    };
+    XCTAssertNotNil([cache storeResponse:withCacheControl(@"max-age=60") data:[NSData data] forRequest:anonymous]);
+    XCTAssertNil([cache storeResponse:withCacheControl(@"private, max-age=60") data:[NSData data] forRequest:anonymous]);
+    XCTAssertNil([cache cachedResponseForRequest:anonymous], @"a private response without credentials should drop the stored one");
+    XCTAssertNotNil([cache storeResponse:withCacheControl(@"private") data:[NSData data] forRequest:bob], @"private is kept per credential");
+    XCTAssertNil([cache storeResponse:withCacheControl(@"No-Store") data:[NSData data] forRequest:bob]);
+    XCTAssertNil([cache cachedResponseForRequest:bob], @"no-store should never be kept");
+}
+
+-(void)testPrefetchThroughLimiters{
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    LBLoopbackTransport *transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        return [LBTransportRecord recordWithStatusCode:200 headers:@{@"Content-Type" : @"application/json"} body:[@"{}" dataUsingEncoding:NSUTF8StringEncoding]];
+    }];
+    client.transport = transport;
+    NSURL *throttled = [NSURL URLWithString:@"https://example.com/throttled"];
+    [client.rateLimiter recordResponse:[[NSHTTPURLResponse alloc] initWithURL:throttled statusCode:429 HTTPVersion:@"HTTP/1.1" headerFields:@{@"Retry-After" : @"60"}] forURL:throttled];
+
+    LBServerRequest *held = [LBServerRequest getRequest];
+    held.path = throttled.absoluteString;
+    [client prefetchRequest:held];
+    LBServerRequest *open = [LBServerRequest getRequest];
+    open.path = @"https://example.com/open";
+    [client prefetchRequest:open];
+
+    LBPrefetchStore *store = client.prefetcher.store;
+    [self expectationForPredicate:[NSPredicate predicateWithBlock:^BOOL(id object, NSDictionary *bindings) {
+        return store.count == 1;
+    }] evaluatedWithObject:store handler:nil];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertEqual(transport.requestCount, 1u, @"a route held by Retry-After should get no speculative traffic");
+    XCTAssertEqual([client.rateLimiter waitingForHost:@"example.com"], 1u);
+    XCTAssertEqual([client.concurrencyLimiter inFlightForHost:@"example.com"], 0u, @"a finished prefetch should give its slot back");
+    XCTAssertEqual([client.metrics.dictionaryRepresentation[@"attempts"] unsignedIntegerValue], 1u);
+
+    [client cancelPrefetches];
+    XCTAssertEqual(client.prefetcher.outstandingCount, 0u);
+}
+
+-(void)testRequestJournalCredentials{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    LBRequestJournal *journal = [[LBRequestJournal alloc]initWithPath:path];
+    LBServerRequest *request = LBJournaledRequest(@"secret-write");
+    request.headers = @{@"authorization" : @"Bearer sekrit-token", @"X-Client" : @"tests"};
+    [request authenticate:@"user" password:@"hunter2"];
+    [journal appendRequest:request];
+    [journal synchronize];
+
+    NSData *contents = [NSData dataWithContentsOfFile:path];
+    XCTAssertEqual([contents rangeOfData:[@"sekrit-token" dataUsingEncoding:NSUTF8StringEncoding] options:0 range:NSMakeRange(0, contents.length)].location, NSNotFound, @"credentials should not be written to the journal");
+    NSString *basic = [LBServerRequest basicAuthorizationValueForUsername:@"user" password:@"hunter2"];
+    XCTAssertEqual([contents rangeOfData:[basic dataUsingEncoding:NSUTF8StringEncoding] options:0 range:NSMakeRange(0, contents.length)].location, NSNotFound);
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+    XCTAssertEqual([attributes[NSFilePosixPermissions] unsignedIntegerValue], 0600u);
+
+    LBRequestJournal *restored = [[LBRequestJournal alloc]initWithPath:path];
+    restored.credentialsHandler = ^(LBServerRequest *replayed) {
+        [replayed authenticate:@"user" password:@"hunter2"];
+    };
+    LBServerRequest *replayed = [restored requestForEntry:restored.entries.firstObject];
+    XCTAssertEqualObjects(replayed.headers, @{@"X-Client" : @"tests"});
+    XCTAssertEqualObjects(replayed.basicAuthHeaders[@"Authorization"], basic, @"credentials come back from the handler");
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+-(void)testRequestJournalParksServerErrors{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    __block NSUInteger attempts = 0;
+    LBHTTPSClient *client = [[LBHTTPSClient alloc]init];
+    LBLoopbackTransport *transport = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        @synchronized (self) {
+            attempts++;
+            return [LBTransportRecord recordWithStatusCode:attempts == 1 ? 503 : 201 headers:nil body:nil];
+        }
+    }];
+    client.transport = transport;
+    LBRequestJournal *journal = [[LBRequestJournal alloc]initWithPath:path];
+    client.requestJournal = journal;
+
+    NSMutableArray *statusCodes = [NSMutableArray array];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"written"];
+    LBServerRequest *request = LBJournaledRequest(@"write");
+    request.responseHandler = ^(LBServerResponse *response) {
+        [statusCodes addObject:@(response.statusCode)];
+        [expectation fulfill];
+    };
+    [client sendRequest:request];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertEqualObjects(statusCodes, @[@201], @"a 503 should be parked and replayed, not handed to the handlers");
+    XCTAssertEqual(transport.requestCount, 2u);
+    [journal synchronize];
+    XCTAssertEqual(journal.pendingCount, 0u, @"acknowledged once the server took it");
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
 -(void)testCreateConnection{
     LBServerRequest *request = [self createRequest];
     LBURLConnection *con = [[LBURLConnection alloc]initWithRequest:request delegate:self];
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2014-present, Lena Brusilovski. All rights reserved.
+ *
+ * You are hereby granted a non-exclusive, worldwide, royalty-free license to use,
+ * copy, modify, and distribute this software in source code or binary form for use.
+ *
+ *
+ * This copyright notice shall be included in all copies or substantial portions of the software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+//
+//  LBSoakTests.m
+//  LBNetworkTests
+//
+//  Drives waves of concurrent requests through an LBHTTPSClient against a loopback
+//  stand-in server that injects server errors, connection errors, timeouts, flaky
+//  first attempts and redirects. Every wave checks that each request got exactly one,
+//  correct, delivery and that no connection or response outlived it, RSS is sampled
+//  between waves.
+//
+//  Runs briefly by default, set LBNETWORK_SOAK_SECONDS in the scheme's environment
+//  for a long soak.
+//
+
+#import "LBNetwork.h"
+#import <XCTest/XCTest.h>
+#import <mach/mach.h>
+
+#define kDefaultSoakSeconds 5
+#define kSoakWaveSize 1000
+#define kSoakHosts 8
+#define kSoakMaxRetryCount 3
+#define kSoakMaxRSSGrowth (48 * 1024 * 1024)
+#define kSoakDrainTimeout 5.0
+
+typedef enum{
+    LBSoakKindOK,
+    LBSoakKindServerError,
+    LBSoakKindConnectionError,
+    LBSoakKindTimeout,
+    LBSoakKindFlaky,
+    LBSoakKindRedirect,
+    LBSoakKindRedirectNotFollowed,
+    LBSoakKindChunked,
+    LBSoakKindCount,
+}LBSoakKind;
+
+static uint64_t LBSoakResidentSize(void) {
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+}
+
+/**
+ * Forwards to the stand-in server, remembering every connection weakly
+ */
+@interface LBSoakTransport : NSObject <LBTransport>
+@property (nonatomic,strong)LBLoopbackTransport *server;
+@property (nonatomic,strong)NSHashTable *connections;
+@end
+
+@implementation LBSoakTransport
+
+-(instancetype)init{
+    self = [super init];
+    if (self) {
+        self.connections = [NSHashTable weakObjectsHashTable];
+    }
+    return self;
+}
+
+-(void)startConnection:(LBURLConnection *)connection delegateQueue:(NSOperationQueue *)queue{
+    @synchronized (self.connections) {
+        [self.connections addObject:connection];
+    }
+    [self.server startConnection:connection delegateQueue:queue];
+}
+
+-(NSData *)sendSynchronousRequest:(NSURLRequest *)request returningResponse:(NSHTTPURLResponse **)response error:(NSError **)error{
+    return [self.server sendSynchronousRequest:request returningResponse:response error:error];
+}
+
+-(NSUInteger)liveConnections{
+    @synchronized (self.connections) {
+        return self.connections.allObjects.count;
+    }
+}
+@end
+
+@interface LBSoakTests : XCTestCase <LBConnectionErrorHandler>
+@property (nonatomic,strong)NSMutableDictionary *attempts;
+@end
+
+@implementation LBSoakTests
+
+#pragma mark - LBConnectionErrorHandler
+
+-(BOOL)shouldDisplayActivityIndicatorForRequest:(NSURLRequest *)request{
+    return YES;
+}
+
+-(BOOL)shouldDisplayErrorForResponse:(LBServerResponse *)response{
+    return NO;
+}
+
+-(BOOL)shouldRetryRequest:(NSError *)error forCurrentTry:(NSInteger)currentTry{
+    return currentTry < kSoakMaxRetryCount;
+}
+
+#pragma mark - stand-in server
+
+-(LBTransportRecord *)recordForRequest:(NSURLRequest *)request{
+    NSArray *components = request.URL.pathComponents;
+    LBSoakKind kind = (LBSoakKind) [components[1] integerValue];
+    NSString *identifier = components[2];
+    NSData *body = [[NSString stringWithFormat:@"{\"id\":\"%@\"}", identifier] dataUsingEncoding:NSUTF8StringEncoding];
+    NSDictionary *JSONHeaders = @{@"Content-Type" : @"application/json"};
+    switch (kind) {
+        case LBSoakKindServerError:
+            return [LBTransportRecord recordWithStatusCode:500 headers:nil body:nil];
+        case LBSoakKindConnectionError:
+            return [LBTransportRecord recordWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotConnectToHost userInfo:nil]];
+        case LBSoakKindTimeout: {
+            LBTransportRecord *record = [LBTransportRecord recordWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut userInfo:nil]];
+            record.duration = 0.01;
+            return record;
+        }
+        case LBSoakKindFlaky: {
+            NSUInteger attempt;
+            @synchronized (self.attempts) {
+                attempt = [self.attempts[identifier] unsignedIntegerValue] + 1;
+                self.attempts[identifier] = @(attempt);
+            }
+            if (attempt == 1) {
+                return [LBTransportRecord recordWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil]];
+            }
+            return [LBTransportRecord recordWithStatusCode:200 headers:JSONHeaders body:body];
+        }
+        case LBSoakKindRedirect:
+        case LBSoakKindRedirectNotFollowed:
+            return [LBTransportRecord recordWithStatusCode:302 headers:@{@"Location" : [NSString stringWithFormat:@"/%d/%@", LBSoakKindOK, identifier]} body:nil];
+        case LBSoakKindChunked: {
+            LBTransportRecord *record = [LBTransportRecord recordWithStatusCode:200 headers:JSONHeaders body:body];
+            record.chunks = @[@[@0.001, @4], @[@0.002, @(body.length)]];
+            return record;
+        }
+        default:
+            return [LBTransportRecord recordWithStatusCode:200 headers:JSONHeaders body:body];
+    }
+}
+
+/**
+ * nil when the delivery is what the kind of request should end with
+ */
+-(NSString *)checkResponse:(LBServerResponse *)response kind:(LBSoakKind)kind identifier:(NSString *)identifier{
+    switch (kind) {
+        case LBSoakKindServerError:
+            return response.statusCode == 500 ? nil : @"expected a 500";
+        case LBSoakKindConnectionError:
+            return response.error.code == NSURLErrorCannotConnectToHost && response.currentRequestTryCount == kSoakMaxRetryCount ? nil : @"expected a connection error after every retry";
+        case LBSoakKindTimeout:
+            return response.error.code == NSURLErrorTimedOut ? nil : @"expected a timeout";
+        case LBSoakKindRedirectNotFollowed:
+            return response.statusCode == 302 ? nil : @"expected the redirect itself";
+        default:
+            return response.statusCode == 200 && [response.output[@"id"] isEqualToString:identifier] ? nil : @"expected its own 200 body";
+    }
+}
+
+#pragma mark - soak
+
+-(void)testSoak{
+    NSTimeInterval duration = [[NSProcessInfo processInfo].environment[@"LBNETWORK_SOAK_SECONDS"] doubleValue] ?: kDefaultSoakSeconds;
+    self.attempts = [NSMutableDictionary dictionary];
+
+    LBURLConnectionProperties *properties = [[LBURLConnectionProperties alloc] init];
+    properties.maxRetryCount = kSoakMaxRetryCount;
+    properties.logLevel = LogLevelNone;
+    properties.errorHandler = self;
+    LBHTTPSClient *client = [[LBHTTPSClient alloc] initWithConnectionProperties:properties];
+    LBSoakTransport *transport = [[LBSoakTransport alloc] init];
+    __weak LBSoakTests *weakSelf = self;
+    transport.server = [LBLoopbackTransport transportWithResponder:^LBTransportRecord *(NSURLRequest *request) {
+        return [weakSelf recordForRequest:request];
+    }];
+    client.transport = transport;
+    NSHashTable *responses = [NSHashTable weakObjectsHashTable];
+
+    CFAbsoluteTime end = CFAbsoluteTimeGetCurrent() + duration;
+    uint64_t baselineRSS = 0;
+    NSMutableArray *RSSSamples = [NSMutableArray array];
+    NSUInteger wave = 0;
+    do {
+        NSMutableDictionary *deliveries = [NSMutableDictionary dictionaryWithCapacity:kSoakWaveSize];
+        NSMutableArray *failures = [NSMutableArray array];
+        dispatch_group_t group = dispatch_group_create();
+        @autoreleasepool {
+            for (NSUInteger i = 0; i < kSoakWaveSize; i++) {
+                LBSoakKind kind = (LBSoakKind) (i % LBSoakKindCount);
+                NSString *identifier = [NSString stringWithFormat:@"%lu-%lu", (unsigned long) wave, (unsigned long) i];
+                LBServerRequest *request = [LBServerRequest getRequest];
+                request.path = [NSString stringWithFormat:@"https://soak%lu.example.com/%d/%@", (unsigned long) (i % kSoakHosts), kind, identifier];
+                request.shouldAutoRedirect = kind != LBSoakKindRedirectNotFollowed;
+                request.requestTimeoutSeconds = 1;
+                dispatch_group_enter(group);
+                request.responseHandler = ^(LBServerResponse *response) {
+                    NSUInteger count;
+                    @synchronized (deliveries) {
+                        count = [deliveries[identifier] unsignedIntegerValue] + 1;
+                        deliveries[identifier] = @(count);
+                        NSString *failure = count > 1 ? @"delivered twice" : [self checkResponse:response kind:kind identifier:identifier];
+                        if (failure) {
+                            [failures addObject:[NSString stringWithFormat:@"%@ %@", identifier, failure]];
+                        }
+                    }
+                    @synchronized (responses) {
+                        [responses addObject:response];
+                    }
+                    if (count == 1) {
+                        dispatch_group_leave(group);
+                    }
+                };
+                [client sendRequest:request];
+            }
+        }
+
+        XCTestExpectation *expectation = [self expectationWithDescription:[NSString stringWithFormat:@"wave %lu", (unsigned long) wave]];
+        dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+            [expectation fulfill];
+        });
+        [self waitForExpectationsWithTimeout:60 handler:nil];
+
+        //give the delegate queue time to drop what it still holds after the handlers
+        CFAbsoluteTime drainEnd = CFAbsoluteTimeGetCurrent() + kSoakDrainTimeout;
+        while (CFAbsoluteTimeGetCurrent() < drainEnd && (transport.liveConnections || [LBHTTPSClient networkActivityCount] || [responses allObjects].count)) {
+            [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+        }
+        XCTAssertEqual(deliveries.count, (NSUInteger) kSoakWaveSize, @"wave %lu missed deliveries", (unsigned long) wave);
+        XCTAssertEqual(failures.count, 0u, @"wave %lu: %@", (unsigned long) wave, [failures subarrayWithRange:NSMakeRange(0, MIN(10u, failures.count))]);
+        XCTAssertEqual(transport.liveConnections, 0u, @"connections leaked in wave %lu", (unsigned long) wave);
+        XCTAssertEqual([responses allObjects].count, 0u, @"responses leaked in wave %lu", (unsigned long) wave);
+        XCTAssertEqual([LBHTTPSClient networkActivityCount], 0, @"activity indicator left on after wave %lu", (unsigned long) wave);
+        @synchronized (self.attempts) {
+            [self.attempts removeAllObjects];
+        }
+
+        uint64_t RSS = LBSoakResidentSize();
+        [RSSSamples addObject:@(RSS)];
+        if (wave == 0) {
+            //the first wave warms up pools, caches and the queue's threads
+            baselineRSS = RSS;
+        }
+        wave++;
+    } while (CFAbsoluteTimeGetCurrent() < end);
+
+    NSLog(@"soak: %lu waves of %d requests, RSS samples %@", (unsigned long) wave, kSoakWaveSize, RSSSamples);
+    uint64_t finalRSS = [RSSSamples.lastObject unsignedLongLongValue];
+    XCTAssertLessThan(finalRSS > baselineRSS ? finalRSS - baselineRSS : 0, (uint64_t) kSoakMaxRSSGrowth, @"RSS kept growing over the soak");
+}
+
+@end